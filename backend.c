@@ -0,0 +1,664 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Generic register access for subcommands, see struct backend.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "commands.h"
+#include "output.h"
+#include "regmap.h"
+
+#define MAX_REG_LINE 1024
+
+/* Name the device selected by dev for error messages. */
+static const char *
+describe(const struct backend *b, const unsigned int *dev)
+{
+	static char name[128];
+	unsigned int d[IOT_MAX_DEV_ARGS] = { 0 };
+	int ndev = iot_space_info(b->space)->ndev;
+
+	memcpy(d, dev, ndev * sizeof(*dev));
+	snprintf(name, sizeof(name), b->dev_fmt, d[0], d[1], d[2], d[3]);
+
+	return name;
+}
+
+int
+parse_reg_spec(const char *name, struct reg_spec *spec)
+{
+	const struct iot_space_info *si;
+	enum iot_space space;
+	size_t len;
+	char *end;
+	long width;
+
+	for (space = 0; space < IOT_SPACE_MAX; space++) {
+		si = iot_space_info(space);
+		len = strlen(si->name);
+		if (strncmp(name, si->name, len)) {
+			continue;
+		}
+		if (name[len] == '\0') {
+			if (si->min_width != si->max_width) {
+				continue;
+			}
+			width = si->min_width;
+		} else {
+			if (name[len] < '1' || name[len] > '9') {
+				continue;
+			}
+			width = strtol(&name[len], &end, 10);
+			if (*end != '\0' || width < si->min_width ||
+			    width > si->max_width || (width & (width - 1))) {
+				continue;
+			}
+		}
+
+		spec->space = space;
+		spec->width = width;
+		spec->ndev = si->ndev;
+		/* The PCI segment is usually 0 and may be left out. */
+		spec->opt_dev = (space == IOT_SPACE_PCI);
+		/* MSRs and SCOMs are numbered, everything else is byte
+		 * addressed. */
+		spec->addr_step = (space == IOT_SPACE_MSR ||
+		                   space == IOT_SPACE_SCOM) ? 1 : width / 8;
+		return 0;
+	}
+
+	return -1;
+}
+
+int
+reg_ref_span(int nargs, const char *args[])
+{
+	struct reg_spec spec;
+	int n;
+
+	for (n = 1; n < nargs; n++) {
+		if (!parse_reg_spec(args[n], &spec)) {
+			break;
+		}
+	}
+	return n;
+}
+
+int
+parse_reg_ref(int nargs, const char *args[], struct reg_ref *ref)
+{
+	int ndev, i;
+
+	memset(ref, 0, sizeof(*ref));
+	if (parse_reg_spec(args[0], &ref->spec) < 0) {
+		fprintf(stderr, "unknown register type '%s'\n", args[0]);
+		return -1;
+	}
+	snprintf(ref->name, sizeof(ref->name), "%s", args[0]);
+
+	ndev = nargs - 2;
+	if (ndev < ref->spec.ndev - ref->spec.opt_dev ||
+	    ndev > ref->spec.ndev) {
+		fprintf(stderr, "%s takes %d device values before the address\n",
+		        args[0], ref->spec.ndev);
+		return -1;
+	}
+	for (i = 0; i < ndev; i++) {
+		ref->dev[ref->spec.ndev - ndev + i] =
+			strtoul(args[1 + i], NULL, 0);
+	}
+	if (parse_reg_addr(ref->spec.space, args[1 + ndev], &ref->addr) < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+parse_reg_refs(int nargs, const char *args[], struct reg_ref *refs, int *n,
+               int max)
+{
+	int arg, span;
+
+	for (arg = 0; arg < nargs; arg += span) {
+		if (*n == max) {
+			fprintf(stderr, "at most %d registers are supported\n",
+			        max);
+			return -1;
+		}
+		span = reg_ref_span(nargs - arg, &args[arg]);
+		if (parse_reg_ref(span, &args[arg], &refs[*n]) < 0) {
+			return -1;
+		}
+		(*n)++;
+	}
+
+	return 0;
+}
+
+int
+parse_reg_ref_file(const char *path, struct reg_ref *refs, int *n, int max)
+{
+	const char *args[MAX_REG_LINE / 2 + 1];
+	char line[MAX_REG_LINE];
+	int nargs, lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		nargs = split_args(line, args, MAX_REG_LINE / 2);
+		if (nargs > 0 && parse_reg_refs(nargs, args, refs, n, max) < 0) {
+			fprintf(stderr, "%s:%d: bad register\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+
+	return 0;
+}
+
+struct iot_handle *
+backend_open(const struct backend *b, const unsigned int *dev, int flags)
+{
+	struct iot_handle *h;
+
+	h = get_handle(b->space, dev, flags);
+	if (h == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", describe(b, dev),
+		        strerror(errno));
+	}
+
+	return h;
+}
+
+static int
+check_addr(const struct backend *b, const unsigned int *dev, uint64_t addr)
+{
+	if (addr < b->min_addr) {
+		fprintf(stderr, "can't access %s below 0x%llx\n",
+		        describe(b, dev), (unsigned long long)b->min_addr);
+		return -1;
+	}
+	return 0;
+}
+
+int
+backend_read(const struct backend *b, struct iot_handle *h, uint64_t addr,
+             int width, uint64_t *value)
+{
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+
+	iot_dev(h, dev);
+	if (check_addr(b, dev, addr) < 0) {
+		return -1;
+	}
+	if (iot_read(h, addr, width, value) < 0) {
+		fprintf(stderr, "can't read %s register 0x%llx: %s\n",
+		        describe(b, dev), (unsigned long long)addr,
+		        strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+int
+backend_write(const struct backend *b, struct iot_handle *h, uint64_t addr,
+              int width, uint64_t value)
+{
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+
+	iot_dev(h, dev);
+	if (check_addr(b, dev, addr) < 0) {
+		return -1;
+	}
+	if (iot_write(h, addr, width, value) < 0) {
+		fprintf(stderr, "can't write %s register 0x%llx: %s\n",
+		        describe(b, dev), (unsigned long long)addr,
+		        strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/* Online CPUs, from the kernel's "0-3,8-11" list. */
+int
+online_cpus(unsigned int *cpus, int max)
+{
+	unsigned int first, last, cpu;
+	char buf[4096], path[PATH_MAX], *p, *end;
+	int n = 0;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/online",
+	         iot_get_root());
+	f = fopen(path, "r");
+	if (f == NULL || fgets(buf, sizeof(buf), f) == NULL) {
+		if (f != NULL) {
+			fclose(f);
+		}
+		/* Assume CPUs are numbered without gaps. */
+		for (n = 0; n < sysconf(_SC_NPROCESSORS_ONLN) && n < max; n++) {
+			cpus[n] = n;
+		}
+		return n;
+	}
+	fclose(f);
+
+	for (p = buf; *p != '\0' && *p != '\n'; p = end) {
+		first = last = strtoul(p, &end, 10);
+		if (*end == '-') {
+			last = strtoul(end + 1, &end, 10);
+		}
+		for (cpu = first; cpu <= last && n < max; cpu++) {
+			cpus[n++] = cpu;
+		}
+		if (*end == ',') {
+			end++;
+		} else if (end == p) {
+			break;
+		}
+	}
+
+	return n;
+}
+
+/* Access width of a generic register command, or -1 if the address space
+ * does not support it. */
+static int
+command_width(const struct backend *b, const struct cmd_info *info)
+{
+	const struct iot_space_info *si = iot_space_info(b->space);
+	int width = b->width ? b->width : get_command_size(info);
+
+	if (width < si->min_width || width > si->max_width) {
+		fprintf(stderr, "%s: invalid access width %d\n", info->name,
+		        width);
+		return -1;
+	}
+
+	if (width == 64 && (si->caps & IOT_CAP_MMAP) &&
+	    sizeof(void *) != sizeof(uint64_t)) {
+		fprintf(stderr, "warning: 64 bit operations might "
+		        "not be atomic on 32 bit builds\n");
+	}
+
+	return width;
+}
+
+int
+parse_reg_value(const char *arg, uint64_t *value)
+{
+	char *end;
+
+	errno = 0;
+	*value = strtoull(arg, &end, 0);
+	if (end == arg || *end != '\0' || errno) {
+		fprintf(stderr, "invalid value '%s'\n", arg);
+		return -1;
+	}
+	return 0;
+}
+
+/* Parse the device selector followed by nvals numbers. Omitted optional
+ * device values are 0. */
+static int
+parse_reg_args(const struct backend *b, int argc, const char *argv[],
+               int nvals, unsigned int *dev, uint64_t *vals)
+{
+	int ndev = iot_space_info(b->space)->ndev;
+	int given = argc - 1 - nvals;
+	int arg = 1;
+	int i;
+
+	if (given < ndev - b->opt_dev || given > ndev) {
+		fprintf(stderr, "%s: expected %d device values\n", argv[0],
+		        ndev);
+		return -1;
+	}
+
+	for (i = 0; i < ndev; i++) {
+		if (i < ndev - given) {
+			dev[i] = 0;
+		} else {
+			dev[i] = strtoul(argv[arg++], NULL, 0);
+		}
+	}
+	/* The first value is the address, which may be a register name. */
+	for (i = 0; i < nvals; i++) {
+		if (i == 0) {
+			if (parse_reg_addr(b->space, argv[arg++], &vals[0]) < 0) {
+				return -1;
+			}
+		} else if (parse_reg_value(argv[arg++], &vals[i]) < 0) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Most registers a range may cover, and how many are read at a time. */
+#define MAX_RANGE_COUNT (1 << 24)
+#define RANGE_CHUNK 4096
+
+int
+is_reg_range(const char *arg)
+{
+	/* Skip the first character, it belongs to the first address. */
+	return arg[0] != '\0' && strpbrk(arg + 1, "-+:") != NULL;
+}
+
+int
+parse_reg_range(const char *arg, uint64_t step, struct reg_range *r)
+{
+	const char *orig = arg;
+	uint64_t last = 0;
+	char *end;
+	char sep;
+
+	r->start = strtoull(arg, &end, 0);
+	if (end == arg) {
+		goto invalid;
+	}
+	sep = *end;
+	r->count = 1;
+	r->stride = step;
+
+	if (sep == '-' || sep == '+') {
+		arg = end + 1;
+		last = strtoull(arg, &end, 0);
+		if (end == arg) {
+			goto invalid;
+		}
+	}
+	if (*end == ':') {
+		arg = end + 1;
+		r->stride = strtoull(arg, &end, 0);
+		if (end == arg || r->stride == 0) {
+			goto invalid;
+		}
+	}
+	if (*end != '\0') {
+		goto invalid;
+	}
+
+	if (sep == '-') {
+		if (last < r->start) {
+			goto invalid;
+		}
+		r->count = (last - r->start) / r->stride + 1;
+	} else if (sep == '+') {
+		r->count = last;
+	}
+
+	if (r->count == 0 || r->count > MAX_RANGE_COUNT ||
+	    (r->count - 1) > (UINT64_MAX - r->start) / r->stride) {
+		goto invalid;
+	}
+	return 0;
+
+invalid:
+	fprintf(stderr, "invalid register range '%s'\n", orig);
+	return -1;
+}
+
+int
+backend_read_range(const struct backend *b, struct iot_handle *h,
+                   const struct reg_range *r, int width, int flags)
+{
+	struct iot_access *acc;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t done, failed = 0;
+	int n, i;
+
+	iot_dev(h, dev);
+	if (check_addr(b, dev, r->start) < 0) {
+		return -1;
+	}
+
+	n = r->count < RANGE_CHUNK ? r->count : RANGE_CHUNK;
+	acc = calloc(n, sizeof(*acc));
+	if (acc == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	/* The chunk size is a multiple of the table width, so chunks can be
+	 * printed one after another. */
+	for (done = 0; done < r->count; done += n) {
+		if (r->count - done < n) {
+			n = r->count - done;
+		}
+		for (i = 0; i < n; i++) {
+			acc[i].addr = r->start + (done + i) * r->stride;
+			acc[i].width = width;
+		}
+
+		if (iot_readv(h, acc, n) < 0) {
+			for (i = 0; i < n; i++) {
+				if (acc[i].status == 0) {
+					continue;
+				}
+				if (failed++ == 0) {
+					fprintf(stderr, "can't read %s register "
+					        "0x%llx: %s\n", describe(b, dev),
+					        (unsigned long long)acc[i].addr,
+					        strerror(-acc[i].status));
+				}
+			}
+		}
+		output_table(h, acc, n, flags);
+	}
+	free(acc);
+
+	if (failed > 1) {
+		fprintf(stderr, "%llu of %llu registers could not be read\n",
+		        (unsigned long long)failed,
+		        (unsigned long long)r->count);
+	}
+
+	return failed ? -1 : 0;
+}
+
+int
+backend_read_cmd(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct backend *b = info->privdata;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	struct reg_range range;
+	uint64_t addr;
+	uint64_t value;
+	struct iot_handle *h;
+	int width;
+	int ret;
+
+	width = command_width(b, info);
+	if (width < 0) {
+		return -1;
+	}
+
+	if (is_reg_range(argv[argc - 1])) {
+		if (sampling_requested()) {
+			fprintf(stderr, "only single registers can be sampled\n");
+			return -1;
+		}
+		if (parse_reg_args(b, argc - 1, argv, 0, dev, NULL) < 0 ||
+		    parse_reg_range(argv[argc - 1], b->addr_step ? :
+		                    width / 8, &range) < 0) {
+			return -1;
+		}
+		h = backend_open(b, dev, IOT_RDONLY);
+		if (h == NULL) {
+			return -1;
+		}
+		ret = backend_read_range(b, h, &range, width, 0);
+		put_handle(h);
+		return ret;
+	}
+
+	if (parse_reg_args(b, argc, argv, 1, dev, &addr) < 0 ||
+	    check_addr(b, dev, addr) < 0) {
+		return -1;
+	}
+
+	h = backend_open(b, dev, IOT_RDONLY);
+	if (h == NULL) {
+		return -1;
+	}
+
+	if (sampling_requested()) {
+		ret = backend_sample(b, h, addr, width);
+		put_handle(h);
+		return ret;
+	}
+
+	if (backend_read(b, h, addr, width, &value) < 0) {
+		put_handle(h);
+		return -1;
+	}
+
+	output_read(h, addr, width, value, 0);
+	regmap_print_fields(b->space, addr, width, value);
+	put_handle(h);
+
+	return 0;
+}
+
+int
+backend_write_cmd(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct backend *b = info->privdata;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t vals[2];
+	struct iot_handle *h;
+	int width;
+	int ret;
+
+	width = command_width(b, info);
+	if (width < 0) {
+		return -1;
+	}
+	if (parse_reg_args(b, argc, argv, 2, dev, vals) < 0 ||
+	    check_addr(b, dev, vals[0]) < 0) {
+		return -1;
+	}
+
+	h = backend_open(b, dev, IOT_RDWR);
+	if (h == NULL) {
+		return -1;
+	}
+
+	ret = backend_write(b, h, vals[0], width, vals[1]);
+	put_handle(h);
+
+	return ret;
+}
+
+int
+backend_modify(const struct backend *b, struct iot_handle *h, uint64_t addr,
+               int width, uint64_t clear, uint64_t set, int verify)
+{
+	uint64_t mask = width < 64 ? (1ULL << width) - 1 : ~0ULL;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t value, check;
+
+	if ((clear | set) & ~mask) {
+		fprintf(stderr, "masks 0x%llx 0x%llx don't fit in %d bits\n",
+		        (unsigned long long)clear, (unsigned long long)set,
+		        width);
+		return -1;
+	}
+	if (backend_read(b, h, addr, width, &value) < 0) {
+		return -1;
+	}
+	value = (value & ~clear) | set;
+	if (backend_write(b, h, addr, width, value) < 0) {
+		return -1;
+	}
+	if (!verify) {
+		return 0;
+	}
+
+	if (backend_read(b, h, addr, width, &check) < 0) {
+		return -1;
+	}
+	if (check != value) {
+		iot_dev(h, dev);
+		fprintf(stderr, "%s register 0x%llx reads 0x%llx after "
+		        "writing 0x%llx\n", describe(b, dev),
+		        (unsigned long long)addr, (unsigned long long)check,
+		        (unsigned long long)value);
+		return -1;
+	}
+	return 0;
+}
+
+/* Take a trailing -v off the arguments of a read-modify-write command. */
+int
+parse_rmw_verify(int *argc, const char *argv[])
+{
+	if (*argc > 1 && !strcmp(argv[*argc - 1], "-v")) {
+		(*argc)--;
+		return 1;
+	}
+	return 0;
+}
+
+int
+backend_rmw_cmd(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct backend *b = info->privdata;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t vals[3];
+	struct iot_handle *h;
+	int width, verify;
+	int ret;
+
+	width = command_width(b, info);
+	if (width < 0) {
+		return -1;
+	}
+	verify = parse_rmw_verify(&argc, argv);
+	if (parse_reg_args(b, argc, argv, 3, dev, vals) < 0 ||
+	    check_addr(b, dev, vals[0]) < 0) {
+		return -1;
+	}
+
+	h = backend_open(b, dev, IOT_RDWR);
+	if (h == NULL) {
+		return -1;
+	}
+
+	ret = backend_modify(b, h, vals[0], width, vals[1], vals[2], verify);
+	put_handle(h);
+
+	return ret;
+}
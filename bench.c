@@ -0,0 +1,750 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Microbenchmarks.
+ *
+ * "bench [-n iterations] [-o file] [-r root] [-m addr]" times the pieces a
+ * command is made of, one operation at a time: opening, reading through
+ * and closing a handle of every backend, the raw pread() underneath, the
+ * dispatcher's steps, the output formats, the vector kernels of every level
+ * the CPU supports (see simd.h), mmio_dump's formatter and its loads of
+ * every width, and finally whole commands. Each case reports the mean and
+ * percentiles of its iterations; with -o the results are also written as
+ * one JSON object per line.
+ *
+ * By default the backends read a tree of regular files built in a temporary
+ * directory (see iot_set_root()), so the suite runs on any Linux box. -r
+ * names another tree, or / for the real hardware. MMIO and MEM are only
+ * measured on real hardware when -m gives a physical address that is safe
+ * to read.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "output.h"
+#include "simd.h"
+
+#define MAX_BENCH_RESULTS 96
+
+/* Where the stand-in tree keeps memory, and its size. */
+#define STANDIN_MEM_ADDR 0x100000
+#define STANDIN_MEM_SIZE 0x200000
+
+/* Size of the buffers the vector kernels work on. */
+#define SIMD_BUF_SIZE 4096
+
+struct bench_result {
+	char name[32];
+	long n;
+	uint64_t mean;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t max;
+};
+
+struct bench {
+	uint64_t *ns;    /* one sample per iteration */
+	long n;
+	struct bench_result results[MAX_BENCH_RESULTS];
+	int nresults;
+	int saved_stdout;
+};
+
+/* A register read by the backend cases. */
+struct bench_reg {
+	const char *name;
+	enum iot_space space;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t addr;
+	int width;
+};
+
+static const struct bench_reg file_regs[] = {
+	{ "pci", IOT_SPACE_PCI, { 0, 0, 0, 0 }, 0x0, 32 },
+	{ "msr", IOT_SPACE_MSR, { 0 }, 0x10, 64 },
+	{ "cmos", IOT_SPACE_CMOS, { 0 }, 0x20, 8 },
+};
+
+static uint64_t
+now_ns(void)
+{
+	return deadline_now_ns();
+}
+
+static int
+compare_u64(const void *pa, const void *pb)
+{
+	uint64_t a = *(const uint64_t *)pa, b = *(const uint64_t *)pb;
+
+	return a < b ? -1 : a > b;
+}
+
+/* Summarize the samples in b->ns as a result called name. */
+static void
+add_result(struct bench *b, const char *name)
+{
+	struct bench_result *r;
+	uint64_t sum = 0;
+	long i;
+
+	if (b->nresults == MAX_BENCH_RESULTS) {
+		return;
+	}
+	r = &b->results[b->nresults++];
+	snprintf(r->name, sizeof(r->name), "%s", name);
+
+	qsort(b->ns, b->n, sizeof(*b->ns), compare_u64);
+	for (i = 0; i < b->n; i++) {
+		sum += b->ns[i];
+	}
+	r->n = b->n;
+	r->mean = sum / b->n;
+	r->p50 = b->ns[b->n * 50 / 100];
+	r->p90 = b->ns[b->n * 90 / 100];
+	r->p99 = b->ns[b->n * 99 / 100];
+	r->max = b->ns[b->n - 1];
+}
+
+static void
+skip_case(const char *name, const char *why)
+{
+	fprintf(stderr, "bench: skipping %s: %s\n", name, why);
+}
+
+/* Command output goes to /dev/null while it is being measured. */
+static int
+hide_stdout(struct bench *b)
+{
+	int fd;
+
+	output_flush();
+	fd = open("/dev/null", O_WRONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	b->saved_stdout = dup(STDOUT_FILENO);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+	return 0;
+}
+
+static void
+restore_stdout(struct bench *b)
+{
+	output_flush();
+	dup2(b->saved_stdout, STDOUT_FILENO);
+	close(b->saved_stdout);
+}
+
+static void
+bench_clock(struct bench *b)
+{
+	uint64_t t0;
+	long i;
+
+	/* What every other sample includes. */
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		b->ns[i] = now_ns() - t0;
+	}
+	add_result(b, "clock");
+}
+
+static void
+bench_backend(struct bench *b, const struct bench_reg *reg)
+{
+	struct iot_handle *h;
+	uint64_t t0, t1, value, data;
+	uint64_t *close_ns;
+	char name[32];
+	long i;
+
+	h = iot_open(reg->space, reg->dev, IOT_RDONLY);
+	if (h == NULL || iot_read(h, reg->addr, reg->width, &value) < 0) {
+		skip_case(reg->name, strerror(errno));
+		iot_close(h);
+		return;
+	}
+	iot_close(h);
+
+	close_ns = calloc(b->n, sizeof(*close_ns));
+	if (close_ns == NULL) {
+		return;
+	}
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		h = iot_open(reg->space, reg->dev, IOT_RDONLY);
+		t1 = now_ns();
+		iot_close(h);
+		close_ns[i] = now_ns() - t1;
+		b->ns[i] = t1 - t0;
+	}
+	snprintf(name, sizeof(name), "%s.open", reg->name);
+	add_result(b, name);
+	memcpy(b->ns, close_ns, b->n * sizeof(*b->ns));
+	free(close_ns);
+	snprintf(name, sizeof(name), "%s.close", reg->name);
+	add_result(b, name);
+
+	h = iot_open(reg->space, reg->dev, IOT_RDONLY);
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		iot_read(h, reg->addr, reg->width, &value);
+		b->ns[i] = now_ns() - t0;
+	}
+	snprintf(name, sizeof(name), "%s.read%d", reg->name, reg->width);
+	add_result(b, name);
+
+	/* The system call alone, for the file based backends. */
+	if (iot_space_info(reg->space)->caps & IOT_CAP_PREAD &&
+	    iot_fd(h) >= 0 && reg->space != IOT_SPACE_CMOS) {
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			pread(iot_fd(h), &data, reg->width / 8, reg->addr);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "%s.pread", reg->name);
+		add_result(b, name);
+	}
+	iot_close(h);
+}
+
+static void
+bench_dispatch(struct bench *b)
+{
+	const char *argv[] = { "pci_read32", "0", "0", "0", "0", NULL };
+	const struct cmd_info *cmd = NULL;
+	uint64_t t0;
+	long i;
+
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		cmd = locate_command("pci_read32");
+		b->ns[i] = now_ns() - t0;
+	}
+	if (cmd == NULL) {
+		return;
+	}
+	add_result(b, "dispatch.locate_command");
+
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		check_prereqs(5, argv, cmd->params);
+		b->ns[i] = now_ns() - t0;
+	}
+	add_result(b, "dispatch.check_prereqs");
+}
+
+/* By enum output_format. */
+static const char *const format_names[] = { "text", "json", "csv", "bin" };
+
+static void
+bench_output(struct bench *b)
+{
+	const unsigned int dev[IOT_MAX_DEV_ARGS] = { 0, 0x1c, 0, 0 };
+	enum output_format saved = output_get_format();
+	char name[32];
+	uint64_t t0;
+	long i;
+	int f;
+
+	if (hide_stdout(b) < 0) {
+		skip_case("output", strerror(errno));
+		return;
+	}
+	for (f = 0; f < 4; f++) {
+		output_set_format(format_names[f]);
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			output_record(IOT_SPACE_PCI, dev, 4, 0x10, 32,
+			              0xfebf0000 + i, 0);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "output.%s", format_names[f]);
+		add_result(b, name);
+	}
+	output_set_format(format_names[saved]);
+	restore_stdout(b);
+}
+
+/* Every kernel of every vector level the CPU supports, on the same data. */
+static void
+bench_simd(struct bench *b)
+{
+	static const uint8_t pat[] = { 0xde, 0xad, 0xbe, 0xef };
+	const struct simd_ops *ops;
+	enum simd_level level;
+	uint8_t *src, *cmp, *dst;
+	char name[32];
+	uint64_t t0;
+	long i;
+
+	src = malloc(SIMD_BUF_SIZE);
+	cmp = malloc(SIMD_BUF_SIZE);
+	dst = malloc(2 * SIMD_BUF_SIZE);
+	if (src == NULL || cmp == NULL || dst == NULL) {
+		skip_case("simd", "out of memory");
+		goto out;
+	}
+	/* The pattern and the first difference come last. */
+	for (i = 0; i < SIMD_BUF_SIZE; i++) {
+		src[i] = i * 7;
+	}
+	memcpy(src + SIMD_BUF_SIZE - sizeof(pat), pat, sizeof(pat));
+	memcpy(cmp, src, SIMD_BUF_SIZE);
+	cmp[SIMD_BUF_SIZE - 1] ^= 1;
+
+	for (level = 0; (ops = simd_level_ops(level)) != NULL; level++) {
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			ops->hex((char *)dst, src, SIMD_BUF_SIZE / 4, 4, 0);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "simd.%s.hex",
+		         simd_level_name(level));
+		add_result(b, name);
+
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			ops->find(src, SIMD_BUF_SIZE, pat, sizeof(pat));
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "simd.%s.find",
+		         simd_level_name(level));
+		add_result(b, name);
+
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			ops->crc32c(0, src, SIMD_BUF_SIZE);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "simd.%s.crc32c",
+		         simd_level_name(level));
+		add_result(b, name);
+
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			ops->mismatch(src, cmp, SIMD_BUF_SIZE);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "simd.%s.mismatch",
+		         simd_level_name(level));
+		add_result(b, name);
+	}
+
+out:
+	free(src);
+	free(cmp);
+	free(dst);
+}
+
+/* mmio_dump's formatter as it was, one field at a time. */
+static void
+dump_by_field(uint64_t addr, const uint8_t *data, size_t len)
+{
+	uint32_t word;
+	size_t off;
+
+	for (off = 0; off < len; off += sizeof(word)) {
+		if (off % 16 == 0) {
+			output_hex(addr + off, 16, 0);
+			output_char(':');
+		}
+		memcpy(&word, data + off, sizeof(word));
+		output_char(' ');
+		output_hex(word, 8, 0);
+		if (off % 16 == 12) {
+			output_char('\n');
+		}
+	}
+}
+
+/* A page of mmio_dump text, by field and with the hex kernel of every
+ * vector level. The text format is forced as other formats need a handle to
+ * name the device. */
+static void
+bench_dump(struct bench *b)
+{
+	enum output_format format = output_get_format();
+	enum simd_level saved = simd_selected(), level;
+	char name[32];
+	uint8_t *src;
+	uint64_t t0;
+	long i;
+
+	src = malloc(SIMD_BUF_SIZE);
+	if (src == NULL) {
+		skip_case("dump", "out of memory");
+		return;
+	}
+	for (i = 0; i < SIMD_BUF_SIZE; i++) {
+		src[i] = i * 7;
+	}
+	if (hide_stdout(b) < 0) {
+		skip_case("dump", strerror(errno));
+		free(src);
+		return;
+	}
+
+	for (i = 0; i < b->n; i++) {
+		t0 = now_ns();
+		dump_by_field(STANDIN_MEM_ADDR, src, SIMD_BUF_SIZE);
+		b->ns[i] = now_ns() - t0;
+	}
+	add_result(b, "dump.field");
+
+	output_set_format("text");
+	for (level = 0; simd_level_ops(level) != NULL; level++) {
+		simd_select(level);
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			output_dump(NULL, STANDIN_MEM_ADDR, src, SIMD_BUF_SIZE,
+			            32);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "dump.%s", simd_level_name(level));
+		add_result(b, name);
+	}
+	simd_select(saved);
+	output_set_format(format_names[format]);
+
+	restore_stdout(b);
+	free(src);
+}
+
+/* A page of device memory, copied with loads of every width mmio_dump
+ * --width offers. */
+static void
+bench_loads(struct bench *b, const struct bench_reg *reg)
+{
+	static const int widths[] = { 8, 16, 32, 64, 128, 256, 512 };
+	const unsigned int dev[IOT_MAX_DEV_ARGS] = { 0 };
+	struct iot_handle *h;
+	volatile void *mem;
+	uint8_t *dst;
+	char name[32];
+	uint64_t t0;
+	long i;
+	int w;
+
+	h = iot_open(reg->space, dev, IOT_RDONLY);
+	mem = (h != NULL) ? iot_map(h, reg->addr, SIMD_BUF_SIZE) : NULL;
+	dst = malloc(SIMD_BUF_SIZE);
+	if (mem == NULL || dst == NULL) {
+		skip_case("loads", strerror(errno));
+		goto out;
+	}
+	for (w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+		if (!simd_load_supported(widths[w])) {
+			continue;
+		}
+		for (i = 0; i < b->n; i++) {
+			t0 = now_ns();
+			simd_load_io(dst, mem, SIMD_BUF_SIZE / (widths[w] / 8),
+			             widths[w]);
+			b->ns[i] = now_ns() - t0;
+		}
+		snprintf(name, sizeof(name), "%s.load%d", reg->name,
+		         widths[w]);
+		add_result(b, name);
+	}
+
+out:
+	free(dst);
+	iot_close(h);
+}
+
+/* Whole commands, located once and then dispatched the way the command
+ * line does, against the root the bench runs on. */
+static void
+bench_commands(struct bench *b)
+{
+	static const char *const cmds[][6] = {
+		{ "pci_read32", "0", "0", "0", "0", NULL },
+		{ "rdmsr", "0", "0x10", NULL },
+		{ "cmos_read", "0x20", NULL },
+	};
+	const struct cmd_info *cmd;
+	const char *argv[7];
+	char name[32];
+	uint64_t t0;
+	long i;
+	int c, argc, rc = 0;
+
+	for (c = 0; c < sizeof(cmds) / sizeof(cmds[0]); c++) {
+		for (argc = 0; cmds[c][argc] != NULL; argc++) {
+		}
+		cmd = locate_command(cmds[c][0]);
+		if (cmd == NULL) {
+			skip_case(cmds[c][0], "not built in");
+			continue;
+		}
+		if (hide_stdout(b) < 0) {
+			return;
+		}
+		for (i = 0; i < b->n; i++) {
+			memcpy(argv, cmds[c], sizeof(cmds[c]));
+			t0 = now_ns();
+			rc = run_nested_command(argc, argv, cmd);
+			b->ns[i] = now_ns() - t0;
+			if (rc < 0) {
+				break;
+			}
+		}
+		restore_stdout(b);
+		if (rc < 0) {
+			skip_case(cmds[c][0], "the command failed");
+			continue;
+		}
+		snprintf(name, sizeof(name), "cmd.%s", cmds[c][0]);
+		add_result(b, name);
+	}
+}
+
+static int
+make_file(const char *root, const char *path, off_t size,
+          const void *data, size_t len)
+{
+	char buf[PATH_MAX], *p;
+	int fd;
+
+	snprintf(buf, sizeof(buf), "%s/%s", root, path);
+	for (p = strchr(buf + strlen(root) + 1, '/'); p != NULL;
+	     p = strchr(p + 1, '/')) {
+		*p = '\0';
+		mkdir(buf, 0755);
+		*p = '/';
+	}
+	fd = open(buf, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, size) < 0 ||
+	    (len && pwrite(fd, data, len, 0) != len)) {
+		fprintf(stderr, "can't create %s: %s\n", buf, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+		}
+		return -1;
+	}
+	close(fd);
+	return 0;
+}
+
+static const char *const standin_files[] = {
+	"sys/bus/pci/devices/0000:00:00.0/config",
+	"dev/cpu/0/msr",
+	"dev/nvram",
+	"dev/mem",
+};
+
+/* Build a tree of regular files in place of the devices. */
+static int
+make_standins(char *root)
+{
+	static const uint8_t config[] = { 0x86, 0x80, 0x57, 0x0d };
+
+	if (mkdtemp(root) == NULL) {
+		fprintf(stderr, "can't create %s: %s\n", root, strerror(errno));
+		return -1;
+	}
+	if (make_file(root, standin_files[0], 4096, config, sizeof(config)) ||
+	    make_file(root, standin_files[1], 4096, NULL, 0) ||
+	    make_file(root, standin_files[2], 114, NULL, 0) ||
+	    make_file(root, standin_files[3], STANDIN_MEM_SIZE, NULL, 0)) {
+		return -1;
+	}
+	return 0;
+}
+
+static void
+remove_standins(const char *root)
+{
+	char buf[PATH_MAX], *p;
+	int i;
+
+	for (i = 0; i < sizeof(standin_files) / sizeof(standin_files[0]);
+	     i++) {
+		snprintf(buf, sizeof(buf), "%s/%s", root, standin_files[i]);
+		unlink(buf);
+		/* Then every directory above it that is now empty. */
+		while ((p = strrchr(buf, '/')) != NULL &&
+		       p > buf + strlen(root)) {
+			*p = '\0';
+			rmdir(buf);
+		}
+	}
+	rmdir(root);
+}
+
+static void
+print_results(const struct bench *b)
+{
+	const struct bench_result *r;
+	char buf[160];
+	int i;
+
+	snprintf(buf, sizeof(buf), "%-24s %10s %10s %10s %10s %10s\n",
+	         "case (ns)", "mean", "p50", "p90", "p99", "max");
+	output_str(buf);
+	for (i = 0; i < b->nresults; i++) {
+		r = &b->results[i];
+		snprintf(buf, sizeof(buf), "%-24s %10llu %10llu %10llu %10llu "
+		         "%10llu\n", r->name, (unsigned long long)r->mean,
+		         (unsigned long long)r->p50, (unsigned long long)r->p90,
+		         (unsigned long long)r->p99, (unsigned long long)r->max);
+		output_str(buf);
+	}
+}
+
+static int
+write_results(const struct bench *b, const char *path, const char *root)
+{
+	const struct bench_result *r;
+	FILE *f;
+	int i;
+
+	f = fopen(path, "w");
+	if (f == NULL) {
+		fprintf(stderr, "can't create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < b->nresults; i++) {
+		r = &b->results[i];
+		fprintf(f, "{\"case\":\"%s\",\"root\":\"%s\",\"iterations\":%ld,"
+		        "\"mean_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+		        "\"p99_ns\":%llu,\"max_ns\":%llu}\n", r->name, root,
+		        r->n, (unsigned long long)r->mean,
+		        (unsigned long long)r->p50, (unsigned long long)r->p90,
+		        (unsigned long long)r->p99, (unsigned long long)r->max);
+	}
+	if (fclose(f) != 0) {
+		fprintf(stderr, "can't write %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+static int
+bench(int argc, const char *argv[], const struct cmd_info *info)
+{
+	char standin_root[] = "/tmp/iotools-bench.XXXXXX";
+	const char *root = NULL, *out = NULL;
+	char saved_root[PATH_MAX];
+	struct bench_reg mem_regs[2] = {
+		{ "mmio", IOT_SPACE_MMIO, { 0 }, STANDIN_MEM_ADDR, 32 },
+		{ "mem", IOT_SPACE_MEM, { 0 }, STANDIN_MEM_ADDR, 32 },
+	};
+	int mem_given = 0, arg, i, rc = -1;
+	struct bench b;
+	char *end;
+
+	memset(&b, 0, sizeof(b));
+	b.n = 10000;
+
+	for (arg = 1; arg < argc; arg += 2) {
+		if (arg + 1 == argc) {
+			goto usage;
+		}
+		if (!strcmp(argv[arg], "-n")) {
+			b.n = strtol(argv[arg + 1], &end, 0);
+			if (*end != '\0' || b.n < 1) {
+				fprintf(stderr, "bad iteration count '%s'\n",
+				        argv[arg + 1]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "-o")) {
+			out = argv[arg + 1];
+		} else if (!strcmp(argv[arg], "-r")) {
+			root = argv[arg + 1];
+		} else if (!strcmp(argv[arg], "-m")) {
+			mem_regs[0].addr = strtoull(argv[arg + 1], NULL, 0);
+			mem_regs[1].addr = mem_regs[0].addr;
+			mem_given = 1;
+		} else {
+			goto usage;
+		}
+	}
+
+	b.ns = calloc(b.n, sizeof(*b.ns));
+	if (b.ns == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+	/* A --sysroot in effect is restored afterwards. */
+	snprintf(saved_root, sizeof(saved_root), "%s", iot_get_root());
+	if (root == NULL) {
+		root = standin_root;
+		mem_given = 1;
+		if (make_standins(standin_root) < 0) {
+			goto done;
+		}
+	}
+	if (iot_set_root(root) < 0) {
+		fprintf(stderr, "bad root %s: %s\n", root, strerror(errno));
+		goto done;
+	}
+
+	bench_clock(&b);
+	for (i = 0; i < sizeof(file_regs) / sizeof(file_regs[0]); i++) {
+		bench_backend(&b, &file_regs[i]);
+	}
+	if (mem_given) {
+		bench_backend(&b, &mem_regs[0]);
+		bench_backend(&b, &mem_regs[1]);
+		bench_loads(&b, &mem_regs[0]);
+	} else {
+		skip_case("mmio and mem", "no address given with -m");
+	}
+	bench_dispatch(&b);
+	bench_output(&b);
+	bench_simd(&b);
+	bench_dump(&b);
+	bench_commands(&b);
+
+	print_results(&b);
+	rc = (out != NULL) ? write_results(&b, out, root) : 0;
+
+done:
+	iot_set_root(saved_root);
+	if (root == standin_root) {
+		remove_standins(standin_root);
+	}
+	free(b.ns);
+	return rc;
+
+usage:
+	fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+	return -1;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(bench_params, 1, 9,
+                            "[-n iterations] [-o file] [-r root] [-m addr]",
+                            0);
+
+static const struct cmd_info bench_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(bench, bench, NULL, &bench_params),
+};
+
+MAKE_CMD_GROUP(BENCH, "commands to measure iotools itself", bench_cmds);
+REGISTER_CMD_GROUP(BENCH);
@@ -0,0 +1,472 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Device file broker.
+ *
+ * "iotools_broker [-s socket] [-m mode] <policy>" runs privileged and hands
+ * device files to unprivileged clients over the protocol in broker.h. The
+ * policy file lists what may be handed out, one rule per line:
+ *
+ *	msr <cpu> [options]
+ *	pci <segment> <bus> <device> <function> [options]
+ *	bar <segment> <bus> <device> <function> <bar> [options]
+ *	smbus <adapter> [options]
+ *
+ * Every selector is a number, a range <first>-<last> or "*". Files are
+ * handed out read only unless the rule has the option "rw". i2c adapters
+ * are always opened read/write, so smbus rules need it too. "uid=N" and
+ * "gid=N" restrict a rule to clients with that user or primary group id.
+ * # starts a comment. For example:
+ *
+ *	msr * uid=1000
+ *	pci 0 0-0x7f * *
+ *	bar 0 3 0 0 2 rw gid=50
+ *	smbus 0-3
+ *
+ * Requests that no rule allows are refused with EACCES and logged on
+ * stderr. Clients use the broker through --broker, see iot_set_broker().
+ * Every client connection is served by its own thread, like iotoolsd's.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "commands.h"
+#include "broker.h"
+
+#define MAX_RULES 256
+#define MAX_SELECTORS 5
+
+enum broker_kind {
+	BROKER_MSR,
+	BROKER_PCI,
+	BROKER_BAR,
+	BROKER_SMBUS,
+};
+
+struct kind_desc {
+	const char *name;
+	int nsel;
+};
+
+static const struct kind_desc kinds[] = {
+	[BROKER_MSR] = { "msr", 1 },
+	[BROKER_PCI] = { "pci", 4 },
+	[BROKER_BAR] = { "bar", 5 },
+	[BROKER_SMBUS] = { "smbus", 1 },
+};
+
+struct broker_rule {
+	enum broker_kind kind;
+	unsigned long lo[MAX_SELECTORS];
+	unsigned long hi[MAX_SELECTORS];
+	int rw;
+	long uid;   /* -1 for any */
+	long gid;
+};
+
+static struct broker_rule rules[MAX_RULES];
+static int nrules;
+
+/* A device file named in a request. */
+struct broker_dev {
+	enum broker_kind kind;
+	unsigned long sel[MAX_SELECTORS];
+};
+
+static int
+parse_selector(const char *arg, unsigned long *lo, unsigned long *hi)
+{
+	char *end;
+
+	if (!strcmp(arg, "*")) {
+		*lo = 0;
+		*hi = ULONG_MAX;
+		return 0;
+	}
+	*lo = strtoul(arg, &end, 0);
+	if (end == arg) {
+		return -1;
+	}
+	*hi = *lo;
+	if (*end == '-') {
+		arg = end + 1;
+		*hi = strtoul(arg, &end, 0);
+		if (end == arg || *hi < *lo) {
+			return -1;
+		}
+	}
+	return *end == '\0' ? 0 : -1;
+}
+
+static int
+parse_rule(int argc, const char *argv[], struct broker_rule *r)
+{
+	char *end;
+	int i;
+
+	for (i = 0; i < arraysize(kinds); i++) {
+		if (!strcmp(argv[0], kinds[i].name)) {
+			break;
+		}
+	}
+	if (i == arraysize(kinds) || argc < 1 + kinds[i].nsel) {
+		return -1;
+	}
+	memset(r, 0, sizeof(*r));
+	r->kind = i;
+	r->uid = -1;
+	r->gid = -1;
+	for (i = 0; i < kinds[r->kind].nsel; i++) {
+		if (parse_selector(argv[1 + i], &r->lo[i], &r->hi[i]) < 0) {
+			return -1;
+		}
+	}
+
+	for (i = 1 + kinds[r->kind].nsel; i < argc; i++) {
+		if (!strcmp(argv[i], "rw")) {
+			r->rw = 1;
+		} else if (!strncmp(argv[i], "uid=", 4)) {
+			r->uid = strtol(argv[i] + 4, &end, 0);
+			if (end == argv[i] + 4 || *end != '\0') {
+				return -1;
+			}
+		} else if (!strncmp(argv[i], "gid=", 4)) {
+			r->gid = strtol(argv[i] + 4, &end, 0);
+			if (end == argv[i] + 4 || *end != '\0') {
+				return -1;
+			}
+		} else {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+load_policy(const char *path)
+{
+	const char *argv[MAX_SELECTORS + 8];
+	char *line = NULL;
+	size_t size = 0;
+	int lineno = 0, argc, rc = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "fopen(%s): %s\n", path, strerror(errno));
+		return -1;
+	}
+	nrules = 0;
+	while (getline(&line, &size, f) >= 0) {
+		lineno++;
+		argc = split_args(line, argv, arraysize(argv) - 1);
+		if (argc == 0) {
+			continue;
+		}
+		if (argc < 0 || parse_rule(argc, argv, &rules[nrules]) < 0) {
+			fprintf(stderr, "%s:%d: bad rule\n", path, lineno);
+			rc = -1;
+			break;
+		}
+		if (++nrules == MAX_RULES) {
+			fprintf(stderr, "%s:%d: more than %d rules\n", path,
+			        lineno, MAX_RULES);
+			rc = -1;
+			break;
+		}
+	}
+	free(line);
+	fclose(f);
+	return rc;
+}
+
+/*
+ * Work out which device a path names. The path is printed again from the
+ * values found and must come out the same, so that nothing but the exact
+ * file names in broker.h (no "..", no extra slashes, no other files) gets
+ * through.
+ */
+static int
+parse_dev_path(const char *path, struct broker_dev *d)
+{
+	char canon[IOTOOLS_BROKER_PATH_MAX + 32];
+	unsigned int v[MAX_SELECTORS];
+	int n = -1;
+
+	memset(d, 0, sizeof(*d));
+	if (sscanf(path, "/dev/cpu/%u/msr%n", &v[0], &n) == 1 && n > 0) {
+		d->kind = BROKER_MSR;
+		snprintf(canon, sizeof(canon), "/dev/cpu/%u/msr", v[0]);
+	} else if (sscanf(path, "/dev/i2c-%u%n", &v[0], &n) == 1 && n > 0) {
+		d->kind = BROKER_SMBUS;
+		snprintf(canon, sizeof(canon), "/dev/i2c-%u", v[0]);
+	} else if (sscanf(path, "/sys/bus/pci/devices/%x:%x:%x.%x/config%n",
+	                  &v[0], &v[1], &v[2], &v[3], &n) == 4 && n > 0) {
+		d->kind = BROKER_PCI;
+		snprintf(canon, sizeof(canon),
+		         "/sys/bus/pci/devices/%04x:%02x:%02x.%x/config",
+		         v[0], v[1], v[2], v[3]);
+	} else if (sscanf(path, "/sys/bus/pci/devices/%x:%x:%x.%x/resource%u%n",
+	                  &v[0], &v[1], &v[2], &v[3], &v[4], &n) == 5 &&
+	           n > 0) {
+		d->kind = BROKER_BAR;
+		snprintf(canon, sizeof(canon),
+		         "/sys/bus/pci/devices/%04x:%02x:%02x.%x/resource%u",
+		         v[0], v[1], v[2], v[3], v[4]);
+	} else {
+		return -1;
+	}
+	if (strcmp(path, canon)) {
+		return -1;
+	}
+	for (n = 0; n < kinds[d->kind].nsel; n++) {
+		d->sel[n] = v[n];
+	}
+	return 0;
+}
+
+static int
+allowed(const struct broker_dev *d, int rw, const struct ucred *cred)
+{
+	const struct broker_rule *r;
+	int i, j;
+
+	for (i = 0; i < nrules; i++) {
+		r = &rules[i];
+		if (r->kind != d->kind || (rw && !r->rw) ||
+		    (r->uid >= 0 && r->uid != cred->uid) ||
+		    (r->gid >= 0 && r->gid != cred->gid)) {
+			continue;
+		}
+		for (j = 0; j < kinds[d->kind].nsel; j++) {
+			if (d->sel[j] < r->lo[j] || d->sel[j] > r->hi[j]) {
+				break;
+			}
+		}
+		if (j == kinds[d->kind].nsel) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Open the file a request names, or return a negative errno. */
+static int
+open_request(struct iotools_broker_request *req, const struct ucred *cred)
+{
+	int rw = (req->flags & IOTOOLS_BROKER_RDWR) != 0;
+	char path[PATH_MAX];
+	struct broker_dev d;
+	int fd;
+
+	req->path[sizeof(req->path) - 1] = '\0';
+	if (parse_dev_path(req->path, &d) < 0 || !allowed(&d, rw, cred)) {
+		fprintf(stderr, "iotools_broker: denied %s%s to uid %u pid %d\n",
+		        req->path, rw ? " (rw)" : "", (unsigned int)cred->uid,
+		        (int)cred->pid);
+		return -EACCES;
+	}
+
+	snprintf(path, sizeof(path), "%s%s", iot_get_root(), req->path);
+	fd = open(path, (rw ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+	return fd < 0 ? -errno : fd;
+}
+
+static int
+send_response(int sock, int status, int fd)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct iotools_broker_response resp;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	ssize_t r;
+
+	memset(&resp, 0, sizeof(resp));
+	resp.status = status;
+	iov.iov_base = &resp;
+	iov.iov_len = sizeof(resp);
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (fd >= 0) {
+		memset(&control, 0, sizeof(control));
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	do {
+		r = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	} while (r < 0 && errno == EINTR);
+
+	return r == sizeof(resp) ? 0 : -1;
+}
+
+/* Serve one client connection until it hangs up. */
+static void *
+serve_client(void *arg)
+{
+	int sock = (int)(intptr_t)arg;
+	struct iotools_broker_request req;
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	size_t have = 0;
+	ssize_t r;
+	int fd;
+
+	if (getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		close(sock);
+		return NULL;
+	}
+
+	for (;;) {
+		r = read(sock, (char *)&req + have, sizeof(req) - have);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		have += r;
+		if (have < sizeof(req))
+			continue;
+		have = 0;
+
+		fd = open_request(&req, &cred);
+		r = send_response(sock, fd < 0 ? fd : 0, fd);
+		if (fd >= 0)
+			close(fd);
+		if (r < 0)
+			break;
+	}
+	close(sock);
+	return NULL;
+}
+
+static int
+iotools_broker(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const char *path = IOTOOLS_BROKER_DEFAULT_SOCKET;
+	mode_t mode = 0666;
+	struct sockaddr_un sun;
+	pthread_attr_t attr;
+	int arg, sock;
+
+	for (arg = 1; arg + 1 < argc; arg += 2) {
+		if (!strcmp(argv[arg], "-s")) {
+			path = argv[arg + 1];
+		} else if (!strcmp(argv[arg], "-m")) {
+			mode = strtoul(argv[arg + 1], NULL, 8);
+		} else {
+			break;
+		}
+	}
+	if (argc - arg != 1) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+		return -1;
+	}
+	if (load_policy(argv[arg]) < 0) {
+		return -1;
+	}
+
+	memset(&sun, 0, sizeof(sun));
+	sun.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(sun.sun_path, path);
+
+	signal(SIGPIPE, SIG_IGN);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		fprintf(stderr, "socket(): %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* Unprivileged clients must be able to connect; the policy decides
+	 * what they get. */
+	unlink(path);
+	if (bind(sock, (struct sockaddr *)&sun, sizeof(sun)) < 0 ||
+	    chmod(path, mode) < 0) {
+		fprintf(stderr, "bind(%s): %s\n", path, strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	if (listen(sock, SOMAXCONN) < 0) {
+		fprintf(stderr, "listen(): %s\n", strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (;;) {
+		pthread_t thread;
+		int fd = accept(sock, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "accept(): %s\n", strerror(errno));
+			break;
+		}
+		if (pthread_create(&thread, &attr, serve_client,
+		                   (void *)(intptr_t)fd) != 0) {
+			fprintf(stderr, "can't create client thread\n");
+			close(fd);
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+	close(sock);
+	return -1;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(broker_params, 2, 6,
+                            "[-s socket] [-m mode] <policy>", 0);
+
+static const struct cmd_info broker_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(iotools_broker, &iotools_broker, NULL,
+	                     &broker_params),
+};
+
+MAKE_CMD_GROUP(BROKER, "device file broker for unprivileged clients",
+               broker_cmds);
+REGISTER_CMD_GROUP(BROKER);
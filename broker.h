@@ -0,0 +1,62 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _BROKER_H_
+#define _BROKER_H_
+
+/*
+ * Wire protocol of the iotools device broker.
+ *
+ * The broker runs privileged and hands open device files to unprivileged
+ * clients. A client connects to a local SOCK_STREAM unix socket and writes
+ * fixed size requests naming a device file by its usual path; the broker
+ * answers each with a fixed size response, in order. A successful response
+ * carries the open file descriptor as SCM_RIGHTS ancillary data, after
+ * which the client accesses the device directly. Only these files are
+ * handed out, and only as far as the broker's policy allows:
+ *
+ *	/dev/cpu/N/msr
+ *	/sys/bus/pci/devices/SSSS:BB:DD.F/config
+ *	/sys/bus/pci/devices/SSSS:BB:DD.F/resourceN
+ *	/dev/i2c-N
+ *
+ * All fields are in host byte order since both ends live on the same
+ * machine.
+ */
+
+#include <stdint.h>
+
+#define IOTOOLS_BROKER_DEFAULT_SOCKET "/run/iotools-broker.sock"
+
+#define IOTOOLS_BROKER_PATH_MAX 128
+
+/* Request flags. */
+#define IOTOOLS_BROKER_RDWR 0x1  /* open for writing too */
+
+struct iotools_broker_request {
+	uint32_t flags;
+	uint32_t reserved;
+	char path[IOTOOLS_BROKER_PATH_MAX];  /* NUL terminated */
+};
+
+struct iotools_broker_response {
+	int32_t status;    /* 0 with a descriptor attached, or negative errno */
+	uint32_t reserved;
+};
+
+#endif /* _BROKER_H_ */
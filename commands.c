@@ -21,8 +21,12 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/stat.h>
 #include "commands.h"
+#include "output.h"
 #include "platform.h"
+#include "regmap.h"
 #ifdef ARCH_X86
 #include <sys/io.h>
 #endif /* #ifdef ARCH_X86 */
@@ -42,7 +46,7 @@ MAKE_SIZE_PARAM(64);
 
 static struct cmd_group *group_head;
 
-static const struct cmd_info *
+const struct cmd_info *
 locate_command(const char *cmd)
 {
 	int i;
@@ -59,7 +63,7 @@ locate_command(const char *cmd)
 	return NULL;
 }
 
-static int
+int
 check_prereqs(int argc, const char *argv[], const struct prereq_params *params)
 {
 	/* If there are no prerequisites the check has succeeded. */
@@ -68,7 +72,9 @@ check_prereqs(int argc, const char *argv[], const struct prereq_params *params)
 	}
 
 	if (argc < params->min_args || argc > params->max_args) {
-		fprintf(stderr, "usage: %s %s\n", argv[0], params->usage);
+		fprintf(stderr, "usage: %s %s%s\n", argv[0], params->usage,
+		        params->sampling ?
+		        " [--repeat N] [--interval T] [--summary]" : "");
 		return -1;
 	}
 
@@ -83,21 +89,212 @@ check_prereqs(int argc, const char *argv[], const struct prereq_params *params)
 	return 0;
 }
 
+/* Trace file named by --trace or IOTOOLS_TRACE. Recording starts with the
+ * first command and lasts until the process exits. */
+static const char *trace_path;
+static int trace_started;
+
 static int
-_run_command(int argc, const char *argv[], const struct cmd_info *cmd_info)
+start_trace(void)
 {
-	if (check_prereqs(argc, argv, cmd_info->params) < 0) {
+	if (trace_path == NULL || trace_started) {
+		return 0;
+	}
+	if (iot_trace_start(trace_path, 0) < 0) {
+		fprintf(stderr, "can't record trace %s: %s\n", trace_path,
+		        strerror(errno));
 		return -1;
 	}
+	trace_started = 1;
+	atexit(iot_trace_stop);
+
+	return 0;
+}
 
+static int
+dispatch_command(int argc, const char *argv[],
+                 const struct cmd_info *cmd_info)
+{
+	if (parse_sample_options(&argc, argv, cmd_info->params != NULL &&
+	                         cmd_info->params->sampling) < 0 ||
+	    check_prereqs(argc, argv, cmd_info->params) < 0) {
+		return -1;
+	}
 	return cmd_info->entry(argc, argv, cmd_info);
 }
 
+static int
+command_done(int rc)
+{
+	if (output_command_done() < 0 && rc == 0) {
+		fprintf(stderr, "write(stdout): %s\n", strerror(errno));
+		rc = -1;
+	}
+	return rc;
+}
+
+static int
+_run_command(int argc, const char *argv[], const struct cmd_info *cmd_info)
+{
+	int rc;
+
+	stats_dispatched();
+	if (start_trace() < 0) {
+		rc = -1;
+	} else {
+		rc = dispatch_command(argc, argv, cmd_info);
+	}
+	stats_report(cmd_info->name, rc);
+
+	return command_done(rc);
+}
+
+int
+run_nested_command(int argc, const char *argv[],
+                   const struct cmd_info *cmd_info)
+{
+	return command_done(dispatch_command(argc, argv, cmd_info));
+}
+
+/* Select the batch engine named by --engine or IOTOOLS_ENGINE. */
+static int
+set_engine(const char *name)
+{
+	enum iot_engine e;
+
+	for (e = 0; e < IOT_ENGINE_MAX; e++) {
+		if (strcmp(name, iot_engine_name(e))) {
+			continue;
+		}
+		if (iot_set_engine(e) < 0) {
+			fprintf(stderr, "can't use the %s engine: %s\n", name,
+			        strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "unknown engine '%s'\n", name);
+	return -1;
+}
+
+/* Look for devices below the stand-in tree named by --sysroot or
+ * IOTOOLS_ROOT. */
+static int
+set_sysroot(const char *root)
+{
+	if (iot_set_root(root) < 0) {
+		if (errno == EINVAL) {
+			fprintf(stderr, "%s/effects: bad register effects\n",
+			        root);
+		} else {
+			fprintf(stderr, "can't use root %s: %s\n", root,
+			        strerror(errno));
+		}
+		return -1;
+	}
+	/* Batch mode must not hand out handles to the old devices. */
+	close_all_handles();
+	return 0;
+}
+
+/* Obtain device files from the broker named by --broker or IOTOOLS_BROKER. */
+static int
+set_broker(const char *path)
+{
+	if (iot_set_broker(path) < 0) {
+		fprintf(stderr, "can't connect to broker %s: %s\n", path,
+		        strerror(errno));
+		return -1;
+	}
+	close_all_handles();
+	return 0;
+}
+
+/* Register map named by --regmap or IOTOOLS_REGMAP. */
+static int
+set_regmap(const char *path)
+{
+	return regmap_load(path);
+}
+
+/* Consume options that apply to every subcommand. They must directly follow
+ * argv[0], e.g. 'iotools --stats pci_read32 0 0 0 0' or
+ * 'pci_read32 --format=json 0 0 0 0'. */
+static int
+parse_global_options(int *argc, const char **argv[])
+{
+	while (*argc > 1) {
+		const char *opt = (*argv)[1];
+
+		if (!strcmp(opt, "--stats")) {
+			stats_enable();
+		} else if (!strncmp(opt, "--format=", 9)) {
+			if (output_set_format(opt + 9) < 0) {
+				return -1;
+			}
+		} else if (!strncmp(opt, "--trace=", 8) && opt[8] != '\0') {
+			trace_path = opt + 8;
+		} else if (!strncmp(opt, "--engine=", 9)) {
+			if (set_engine(opt + 9) < 0) {
+				return -1;
+			}
+		} else if (!strncmp(opt, "--sysroot=", 10)) {
+			if (set_sysroot(opt + 10) < 0) {
+				return -1;
+			}
+		} else if (!strncmp(opt, "--broker=", 9)) {
+			if (set_broker(opt + 9) < 0) {
+				return -1;
+			}
+		} else if (!strncmp(opt, "--regmap=", 9)) {
+			if (set_regmap(opt + 9) < 0) {
+				return -1;
+			}
+		} else {
+			break;
+		}
+
+		/* Drop the option, keeping argv[0] in place. */
+		(*argv)[1] = (*argv)[0];
+		(*argv)++;
+		(*argc)--;
+	}
+
+	return 0;
+}
+
 int
 run_command(int argc, const char *argv[])
 {
 	const struct cmd_info *cmd_info;
-	const char *cmd_name;
+	const char *cmd_name, *engine, *root, *broker, *regmap;
+
+	stats_enable_from_env();
+	trace_path = getenv("IOTOOLS_TRACE");
+	if (trace_path != NULL && *trace_path == '\0') {
+		trace_path = NULL;
+	}
+	engine = getenv("IOTOOLS_ENGINE");
+	if (engine != NULL && *engine != '\0' && set_engine(engine) < 0) {
+		return -1;
+	}
+	root = getenv("IOTOOLS_ROOT");
+	if (root != NULL && *root != '\0' && set_sysroot(root) < 0) {
+		return -1;
+	}
+	broker = getenv("IOTOOLS_BROKER");
+	if (broker != NULL && *broker != '\0' && set_broker(broker) < 0) {
+		return -1;
+	}
+	regmap = getenv("IOTOOLS_REGMAP");
+	if (regmap != NULL && *regmap != '\0' && set_regmap(regmap) < 0) {
+		return -1;
+	}
+	if (parse_global_options(&argc, &argv) < 0) {
+		return -1;
+	}
+	stats_start();
 
 	/* First check if the 1st parameter is a command that exists.
 	 * i.e. iotools io_read8 0x70 */
@@ -105,7 +302,12 @@ run_command(int argc, const char *argv[])
 		cmd_info = locate_command(argv[1]);
 		/* If command is found, execute it directly. */
 		if (cmd_info != NULL) {
-			return _run_command(--argc, ++argv, cmd_info);
+			--argc;
+			++argv;
+			if (parse_global_options(&argc, &argv) < 0) {
+				return -1;
+			}
+			return _run_command(argc, argv, cmd_info);
 		}
 	}
 
@@ -123,6 +325,130 @@ run_command(int argc, const char *argv[])
 	return iotools_fallback(argc, argv);
 }
 
+#define MAX_BATCH_ARGS 64
+
+int
+split_args(char *line, const char *argv[], int max_args)
+{
+	int argc = 0;
+	char *p = line;
+
+	while (*p) {
+		while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+			*p++ = '\0';
+		}
+		if (*p == '\0' || *p == '#') {
+			break;
+		}
+		if (argc == max_args) {
+			return -1;
+		}
+		argv[argc++] = p;
+		while (*p && *p != ' ' && *p != '\t' && *p != '\n' &&
+		       *p != '\r') {
+			p++;
+		}
+	}
+	*p = '\0';
+	argv[argc] = NULL;
+
+	return argc;
+}
+
+/* Returns non-zero if reading fd will not block. */
+static int
+input_pending(int fd)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, 0) > 0;
+}
+
+/* Run one subcommand per line read from filename ("-" for stdin). Device
+ * file handles are kept open across lines. Global options may follow the
+ * command name, as on the command line, and stay in effect for the lines
+ * after it. Execution stops at the first command that fails. */
+int
+run_batch(const char *filename)
+{
+	FILE *fp;
+	char *line = NULL;
+	size_t line_size = 0;
+	const char *argv[MAX_BATCH_ARGS + 1], **args;
+	const struct cmd_info *cmd_info;
+	struct stat st;
+	int interactive;
+	int lineno = 0;
+	int argc;
+	int ret = 0;
+
+	if (!strcmp(filename, "-")) {
+		fp = stdin;
+	} else {
+		fp = fopen(filename, "r");
+		if (fp == NULL) {
+			fprintf(stderr, "fopen(%s): %s\n",
+			        filename, strerror(errno));
+			return -1;
+		}
+	}
+
+	/* Output is only written out when the buffer fills up, unless the
+	 * commands come from a pipe or terminal and the next read would
+	 * block: the other end may be waiting for the results. */
+	interactive = fstat(fileno(fp), &st) < 0 || !S_ISREG(st.st_mode);
+
+	set_handle_caching(1);
+	output_batching(1);
+
+	for (;;) {
+		if (interactive && !input_pending(fileno(fp))) {
+			output_flush();
+		}
+		if (getline(&line, &line_size, fp) < 0) {
+			break;
+		}
+		lineno++;
+		argc = split_args(line, argv, MAX_BATCH_ARGS);
+		if (argc == 0) {
+			continue;
+		}
+		if (argc < 0) {
+			fprintf(stderr, "%s:%d: too many arguments\n",
+			        filename, lineno);
+			ret = -1;
+			break;
+		}
+
+		stats_start();
+		cmd_info = locate_command(argv[0]);
+		if (cmd_info == NULL) {
+			fprintf(stderr, "%s:%d: unknown command '%s'\n",
+			        filename, lineno, argv[0]);
+			ret = -1;
+			break;
+		}
+
+		args = argv;
+		if (parse_global_options(&argc, &args) < 0 ||
+		    _run_command(argc, args, cmd_info) < 0) {
+			fprintf(stderr, "%s:%d: '%s' failed\n",
+			        filename, lineno, argv[0]);
+			ret = -1;
+			break;
+		}
+	}
+
+	output_batching(0);
+	set_handle_caching(0);
+	free(line);
+	if (fp != stdin) {
+		fclose(fp);
+	}
+
+	return ret;
+}
+
 static int
 locate_path_of_binary(char **path_to_bin, char **bin_name)
 {
@@ -19,7 +19,9 @@
 #ifndef _COMMANDS_H_
 #define _COMMANDS_H_
 
+#include <signal.h>
 #include <stdint.h>
+#include "libiotools.h"
 
 /* This is a shared data type to handle different type sizes for subcommands. */
 typedef union {
@@ -59,6 +61,7 @@ struct prereq_params {
 	int max_args;      /* Maxiumum number of arguments required. */
 	const char *usage; /* Usage string - requires 1st param %s for arv[0] */
 	int iopl_needed;   /* non-zero if iopl needed. */
+	int sampling;      /* non-zero if --repeat/--interval/--summary apply. */
 };
 
 #define _PREREQ_PARAMS_VAR_ARGS(min_args_, max_args_, usage_, iopl_) \
@@ -77,6 +80,17 @@ struct prereq_params {
 	static const struct prereq_params name_ = \
 		_PREREQ_PARAMS_VAR_ARGS(min_args_, max_args_, usage_, iopl_)
 
+/* Register reads that can be repeated, see backend_sample(). The sampling
+ * options are taken off the argument list before it is counted. */
+#define MAKE_PREREQ_PARAMS_SAMPLED(name_, min_args_, max_args_, usage_, iopl_)\
+	static const struct prereq_params name_ = { \
+		.min_args = min_args_, \
+		.max_args = max_args_, \
+		.usage = usage_, \
+		.iopl_needed = iopl_, \
+		.sampling = 1, \
+	}
+
 struct cmd_group
 {
 	const char *name;
@@ -135,11 +149,212 @@ struct cmd_info
 
 
 int run_command(int argc, const char *argv[]);
+/* The steps of dispatching a command, for the benchmarks.
+ * run_nested_command() runs a located command from within another one: the
+ * environment, global options, tracing and stats stay as the outer command
+ * set them up. argv[0] is the command name. */
+const struct cmd_info *locate_command(const char *cmd);
+int run_nested_command(int argc, const char *argv[],
+                       const struct cmd_info *cmd_info);
+int check_prereqs(int argc, const char *argv[],
+                  const struct prereq_params *params);
 int make_command_links(void);
 int clean_command_links(void);
 int list_commands(void);
 int iotools_fallback(int argc, const char *argv[]);
 int register_command_group(struct cmd_group *group);
+int run_batch(const char *filename);
+
+/* Split a line into whitespace separated arguments in place, as batch mode
+ * does. Anything following a '#' is a comment. Returns the number of
+ * arguments found, or -1 if there are more than max_args; argv needs room
+ * for max_args + 1 entries. */
+int split_args(char *line, const char *argv[], int max_args);
+
+/* Register handles. Subcommands should obtain libiotools handles with
+ * get_handle() and give them back with put_handle() so that batch mode can
+ * keep them open between commands. dev may be NULL for address spaces
+ * without a device selector. */
+struct iot_handle *get_handle(enum iot_space space, const unsigned int *dev,
+                              int flags);
+void put_handle(struct iot_handle *h);
+void set_handle_caching(int enable);
+void close_all_handles(void);
+
+struct cached_handle {
+	enum iot_space space;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	int flags;
+	struct iot_handle *h;
+	int refs;                /* holders, in the batch mode cache */
+};
+
+/* A set of handles a long running command (a script, a replay) keeps open
+ * until it is done, whether or not batch mode caches them. Start from a
+ * zeroed set; handle_set_release() gives all handles back. Beyond
+ * HANDLE_SET_SIZE devices the set gives back older handles to make room and
+ * counts them in recycled, so a command that keeps its handles must check
+ * that recycled is still 0 after opening them all. */
+#define HANDLE_SET_SIZE 64
+
+struct handle_set {
+	struct cached_handle handles[HANDLE_SET_SIZE];
+	int num_handles;
+	int next_victim;
+	int recycled;
+};
+
+struct iot_handle *handle_set_get(struct handle_set *set,
+                                  enum iot_space space,
+                                  const unsigned int *dev, int flags);
+void handle_set_release(struct handle_set *set);
+
+/*
+ * Register spaces as seen from the command line. Each command group
+ * describes its address space with a struct backend; the helpers below then
+ * provide device handling, error reporting and the generic register commands
+ * for it.
+ *
+ * backend_read_cmd() and backend_write_cmd() take the backend as their
+ * privdata. Their arguments are the device selector values of the address
+ * space, the register address and, for writes, the value. The access width
+ * is the command size unless the backend has a fixed width. Reads also
+ * accept a register range, see parse_reg_range().
+ */
+struct backend {
+	enum iot_space space;
+	int opt_dev;         /* leading device values that default to 0 */
+	int width;           /* fixed access width, 0 for the command size */
+	int addr_step;       /* address distance between adjacent registers,
+	                      * 0 if addresses are byte offsets */
+	uint64_t min_addr;   /* lowest accessible register address */
+	const char *dev_fmt; /* names a device, given its selector values */
+};
+
+/* A value or mask to write: a whole number, in any base strtoull() takes.
+ * Errors are printed. */
+int parse_reg_value(const char *arg, uint64_t *value);
+
+/* count registers, stride apart, starting at start. */
+struct reg_range {
+	uint64_t start;
+	uint64_t count;
+	uint64_t stride;
+};
+
+/* Ranges are written as <first>-<last> (inclusive), <first>+<count>, either
+ * optionally followed by :<stride>. The default stride is step. */
+int is_reg_range(const char *arg);
+int parse_reg_range(const char *arg, uint64_t step, struct reg_range *r);
+int backend_read_range(const struct backend *b, struct iot_handle *h,
+                       const struct reg_range *r, int width, int flags);
+
+/* A register access named the way commands name it: <space><width>, as in
+ * mmio32 or pci16. Spaces with a single access width (msr, cmos, scom) may
+ * leave the width out. */
+struct reg_spec {
+	enum iot_space space;
+	int width;
+	int ndev;     /* device selector values in front of the address */
+	int opt_dev;  /* of which this many leading ones may be omitted */
+	int addr_step; /* address distance between adjacent registers */
+};
+
+/* Returns -1, without printing, if name is not a register spec. */
+int parse_reg_spec(const char *name, struct reg_spec *spec);
+
+/* A single register: <type> [dev ...] <addr>, where <type> is a register
+ * spec and leading optional device values may be omitted. */
+struct reg_ref {
+	struct reg_spec spec;
+	char name[16];       /* the type as written */
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t addr;
+};
+
+/* Number of arguments from the type at args[0] up to the next type. */
+int reg_ref_span(int nargs, const char *args[]);
+/* Parse a register from exactly nargs arguments, printing any error. */
+int parse_reg_ref(int nargs, const char *args[], struct reg_ref *ref);
+/* Append the registers listed in args, or in a file with # comments, to
+ * refs, which holds *n of at most max entries. Errors are printed. */
+int parse_reg_refs(int nargs, const char *args[], struct reg_ref *refs, int *n,
+                   int max);
+int parse_reg_ref_file(const char *path, struct reg_ref *refs, int *n,
+                       int max);
+
+struct iot_handle *backend_open(const struct backend *b,
+                                const unsigned int *dev, int flags);
+int backend_read(const struct backend *b, struct iot_handle *h,
+                 uint64_t addr, int width, uint64_t *value);
+int backend_write(const struct backend *b, struct iot_handle *h,
+                  uint64_t addr, int width, uint64_t value);
+int backend_read_cmd(int argc, const char *argv[], const struct cmd_info *info);
+int backend_write_cmd(int argc, const char *argv[],
+                      const struct cmd_info *info);
+
+/*
+ * Read-modify-write: clear the bits of clear, then set those of set, with
+ * one read and one write on the same handle. With verify the register is
+ * read back and must hold the value written. backend_rmw_cmd() takes the
+ * device selector, <addr> <clear-mask> <set-mask> and an optional -v, which
+ * parse_rmw_verify() takes off the argument list.
+ */
+int backend_modify(const struct backend *b, struct iot_handle *h,
+                   uint64_t addr, int width, uint64_t clear, uint64_t set,
+                   int verify);
+int parse_rmw_verify(int *argc, const char *argv[]);
+int backend_rmw_cmd(int argc, const char *argv[], const struct cmd_info *info);
+
+/* Fill cpus with the numbers of at most max online CPUs; returns how many. */
+int online_cpus(unsigned int *cpus, int max);
+
+/*
+ * Periodic sampling of a single register: --repeat N reads it N times,
+ * --interval T spaces the reads T apart on absolute deadlines and --summary
+ * adds min/max/mean/stddev of the values. parse_sample_options() removes the
+ * options from argv, wherever they appear; when allowed is 0 it only resets
+ * them.
+ */
+int parse_sample_options(int *argc, const char *argv[], int allowed);
+int sampling_requested(void);
+int backend_sample(const struct backend *b, struct iot_handle *h,
+                   uint64_t addr, int width);
+
+/* Deadlines are CLOCK_MONOTONIC nanoseconds. wait_until_deadline() sleeps
+ * until shortly before the deadline and spins for the rest. */
+uint64_t deadline_now_ns(void);
+void wait_until_deadline(uint64_t deadline);
+/* Same, but return early once a signal handler has set *stop. */
+void wait_until_deadline_or(uint64_t deadline, volatile sig_atomic_t *stop);
+
+/* Parse a duration: a number with an optional ns, us, ms or s suffix; bare
+ * numbers are milliseconds. */
+int parse_duration(const char *arg, uint64_t *ns);
+
+/* Wait until (register & mask) == value, re-reading back to back at first
+ * and backing off to pause, sched_yield and finally sleeps as the wait gets
+ * longer. A timeout of 0 waits forever. Returns 0 once the condition holds,
+ * 1 on timeout and -1 with errno set if a read fails. */
+struct poll_result {
+	uint64_t value;       /* last value read */
+	uint64_t elapsed_ns;  /* until the read that satisfied the condition */
+	uint64_t reads;
+};
+
+int poll_register(struct iot_handle *h, uint64_t addr, int width,
+                  uint64_t mask, uint64_t value, uint64_t timeout_ns,
+                  struct poll_result *res);
+
+/* Per-command instrumentation (--stats). stats_start() marks the start of a
+ * command, as stats_enable() does if it was off, stats_dispatched() the
+ * point where it has been located, and stats_report() prints the summary
+ * once it has finished. */
+void stats_enable(void);
+int stats_enable_from_env(void);
+void stats_start(void);
+void stats_dispatched(void);
+void stats_report(const char *cmd, int rc);
 
 #define arraysize(array_) \
 	(sizeof((array_))/sizeof((array_)[0]))
@@ -0,0 +1,526 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Long running register access daemon.
+ *
+ * iotoolsd listens on a unix socket and serves the binary protocol described
+ * in daemon.h. libiotools handles for PCI functions, MSRs, i2c slaves and
+ * /dev/mem are opened on first use and kept for the lifetime of the
+ * daemon, so a request costs a socket round trip plus the hardware access
+ * itself. Every client connection is served by its own thread.
+ *
+ * iotoolsd_request is the matching client.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "commands.h"
+#include "output.h"
+#include "daemon.h"
+
+struct space_desc {
+	const char *name;
+	int space;
+	enum iot_space iot_space;
+	int ndev;       /* number of device selector arguments */
+};
+
+static const struct space_desc spaces[] = {
+	{ "pci",   IOTOOLSD_SPACE_PCI,   IOT_SPACE_PCI,   4 },
+	{ "mmio",  IOTOOLSD_SPACE_MMIO,  IOT_SPACE_MMIO,  0 },
+	{ "mem",   IOTOOLSD_SPACE_MEM,   IOT_SPACE_MEM,   0 },
+	{ "io",    IOTOOLSD_SPACE_IO,    IOT_SPACE_IO,    0 },
+	{ "msr",   IOTOOLSD_SPACE_MSR,   IOT_SPACE_MSR,   1 },
+	{ "smbus", IOTOOLSD_SPACE_SMBUS, IOT_SPACE_SMBUS, 2 },
+	{ "cmos",  IOTOOLSD_SPACE_CMOS,  IOT_SPACE_CMOS,  0 },
+};
+
+static const struct space_desc *
+find_space(const char *name)
+{
+	int i;
+
+	for (i = 0; i < arraysize(spaces); i++) {
+		if (!strcmp(spaces[i].name, name))
+			return &spaces[i];
+	}
+	return NULL;
+}
+
+static const struct space_desc *
+find_wire_space(int space)
+{
+	int i;
+
+	for (i = 0; i < arraysize(spaces); i++) {
+		if (spaces[i].space == space)
+			return &spaces[i];
+	}
+	return NULL;
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Persistent device state. A handle is opened the first time a device is
+ * used and lives until the daemon exits, so the table only grows with the
+ * devices that exist. MMIO and MEM have one handle each for all of
+ * physical memory; its cache of mappings (see iot_map()) keeps the pages
+ * clients touch mapped, within a fixed number of windows. A handle must
+ * not be used by two threads at once, and reads of MMIO and MEM update
+ * that cache, so client threads take the lock of the device for every
+ * access.
+ */
+struct dev_state {
+	uint8_t space;
+	uint16_t dev[4];
+	pthread_mutex_t lock;
+	struct iot_handle *h;
+	struct dev_state *next;
+};
+
+static struct dev_state *dev_states;
+static pthread_mutex_t dev_states_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct iot_handle *
+open_dev_state(const struct space_desc *sd, struct dev_state *ds)
+{
+	unsigned int devsel[IOT_MAX_DEV_ARGS];
+	struct iot_handle *h;
+	int i;
+
+	for (i = 0; i < IOT_MAX_DEV_ARGS; i++) {
+		devsel[i] = ds->dev[i];
+	}
+
+	/* Fall back to read-only access where the device file allows only
+	 * that, e.g. PCI config space for unprivileged users. */
+	h = iot_open(sd->iot_space, devsel, IOT_RDWR);
+	if (h == NULL && sd->iot_space != IOT_SPACE_SMBUS) {
+		h = iot_open(sd->iot_space, devsel, IOT_RDONLY);
+	}
+
+	return h;
+}
+
+static struct dev_state *
+get_dev_state(const struct space_desc *sd,
+              const struct iotoolsd_request *req)
+{
+	struct dev_state *ds;
+
+	pthread_mutex_lock(&dev_states_lock);
+	for (ds = dev_states; ds; ds = ds->next) {
+		if (ds->space == req->space &&
+		    !memcmp(ds->dev, req->dev, sizeof(ds->dev))) {
+			goto out;
+		}
+	}
+
+	ds = calloc(1, sizeof(*ds));
+	if (ds == NULL) {
+		goto out;
+	}
+	ds->space = req->space;
+	memcpy(ds->dev, req->dev, sizeof(ds->dev));
+	ds->h = open_dev_state(sd, ds);
+	if (ds->h == NULL) {
+		free(ds);
+		ds = NULL;
+		goto out;
+	}
+	pthread_mutex_init(&ds->lock, NULL);
+	ds->next = dev_states;
+	dev_states = ds;
+out:
+	pthread_mutex_unlock(&dev_states_lock);
+	return ds;
+}
+
+static int
+execute_request(const struct iotoolsd_request *req, uint64_t *value)
+{
+	const struct space_desc *sd;
+	struct dev_state *ds;
+	int r;
+
+	sd = find_wire_space(req->space);
+	if (sd == NULL ||
+	    (req->op != IOTOOLSD_OP_READ && req->op != IOTOOLSD_OP_WRITE)) {
+		return -EINVAL;
+	}
+
+	ds = get_dev_state(sd, req);
+	if (ds == NULL) {
+		return errno ? -errno : -ENODEV;
+	}
+
+	pthread_mutex_lock(&ds->lock);
+	if (req->op == IOTOOLSD_OP_READ) {
+		r = iot_read(ds->h, req->addr, req->width, value);
+	} else {
+		r = iot_write(ds->h, req->addr, req->width, req->value);
+	}
+	r = (r < 0) ? -errno : 0;
+	pthread_mutex_unlock(&ds->lock);
+
+	return r;
+}
+
+#define REQUESTS_PER_READ 64
+
+/* Serve one client connection until it hangs up. */
+static void *
+serve_client(void *arg)
+{
+	int fd = (int)(intptr_t)arg;
+	struct iotoolsd_request reqs[REQUESTS_PER_READ];
+	struct iotoolsd_response resps[REQUESTS_PER_READ];
+	size_t have = 0;
+
+	for (;;) {
+		ssize_t r;
+		size_t nreqs, i;
+		size_t out, written;
+
+		r = read(fd, (char *)reqs + have, sizeof(reqs) - have);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		have += r;
+
+		nreqs = have / sizeof(reqs[0]);
+		for (i = 0; i < nreqs; i++) {
+			uint64_t t0 = monotonic_ns();
+
+			memset(&resps[i], 0, sizeof(resps[i]));
+			resps[i].tag = reqs[i].tag;
+			errno = 0;
+			resps[i].status = execute_request(&reqs[i],
+			                                  &resps[i].value);
+			resps[i].service_ns = monotonic_ns() - t0;
+		}
+
+		/* Keep any partial request for the next read. */
+		have -= nreqs * sizeof(reqs[0]);
+		memmove(reqs, &reqs[nreqs], have);
+
+		out = nreqs * sizeof(resps[0]);
+		for (written = 0; written < out; written += r) {
+			r = write(fd, (char *)resps + written, out - written);
+			if (r < 0 && errno == EINTR) {
+				r = 0;
+				continue;
+			}
+			if (r <= 0)
+				goto done;
+		}
+	}
+done:
+	close(fd);
+	return NULL;
+}
+
+static int
+make_socket_addr(const char *path, struct sockaddr_un *sun)
+{
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sun->sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return -1;
+	}
+	strcpy(sun->sun_path, path);
+	return 0;
+}
+
+static int
+iotoolsd(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const char *path = IOTOOLSD_DEFAULT_SOCKET;
+	struct sockaddr_un sun;
+	pthread_attr_t attr;
+	mode_t old_umask;
+	int sock;
+
+	if (argc == 2) {
+		path = argv[1];
+	}
+	if (make_socket_addr(path, &sun) < 0) {
+		return -1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		fprintf(stderr, "socket(): %s\n", strerror(errno));
+		return -1;
+	}
+
+	/* The socket grants raw hardware access, keep it owner only. */
+	unlink(path);
+	old_umask = umask(077);
+	if (bind(sock, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		fprintf(stderr, "bind(%s): %s\n", path, strerror(errno));
+		umask(old_umask);
+		close(sock);
+		return -1;
+	}
+	umask(old_umask);
+
+	if (listen(sock, SOMAXCONN) < 0) {
+		fprintf(stderr, "listen(): %s\n", strerror(errno));
+		close(sock);
+		return -1;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (;;) {
+		pthread_t thread;
+		int fd = accept(sock, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "accept(): %s\n", strerror(errno));
+			break;
+		}
+		if (pthread_create(&thread, &attr, serve_client,
+		                   (void *)(intptr_t)fd) != 0) {
+			fprintf(stderr, "can't create client thread\n");
+			close(fd);
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+	close(sock);
+	return -1;
+}
+
+static int
+connect_daemon(const char *path)
+{
+	struct sockaddr_un sun;
+	int sock;
+
+	if (make_socket_addr(path, &sun) < 0) {
+		return -1;
+	}
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		fprintf(stderr, "socket(): %s\n", strerror(errno));
+		return -1;
+	}
+	if (connect(sock, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+		fprintf(stderr, "connect(%s): %s\n", path, strerror(errno));
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+static int
+transact(int sock, const struct iotoolsd_request *req,
+         struct iotoolsd_response *resp)
+{
+	size_t done;
+	ssize_t r;
+
+	if (write(sock, req, sizeof(*req)) != sizeof(*req)) {
+		fprintf(stderr, "write(): %s\n", strerror(errno));
+		return -1;
+	}
+	for (done = 0; done < sizeof(*resp); done += r) {
+		r = read(sock, (char *)resp + done, sizeof(*resp) - done);
+		if (r <= 0) {
+			fprintf(stderr, "daemon closed the connection\n");
+			return -1;
+		}
+	}
+	if (resp->tag != req->tag) {
+		fprintf(stderr, "response out of sequence\n");
+		return -1;
+	}
+	return 0;
+}
+
+/*
+ * iotoolsd_request [-s socket] [-n count] <read|write> <space> <width>
+ *                  [dev ...] <addr> [value]
+ *
+ * With -n the request is issued count times and latency statistics are
+ * printed instead of the value.
+ */
+static int
+iotoolsd_request(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const char *path = IOTOOLSD_DEFAULT_SOCKET;
+	const struct space_desc *sd;
+	struct iotoolsd_request req;
+	struct iotoolsd_response resp;
+	unsigned long count = 1;
+	uint64_t min_ns = UINT64_MAX, max_ns = 0, total_ns = 0;
+	uint64_t service_ns = 0;
+	unsigned long i;
+	int nargs;
+	int sock;
+	int arg;
+
+	for (arg = 1; arg + 1 < argc; arg += 2) {
+		if (!strcmp(argv[arg], "-s")) {
+			path = argv[arg + 1];
+		} else if (!strcmp(argv[arg], "-n")) {
+			count = strtoul(argv[arg + 1], NULL, 0);
+		} else {
+			break;
+		}
+	}
+
+	if (argc - arg < 3) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	if (!strcmp(argv[arg], "read")) {
+		req.op = IOTOOLSD_OP_READ;
+	} else if (!strcmp(argv[arg], "write")) {
+		req.op = IOTOOLSD_OP_WRITE;
+	} else {
+		fprintf(stderr, "unknown operation '%s'\n", argv[arg]);
+		return -1;
+	}
+	arg++;
+
+	sd = find_space(argv[arg]);
+	if (sd == NULL) {
+		fprintf(stderr, "unknown address space '%s'\n", argv[arg]);
+		return -1;
+	}
+	req.space = sd->space;
+	arg++;
+	req.width = strtoul(argv[arg++], NULL, 0);
+
+	nargs = sd->ndev + 1 + (req.op == IOTOOLSD_OP_WRITE);
+	if (argc - arg != nargs) {
+		fprintf(stderr, "%s needs %d device argument(s), an address%s\n",
+		        sd->name, sd->ndev,
+		        req.op == IOTOOLSD_OP_WRITE ? " and a value" : "");
+		return -1;
+	}
+	for (i = 0; i < sd->ndev; i++) {
+		req.dev[i] = strtoul(argv[arg++], NULL, 0);
+	}
+	req.addr = strtoull(argv[arg++], NULL, 0);
+	if (req.op == IOTOOLSD_OP_WRITE) {
+		req.value = strtoull(argv[arg++], NULL, 0);
+	}
+
+	sock = connect_daemon(path);
+	if (sock < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		uint64_t t0 = monotonic_ns();
+		uint64_t elapsed;
+
+		req.tag = i;
+		if (transact(sock, &req, &resp) < 0) {
+			close(sock);
+			return -1;
+		}
+		elapsed = monotonic_ns() - t0;
+
+		if (resp.status < 0) {
+			fprintf(stderr, "request failed: %s\n",
+			        strerror(-resp.status));
+			close(sock);
+			return -1;
+		}
+
+		if (elapsed < min_ns)
+			min_ns = elapsed;
+		if (elapsed > max_ns)
+			max_ns = elapsed;
+		total_ns += elapsed;
+		service_ns += resp.service_ns;
+	}
+	close(sock);
+
+	if (count == 1) {
+		if (req.op == IOTOOLSD_OP_READ) {
+			unsigned int dev[IOT_MAX_DEV_ARGS];
+
+			for (i = 0; i < sd->ndev; i++) {
+				dev[i] = req.dev[i];
+			}
+			output_record(sd->iot_space, dev, sd->ndev, req.addr,
+			              req.width, resp.value, 0);
+		}
+	} else if (count > 1) {
+		char line[256];
+
+		snprintf(line, sizeof(line), "requests=%lu min_us=%.3f "
+		         "avg_us=%.3f max_us=%.3f avg_service_us=%.3f\n",
+		         count, min_ns / 1000.0, total_ns / 1000.0 / count,
+		         max_ns / 1000.0, service_ns / 1000.0 / count);
+		output_str(line);
+	}
+
+	return 0;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(daemon_params, 1, 2, "[socket]", 0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(request_params, 5, INT_MAX,
+	"[-s socket] [-n count] <read|write> <pci|mmio|mem|io|msr|smbus|cmos> "
+	"<width> [dev ...] <addr> [value]", 0);
+
+static const struct cmd_info daemon_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(iotoolsd, &iotoolsd, NULL, &daemon_params),
+	MAKE_CMD_WITH_PARAMS(iotoolsd_request, &iotoolsd_request, NULL,
+	                     &request_params),
+};
+
+MAKE_CMD_GROUP(DAEMON, "register access daemon and its client",
+               daemon_cmds);
+REGISTER_CMD_GROUP(DAEMON);
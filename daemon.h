@@ -0,0 +1,69 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _DAEMON_H_
+#define _DAEMON_H_
+
+/*
+ * Wire protocol of the iotools daemon.
+ *
+ * Clients connect to a local SOCK_STREAM unix socket and write fixed size
+ * requests; the daemon answers every request with a fixed size response
+ * carrying the same tag, in order. Requests may be pipelined. All fields are
+ * in host byte order since both ends live on the same machine.
+ */
+
+#include <stdint.h>
+
+#define IOTOOLSD_DEFAULT_SOCKET "/run/iotools.sock"
+
+enum iotoolsd_op {
+	IOTOOLSD_OP_READ = 1,
+	IOTOOLSD_OP_WRITE = 2,
+};
+
+enum iotoolsd_space {
+	IOTOOLSD_SPACE_PCI = 1,  /* dev: segment, bus, device, function */
+	IOTOOLSD_SPACE_MMIO,     /* uncached /dev/mem */
+	IOTOOLSD_SPACE_MEM,      /* cached /dev/mem */
+	IOTOOLSD_SPACE_IO,
+	IOTOOLSD_SPACE_MSR,      /* dev: cpu */
+	IOTOOLSD_SPACE_SMBUS,    /* dev: adapter, slave address */
+	IOTOOLSD_SPACE_CMOS,
+};
+
+struct iotoolsd_request {
+	uint32_t tag;     /* echoed back in the response */
+	uint8_t op;       /* enum iotoolsd_op */
+	uint8_t space;    /* enum iotoolsd_space */
+	uint8_t width;    /* access width in bits */
+	uint8_t reserved;
+	uint16_t dev[4];  /* device selector, see enum iotoolsd_space */
+	uint64_t addr;    /* register address within the device */
+	uint64_t value;   /* value to write */
+};
+
+struct iotoolsd_response {
+	uint32_t tag;
+	int32_t status;      /* 0 on success, negative errno on failure */
+	uint64_t value;      /* value read */
+	uint32_t service_ns; /* time spent executing the request */
+	uint32_t reserved;
+};
+
+#endif /* _DAEMON_H_ */
@@ -0,0 +1,213 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Batch engine benchmark.
+ *
+ * "engine_bench [-n batch] [-r rounds] [-w width] <file> ..." reads
+ * registers from the given files through each engine in turn, see
+ * iot_read_batch(), and prints what a read costs. Reads are spread round
+ * robin over the files at scattered offsets, so they cannot be merged.
+ * Regular files stand in for devices anywhere; the PCI config files under
+ * /sys/bus/pci/devices measure the real thing. Every engine
+ * must read the same values, which is checked as well.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "output.h"
+
+#define MAX_BENCH_FILES 256
+
+struct bench {
+	int *fd;
+	struct iot_access *acc;
+	struct iot_access *orig;
+	int n;
+};
+
+/* Fill the batch with reads spread over the files. */
+static void
+plan_reads(struct bench *b, const int *fds, const off_t *size, int nfiles,
+           int width)
+{
+	uint64_t x = 0x9e3779b97f4a7c15ULL, slots;
+	int i, f;
+
+	for (i = 0; i < b->n; i++) {
+		f = i % nfiles;
+		slots = size[f] / (width / 8);
+		/* xorshift, for offsets that defeat any readahead. */
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		b->fd[i] = fds[f];
+		b->orig[i].addr = (x % slots) * (width / 8);
+		b->orig[i].width = width;
+	}
+}
+
+static int
+run_engine(struct bench *b, enum iot_engine e, long rounds,
+           uint64_t *checksum)
+{
+	uint64_t start, t0, t, best = UINT64_MAX, sum = 0;
+	char buf[160];
+	long r;
+	int i;
+
+	if (iot_set_engine(e) < 0) {
+		snprintf(buf, sizeof(buf), "%-8s unavailable: %s\n",
+		         iot_engine_name(e), strerror(errno));
+		output_str(buf);
+		return 0;
+	}
+
+	start = deadline_now_ns();
+	for (r = 0; r < rounds; r++) {
+		memcpy(b->acc, b->orig, b->n * sizeof(*b->acc));
+		t0 = deadline_now_ns();
+		if (iot_file_read_batch(b->fd, b->acc, b->n) < 0) {
+			fprintf(stderr, "%s engine: read failed: %s\n",
+			        iot_engine_name(e), strerror(errno));
+			return -1;
+		}
+		t = deadline_now_ns() - t0;
+		if (t < best) {
+			best = t;
+		}
+	}
+	t = deadline_now_ns() - start;
+
+	for (i = 0; i < b->n; i++) {
+		sum = sum * 31 + b->acc[i].value;
+	}
+	if (*checksum != 0 && sum != *checksum) {
+		fprintf(stderr, "%s engine read different values\n",
+		        iot_engine_name(e));
+		return -1;
+	}
+	*checksum = sum;
+
+	snprintf(buf, sizeof(buf), "%-8s %8.1f ns/read %10.0f reads/s "
+	         "best batch %.1fus\n", iot_engine_name(e),
+	         (double)t / rounds / b->n, rounds * b->n * 1e9 / t,
+	         best / 1e3);
+	output_str(buf);
+	return 0;
+}
+
+static int
+engine_bench(int argc, const char *argv[], const struct cmd_info *info)
+{
+	enum iot_engine saved = iot_get_engine(), e;
+	int fds[MAX_BENCH_FILES];
+	off_t size[MAX_BENCH_FILES];
+	struct bench b;
+	struct stat st;
+	uint64_t checksum = 0;
+	long n = 256, rounds = 1000, width = 32, *val;
+	int arg, nfiles = 0, i, rc = -1;
+	char *end;
+
+	memset(&b, 0, sizeof(b));
+
+	for (arg = 1; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+		if (!strcmp(argv[arg], "-n")) {
+			val = &n;
+		} else if (!strcmp(argv[arg], "-r")) {
+			val = &rounds;
+		} else if (!strcmp(argv[arg], "-w")) {
+			val = &width;
+		} else {
+			break;
+		}
+		*val = strtol(argv[arg + 1], &end, 0);
+		if (*end != '\0' || *val < 1 || *val > INT_MAX / 64) {
+			fprintf(stderr, "bad value '%s'\n", argv[arg + 1]);
+			return -1;
+		}
+	}
+	if (arg == argc || argc - arg > MAX_BENCH_FILES ||
+	    (width != 8 && width != 16 && width != 32 && width != 64)) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+		return -1;
+	}
+
+	for (; arg < argc; arg++) {
+		fds[nfiles] = open(argv[arg], O_RDONLY);
+		if (fds[nfiles] < 0) {
+			fprintf(stderr, "can't open %s: %s\n", argv[arg],
+			        strerror(errno));
+			goto done;
+		}
+		nfiles++;
+		/* sysfs files report their size; character devices do not
+		 * and get their first page used. */
+		if (fstat(fds[nfiles - 1], &st) < 0 || st.st_size < width / 8) {
+			st.st_size = 4096;
+		}
+		size[nfiles - 1] = st.st_size;
+	}
+
+	b.n = n;
+	b.fd = calloc(n, sizeof(*b.fd));
+	b.acc = calloc(n, sizeof(*b.acc));
+	b.orig = calloc(n, sizeof(*b.orig));
+	if (b.fd == NULL || b.acc == NULL || b.orig == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto done;
+	}
+	plan_reads(&b, fds, size, nfiles, width);
+
+	for (e = IOT_ENGINE_SYNC; e < IOT_ENGINE_MAX; e++) {
+		if (run_engine(&b, e, rounds, &checksum) < 0) {
+			goto done;
+		}
+	}
+	rc = 0;
+
+done:
+	iot_set_engine(saved);
+	for (i = 0; i < nfiles; i++) {
+		close(fds[i]);
+	}
+	free(b.fd);
+	free(b.acc);
+	free(b.orig);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(engine_bench_params, 2, INT_MAX,
+                            "[-n batch] [-r rounds] [-w width] <file> ...",
+                            0);
+
+static const struct cmd_info engine_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(engine_bench, engine_bench, NULL,
+	                     &engine_bench_params),
+};
+
+MAKE_CMD_GROUP(ENGINE, "commands to measure the batch engines",
+               engine_cmds);
+REGISTER_CMD_GROUP(ENGINE);
@@ -0,0 +1,449 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Prometheus textfile export.
+ *
+ * "export [-i interval] [-n count] <definitions> <file.prom>" reads the
+ * registers named in a definition file once per interval and rewrites
+ * file.prom in the Prometheus text format, for node_exporter's textfile
+ * collector. Each definition line is
+ *
+ *	<metric>[{labels}] <type> [dev ...] <addr> [mask=M] [shift=S] [scale=F]
+ *
+ * for example
+ *
+ *	cpu_therm_status{cpu="0"} msr 0 0x19c mask=0x7f0000 shift=16
+ *	nic_link_up{port="0"} mmio32 0xfe000008 mask=0x2 shift=1
+ *	dimm_temp_celsius{slot="A1"} smbus16 0 0x18 0x5 mask=0xfff scale=0.0625
+ *
+ * and exports ((value & M) >> S) * F as a gauge. Label values may not
+ * contain white space. Definitions sharing a metric name are written
+ * together, under one TYPE line. Handles stay open for the life of the
+ * process, and the file is replaced atomically through a rename, so the
+ * collector never sees a partial file. Registers that fail to read are
+ * left out of that pass and counted in iotools_export_read_errors.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "commands.h"
+
+#define MAX_METRICS 1024
+#define MAX_METRIC_LINE 1024
+#define MAX_METRIC_NAME 256
+#define DEFAULT_EXPORT_INTERVAL_NS 15000000000ULL
+
+struct metric {
+	char name[MAX_METRIC_NAME];  /* with labels, as written */
+	int name_len;                /* without labels */
+	struct reg_ref ref;
+	uint64_t mask;
+	int shift;
+	double scale;
+	int scaled;
+};
+
+struct exporter {
+	struct metric *metrics;
+	int nmetrics;
+	struct handle_set handles;
+	/* Every pass is one batch, see iot_read_batch(). */
+	struct iot_handle **h;
+	struct iot_access *acc;
+};
+
+static volatile sig_atomic_t export_stop;
+
+static void
+export_signal(int sig)
+{
+	export_stop = 1;
+}
+
+/* Check name[{labels}] and return the length of the metric name. */
+static int
+parse_metric_name(const char *arg)
+{
+	int len;
+
+	if (!isalpha(arg[0]) && arg[0] != '_' && arg[0] != ':') {
+		return -1;
+	}
+	for (len = 1; isalnum(arg[len]) || arg[len] == '_' || arg[len] == ':';
+	     len++) {
+	}
+	if (arg[len] == '\0') {
+		return len;
+	}
+	if (arg[len] != '{' || arg[strlen(arg) - 1] != '}' ||
+	    strchr(&arg[len], '=') == NULL) {
+		return -1;
+	}
+	return len;
+}
+
+static int
+parse_metric_option(struct metric *m, const char *arg)
+{
+	char *end;
+
+	if (!strncmp(arg, "mask=", 5)) {
+		m->mask = strtoull(&arg[5], &end, 0);
+	} else if (!strncmp(arg, "shift=", 6)) {
+		m->shift = strtol(&arg[6], &end, 0);
+		if (m->shift < 0 || m->shift > 63) {
+			return -1;
+		}
+	} else if (!strncmp(arg, "scale=", 6)) {
+		m->scale = strtod(&arg[6], &end);
+		m->scaled = 1;
+	} else {
+		return -1;
+	}
+	return (end[0] == '\0' && end[-1] != '=') ? 0 : -1;
+}
+
+static int
+parse_metric(struct metric *m, int nargs, const char *args[])
+{
+	int span, i;
+
+	memset(m, 0, sizeof(*m));
+	m->mask = ~0ULL;
+	m->scale = 1;
+
+	m->name_len = parse_metric_name(args[0]);
+	if (m->name_len < 0 || strlen(args[0]) >= sizeof(m->name)) {
+		fprintf(stderr, "bad metric name '%s'\n", args[0]);
+		return -1;
+	}
+	snprintf(m->name, sizeof(m->name), "%s", args[0]);
+
+	for (span = 1; span < nargs && !strchr(args[span], '='); span++) {
+	}
+	if (span < 3 || parse_reg_ref(span - 1, &args[1], &m->ref) < 0) {
+		return -1;
+	}
+	for (i = span; i < nargs; i++) {
+		if (parse_metric_option(m, args[i]) < 0) {
+			fprintf(stderr, "bad option '%s'\n", args[i]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+same_family(const struct metric *a, const struct metric *b)
+{
+	return a->name_len == b->name_len &&
+	       !strncmp(a->name, b->name, a->name_len);
+}
+
+static int
+read_definitions(struct exporter *e, const char *path)
+{
+	const char *args[MAX_METRIC_LINE / 2 + 1];
+	char line[MAX_METRIC_LINE];
+	struct metric *sorted;
+	int nargs, lineno = 0, n = 0, i, j;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		nargs = split_args(line, args, MAX_METRIC_LINE / 2);
+		if (nargs == 0) {
+			continue;
+		}
+		if (e->nmetrics == MAX_METRICS) {
+			fprintf(stderr, "at most %d metrics are supported\n",
+			        MAX_METRICS);
+			nargs = -1;
+		}
+		if (nargs < 0 ||
+		    parse_metric(&e->metrics[e->nmetrics], nargs, args) < 0) {
+			fprintf(stderr, "%s:%d: bad metric definition\n", path,
+			        lineno);
+			fclose(f);
+			return -1;
+		}
+		e->nmetrics++;
+	}
+	fclose(f);
+
+	/* Bring each family together, keeping the definitions' order. */
+	sorted = calloc(e->nmetrics ? e->nmetrics : 1, sizeof(*sorted));
+	if (sorted == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < e->nmetrics; i++) {
+		for (j = 0; j < i; j++) {
+			if (same_family(&e->metrics[j], &e->metrics[i])) {
+				break;
+			}
+		}
+		if (j < i) {
+			continue;
+		}
+		for (j = i; j < e->nmetrics; j++) {
+			if (same_family(&e->metrics[j], &e->metrics[i])) {
+				sorted[n++] = e->metrics[j];
+			}
+		}
+	}
+	memcpy(e->metrics, sorted, n * sizeof(*sorted));
+	free(sorted);
+
+	return 0;
+}
+
+static int
+open_handles(struct exporter *e)
+{
+	struct metric *m;
+	int i;
+
+	e->h = calloc(e->nmetrics, sizeof(*e->h));
+	e->acc = calloc(e->nmetrics, sizeof(*e->acc));
+	if (e->h == NULL || e->acc == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+	for (i = 0; i < e->nmetrics; i++) {
+		m = &e->metrics[i];
+		e->acc[i].addr = m->ref.addr;
+		e->acc[i].width = m->ref.spec.width;
+		e->h[i] = handle_set_get(&e->handles, m->ref.spec.space,
+		                         m->ref.dev, IOT_RDONLY);
+		if (e->h[i] == NULL) {
+			fprintf(stderr, "can't open %s device for %s: %s\n",
+			        m->ref.name, m->name, strerror(errno));
+			return -1;
+		}
+	}
+	if (e->handles.recycled) {
+		fprintf(stderr, "at most %d devices can be exported\n",
+		        HANDLE_SET_SIZE);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void
+write_metrics(FILE *f, const struct exporter *e, int errors,
+              uint64_t duration_ns)
+{
+	const struct metric *m;
+	uint64_t value;
+	int i;
+
+	for (i = 0; i < e->nmetrics; i++) {
+		m = &e->metrics[i];
+		if (i == 0 || !same_family(m, &e->metrics[i - 1])) {
+			fprintf(f, "# TYPE %.*s gauge\n", m->name_len, m->name);
+		}
+		if (e->acc[i].status != 0) {
+			continue;
+		}
+		value = (e->acc[i].value & m->mask) >> m->shift;
+		if (m->scaled) {
+			fprintf(f, "%s %.15g\n", m->name, value * m->scale);
+		} else {
+			fprintf(f, "%s %llu\n", m->name,
+			        (unsigned long long)value);
+		}
+	}
+
+	fprintf(f, "# TYPE iotools_export_read_errors gauge\n"
+	        "iotools_export_read_errors %d\n", errors);
+	fprintf(f, "# TYPE iotools_export_duration_seconds gauge\n"
+	        "iotools_export_duration_seconds %.9f\n", duration_ns / 1e9);
+}
+
+/* Read every metric and replace path with the result. */
+static int
+export_once(struct exporter *e, const char *path)
+{
+	char tmp[PATH_MAX];
+	uint64_t start;
+	int errors = 0, i;
+	FILE *f;
+
+	start = deadline_now_ns();
+	iot_read_batch(e->h, e->acc, e->nmetrics);
+	for (i = 0; i < e->nmetrics; i++) {
+		if (e->acc[i].status != 0) {
+			errors++;
+		}
+	}
+
+	/* The textfile collector ignores files not ending in .prom. */
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		fprintf(stderr, "can't create %s: %s\n", tmp, strerror(errno));
+		return -1;
+	}
+	write_metrics(f, e, errors, deadline_now_ns() - start);
+	if (fclose(f) != 0) {
+		fprintf(stderr, "can't write %s: %s\n", tmp, strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+	if (rename(tmp, path) < 0) {
+		fprintf(stderr, "can't rename %s to %s: %s\n", tmp, path,
+		        strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+run_exporter(struct exporter *e, const char *path, uint64_t interval_ns,
+             long count)
+{
+	struct sigaction sa, old_int, old_term;
+	uint64_t deadline, now;
+	long passes;
+	int rc = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = export_signal;
+	sigemptyset(&sa.sa_mask);
+	export_stop = 0;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+
+	deadline = deadline_now_ns();
+	for (passes = 0; !export_stop && (count == 0 || passes < count);
+	     passes++) {
+		if (passes > 0) {
+			/* Passes that ran late are dropped rather than caught
+			 * up. */
+			deadline += interval_ns;
+			now = deadline_now_ns();
+			if (deadline < now) {
+				deadline = now;
+			}
+			wait_until_deadline_or(deadline, &export_stop);
+			if (export_stop) {
+				break;
+			}
+		}
+		if (export_once(e, path) < 0) {
+			rc = -1;
+			break;
+		}
+	}
+
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	return rc;
+}
+
+static int
+export(int argc, const char *argv[], const struct cmd_info *info)
+{
+	struct exporter e;
+	uint64_t interval = DEFAULT_EXPORT_INTERVAL_NS;
+	long count = 0;
+	int arg = 1, rc = -1;
+	char *end;
+
+	memset(&e, 0, sizeof(e));
+
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		if (arg + 1 == argc) {
+			goto usage;
+		}
+		if (!strcmp(argv[arg], "-i")) {
+			if (parse_duration(argv[arg + 1], &interval) < 0 ||
+			    interval == 0) {
+				fprintf(stderr, "bad interval '%s'\n",
+				        argv[arg + 1]);
+				return -1;
+			}
+		} else if (!strcmp(argv[arg], "-n")) {
+			count = strtol(argv[arg + 1], &end, 0);
+			if (*end != '\0' || count < 0) {
+				fprintf(stderr, "bad count '%s'\n",
+				        argv[arg + 1]);
+				return -1;
+			}
+		} else {
+			goto usage;
+		}
+	}
+	if (arg != argc - 2) {
+		goto usage;
+	}
+
+	e.metrics = calloc(MAX_METRICS, sizeof(*e.metrics));
+	if (e.metrics == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+	if (read_definitions(&e, argv[arg]) < 0 || open_handles(&e) < 0) {
+		goto done;
+	}
+	if (e.nmetrics == 0) {
+		fprintf(stderr, "%s defines no metrics\n", argv[arg]);
+		goto done;
+	}
+
+	rc = run_exporter(&e, argv[arg + 1], interval, count);
+	goto done;
+
+usage:
+	fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+	return -1;
+done:
+	handle_set_release(&e.handles);
+	free(e.h);
+	free(e.acc);
+	free(e.metrics);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(export_params, 3, 7,
+                            "[-i interval] [-n count] <definitions> "
+                            "<file.prom>", 0);
+
+static const struct cmd_info export_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(export, export, NULL, &export_params),
+};
+
+MAKE_CMD_GROUP(EXPORT, "commands to export registers as metrics",
+               export_cmds);
+REGISTER_CMD_GROUP(EXPORT);
@@ -0,0 +1,196 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Register handle cache.
+ *
+ * Subcommands obtain libiotools handles through get_handle() and give them
+ * back with put_handle(). For a single command these simply open and close
+ * the handle. When caching is enabled (batch mode) released handles stay
+ * open and are handed out again to the next command that asks for the same
+ * device with the same flags. Entries count the get_handle() calls not yet
+ * matched by put_handle(); only entries nobody holds are recycled.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "commands.h"
+
+#define MAX_CACHED_HANDLES 64
+
+static struct cached_handle handle_cache[MAX_CACHED_HANDLES];
+static int num_cached_handles;
+static int next_victim;
+static int caching_enabled;
+
+void
+set_handle_caching(int enable)
+{
+	caching_enabled = enable;
+	if (!enable) {
+		close_all_handles();
+	}
+}
+
+struct iot_handle *
+get_handle(enum iot_space space, const unsigned int *dev, int flags)
+{
+	unsigned int devsel[IOT_MAX_DEV_ARGS] = { 0 };
+	struct cached_handle *ch;
+	struct iot_handle *h;
+	int i;
+
+	if (dev != NULL) {
+		memcpy(devsel, dev, sizeof(devsel));
+	}
+
+	if (!caching_enabled) {
+		return iot_open(space, devsel, flags);
+	}
+
+	for (i = 0; i < num_cached_handles; i++) {
+		ch = &handle_cache[i];
+		if (ch->space == space && ch->flags == flags &&
+		    !memcmp(ch->dev, devsel, sizeof(devsel))) {
+			ch->refs++;
+			return ch->h;
+		}
+	}
+
+	h = iot_open(space, devsel, flags);
+	if (h == NULL) {
+		return NULL;
+	}
+
+	/* Once the cache is full, recycle the slots nobody holds in round
+	 * robin order. If every slot is held, the handle is not cached and
+	 * put_handle() closes it. */
+	if (num_cached_handles < MAX_CACHED_HANDLES) {
+		ch = &handle_cache[num_cached_handles++];
+	} else {
+		for (i = 0; i < MAX_CACHED_HANDLES; i++) {
+			ch = &handle_cache[(next_victim + i) %
+			                   MAX_CACHED_HANDLES];
+			if (ch->refs == 0) {
+				break;
+			}
+		}
+		if (i == MAX_CACHED_HANDLES) {
+			return h;
+		}
+		next_victim = (next_victim + i + 1) % MAX_CACHED_HANDLES;
+		iot_close(ch->h);
+	}
+
+	ch->space = space;
+	memcpy(ch->dev, devsel, sizeof(devsel));
+	ch->flags = flags;
+	ch->h = h;
+	ch->refs = 1;
+
+	return h;
+}
+
+void
+put_handle(struct iot_handle *h)
+{
+	int i;
+
+	if (h == NULL) {
+		return;
+	}
+
+	if (caching_enabled) {
+		for (i = 0; i < num_cached_handles; i++) {
+			if (handle_cache[i].h == h) {
+				handle_cache[i].refs--;
+				return;
+			}
+		}
+	}
+
+	iot_close(h);
+}
+
+void
+close_all_handles(void)
+{
+	int i;
+
+	for (i = 0; i < num_cached_handles; i++) {
+		iot_close(handle_cache[i].h);
+	}
+	num_cached_handles = 0;
+	next_victim = 0;
+}
+
+struct iot_handle *
+handle_set_get(struct handle_set *set, enum iot_space space,
+               const unsigned int *dev, int flags)
+{
+	unsigned int devsel[IOT_MAX_DEV_ARGS] = { 0 };
+	struct cached_handle *ch;
+	struct iot_handle *h;
+	int i;
+
+	if (dev != NULL) {
+		memcpy(devsel, dev, sizeof(devsel));
+	}
+
+	for (i = 0; i < set->num_handles; i++) {
+		ch = &set->handles[i];
+		if (ch->space == space && ch->flags == flags &&
+		    !memcmp(ch->dev, devsel, sizeof(devsel))) {
+			return ch->h;
+		}
+	}
+
+	h = get_handle(space, devsel, flags);
+	if (h == NULL) {
+		return NULL;
+	}
+
+	if (set->num_handles < HANDLE_SET_SIZE) {
+		ch = &set->handles[set->num_handles++];
+	} else {
+		ch = &set->handles[set->next_victim];
+		set->next_victim = (set->next_victim + 1) % HANDLE_SET_SIZE;
+		set->recycled++;
+		put_handle(ch->h);
+	}
+
+	ch->space = space;
+	memcpy(ch->dev, devsel, sizeof(devsel));
+	ch->flags = flags;
+	ch->h = h;
+
+	return h;
+}
+
+void
+handle_set_release(struct handle_set *set)
+{
+	int i;
+
+	for (i = 0; i < set->num_handles; i++) {
+		put_handle(set->handles[i].h);
+	}
+	set->num_handles = 0;
+	set->next_victim = 0;
+	set->recycled = 0;
+}
@@ -32,11 +32,16 @@ main(int argc, const char *argv[])
 static void
 usage(const char *bin_name, FILE *fstream)
 {
-	fprintf(fstream, "usage: %s COMMAND\n", bin_name);
+	fprintf(fstream, "usage: %s [--stats] [--format=text|json|csv|bin] "
+	        "[--trace=FILE]\n       [--engine=auto|sync|uring|threads] "
+	        "[--sysroot=DIR]\n       [--broker=SOCKET] [--regmap=FILE] "
+	        "COMMAND\n",
+	        bin_name);
 	fprintf(fstream, "  COMMANDS:\n"
 			"    --make-links\n"
 			"    --clean-links\n"
 			"    --list-cmds\n"
+			"    --batch [file|-]\n"
 			"    -v --version\n");
 }
 
@@ -49,6 +54,14 @@ version(const char *progname)
 int
 iotools_fallback(int argc, const char *argv[])
 {
+	if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+		if (argc > 3) {
+			usage(argv[0], stderr);
+			return -1;
+		}
+		return run_batch(argc == 3 ? argv[2] : "-");
+	}
+
 	if (argc != 2) {
 		usage(argv[0], stderr);
 		return -1;
@@ -0,0 +1,183 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: device files obtained from the iotools broker, see broker.h.
+ *
+ * One connection is kept for the life of the process; descriptors are only
+ * requested when a handle is opened, so accesses cost what they cost with
+ * a device file opened locally.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "broker.h"
+#include "lib_internal.h"
+
+static struct sockaddr_un broker_addr;
+static int broker_sock = -1;
+static pthread_mutex_t broker_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int
+iot_set_broker(const char *path)
+{
+	struct sockaddr_un sun;
+	int sock = -1;
+
+	memset(&sun, 0, sizeof(sun));
+	if (path != NULL && *path != '\0') {
+		sun.sun_family = AF_UNIX;
+		if (strlen(path) >= sizeof(sun.sun_path)) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		strcpy(sun.sun_path, path);
+
+		sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (sock < 0)
+			return -1;
+		if (connect(sock, (struct sockaddr *)&sun, sizeof(sun)) < 0) {
+			int saved_errno = errno;
+			close(sock);
+			errno = saved_errno;
+			return -1;
+		}
+	}
+
+	pthread_mutex_lock(&broker_lock);
+	if (broker_sock >= 0)
+		close(broker_sock);
+	broker_sock = sock;
+	broker_addr = sun;
+	pthread_mutex_unlock(&broker_lock);
+
+	return 0;
+}
+
+const char *
+iot_get_broker(void)
+{
+	return broker_addr.sun_path;
+}
+
+int
+lib_broker_enabled(void)
+{
+	return broker_sock >= 0;
+}
+
+/* Receive a response and the descriptor that may come with it. */
+static int
+recv_response(struct iotools_broker_response *resp, int *fd)
+{
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} control;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+	struct iovec iov;
+	size_t got = 0;
+	ssize_t r;
+
+	*fd = -1;
+	while (got < sizeof(*resp)) {
+		iov.iov_base = (char *)resp + got;
+		iov.iov_len = sizeof(*resp) - got;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control.buf;
+		msg.msg_controllen = sizeof(control.buf);
+
+		LIB_SYSCALLS(1);
+		r = recvmsg(broker_sock, &msg, MSG_CMSG_CLOEXEC);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0) {
+			if (r == 0)
+				errno = ECONNRESET;
+			break;
+		}
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET &&
+			    cmsg->cmsg_type == SCM_RIGHTS) {
+				memcpy(fd, CMSG_DATA(cmsg), sizeof(*fd));
+			}
+		}
+		got += r;
+	}
+
+	if (got < sizeof(*resp)) {
+		if (*fd >= 0)
+			close(*fd);
+		return -1;
+	}
+	return 0;
+}
+
+int
+lib_broker_open(const char *path, int flags)
+{
+	struct iotools_broker_request req;
+	struct iotools_broker_response resp;
+	size_t sent;
+	ssize_t r;
+	int fd = -1;
+
+	memset(&req, 0, sizeof(req));
+	if (strlen(path) >= sizeof(req.path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strcpy(req.path, path);
+	if ((flags & O_ACCMODE) != O_RDONLY)
+		req.flags |= IOTOOLS_BROKER_RDWR;
+
+	pthread_mutex_lock(&broker_lock);
+	for (sent = 0; sent < sizeof(req); sent += r) {
+		LIB_SYSCALLS(1);
+		r = send(broker_sock, (char *)&req + sent, sizeof(req) - sent,
+		         MSG_NOSIGNAL);
+		if (r < 0 && errno == EINTR) {
+			r = 0;
+		} else if (r < 0) {
+			goto out;
+		}
+	}
+	if (recv_response(&resp, &fd) < 0)
+		goto out;
+
+	if (resp.status < 0) {
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+		errno = -resp.status;
+	} else if (fd < 0) {
+		errno = EPROTO;
+	}
+out:
+	pthread_mutex_unlock(&broker_lock);
+	return fd;
+}
@@ -0,0 +1,90 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: CMOS access through the linux nvram driver. Addresses are
+ * CMOS indexes; the RTC bytes below NVRAM_OFFSET are not reachable.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lib_internal.h"
+
+static int
+lib_cmos_open(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	h->fd = lib_open(NVRAM_DEVICE, (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY);
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int
+lib_cmos_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	if (addr < NVRAM_OFFSET) {
+		errno = EINVAL;
+		return -1;
+	}
+	return lib_file_read(h->fd, addr - NVRAM_OFFSET, width, value);
+}
+
+static int
+lib_cmos_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	if (addr < NVRAM_OFFSET) {
+		errno = EINVAL;
+		return -1;
+	}
+	return lib_file_write(h->fd, addr - NVRAM_OFFSET, width, value);
+}
+
+static int
+lib_cmos_readv(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	return lib_file_readv(h->fd, NVRAM_OFFSET, acc, n);
+}
+
+static int
+lib_cmos_file_pos(const struct iot_handle *h, uint64_t addr, uint64_t *pos)
+{
+	if (addr < NVRAM_OFFSET) {
+		errno = EINVAL;
+		return -1;
+	}
+	*pos = addr - NVRAM_OFFSET;
+	return 0;
+}
+
+static void
+lib_cmos_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	close(h->fd);
+}
+
+const struct lib_backend lib_cmos_backend = {
+	.info = { "cmos", 0, 8, 8, IOT_CAP_PREAD },
+	.open = lib_cmos_open,
+	.read = lib_cmos_read,
+	.write = lib_cmos_write,
+	.readv = lib_cmos_readv,
+	.file_pos = lib_cmos_file_pos,
+	.close = lib_cmos_close,
+};
@@ -0,0 +1,468 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: the batch engine, see iot_read_batch().
+ *
+ * Register reads through sysfs, procfs and device files are synchronous
+ * pread() calls, each a full round trip into the kernel. The engine keeps
+ * many of them in flight instead, with one of
+ *
+ *  - io_uring: reads are queued on a submission ring shared with the
+ *    kernel and reaped from its completion ring, one system call for
+ *    hundreds of reads. Files that cannot read without blocking are
+ *    served by the kernel's own worker threads.
+ *  - a thread pool: where io_uring is missing (old kernels, seccomp
+ *    filters), a few threads issue the reads in parallel.
+ *  - plain pread() one after the other, which is also what small batches
+ *    get under IOT_ENGINE_AUTO since waking anyone costs more than the
+ *    reads themselves.
+ *
+ * The ring and the pool are set up on first use and shared by the whole
+ * process; batches from different threads take turns.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include "lib_internal.h"
+
+#ifdef __NR_io_uring_setup
+#include <linux/io_uring.h>
+#define HAVE_IO_URING
+#endif
+
+/* Smaller batches are read synchronously by IOT_ENGINE_AUTO. */
+#define ENGINE_MIN_BATCH 8
+
+#define URING_ENTRIES LIB_ENGINE_CHUNK
+#define POOL_MIN_THREADS 2
+#define POOL_MAX_THREADS 16
+
+static enum iot_engine engine = IOT_ENGINE_AUTO;
+static pthread_mutex_t engine_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const engine_names[IOT_ENGINE_MAX] = {
+	[IOT_ENGINE_AUTO]    = "auto",
+	[IOT_ENGINE_SYNC]    = "sync",
+	[IOT_ENGINE_URING]   = "uring",
+	[IOT_ENGINE_THREADS] = "threads",
+};
+
+static void
+read_sync(struct lib_pread *ops, int n)
+{
+	int i;
+
+	LIB_SYSCALLS(n);
+	for (i = 0; i < n; i++) {
+		ops[i].acc->status = 0;
+		if (lib_file_pread(ops[i].fd, ops[i].pos, ops[i].width,
+		                   &ops[i].acc->value) < 0)
+			ops[i].acc->status = -errno;
+	}
+}
+
+#ifdef HAVE_IO_URING
+
+/* A read in flight owns a slot, which holds its buffer. */
+struct uring_slot {
+	struct iovec iov;
+	uint64_t buf;
+	int op;
+	int next_free;
+};
+
+static struct {
+	int state;       /* 0 until set up, 1 if ready, -1 if unavailable */
+	int fd;
+	unsigned int sq_entries;
+	unsigned int cq_entries;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	struct uring_slot *slots;
+	int free_slot;
+} ring;
+
+static int
+uring_setup(void)
+{
+	struct io_uring_params p;
+	size_t sq_len, cq_len;
+	char *sq, *cq;
+	void *sqes;
+	int fd, i;
+
+	if (ring.state > 0)
+		return 0;
+	if (ring.state < 0) {
+		errno = ENOSYS;
+		return -1;
+	}
+	ring.state = -1;
+
+	memset(&p, 0, sizeof(p));
+	LIB_SYSCALLS(1);
+	fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if (fd < 0)
+		return -1;
+
+	sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_len > sq_len)
+			sq_len = cq_len;
+		cq_len = sq_len;
+	}
+	sq = mmap(NULL, sq_len, PROT_READ | PROT_WRITE,
+	          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto fail;
+	cq = sq;
+	if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+		cq = mmap(NULL, cq_len, PROT_READ | PROT_WRITE,
+		          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			goto fail;
+	}
+	sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+	            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+	            IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+		goto fail;
+	ring.slots = calloc(p.sq_entries, sizeof(*ring.slots));
+	if (ring.slots == NULL)
+		goto fail;
+
+	ring.sq_entries = p.sq_entries;
+	ring.cq_entries = p.cq_entries;
+	ring.sq_head = (unsigned int *)(sq + p.sq_off.head);
+	ring.sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	ring.sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	ring.sq_array = (unsigned int *)(sq + p.sq_off.array);
+	ring.cq_head = (unsigned int *)(cq + p.cq_off.head);
+	ring.cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	ring.cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	ring.sqes = sqes;
+	for (i = 0; i < ring.sq_entries; i++) {
+		ring.slots[i].iov.iov_base = &ring.slots[i].buf;
+		ring.slots[i].next_free = i + 1;
+	}
+	ring.free_slot = 0;
+	ring.fd = fd;
+	ring.state = 1;
+	return 0;
+
+fail:
+	/* The mappings go away with the process. */
+	close(fd);
+	errno = ENOMEM;
+	return -1;
+}
+
+/* Queue op on the submission ring. */
+static void
+uring_queue(struct lib_pread *ops, int op)
+{
+	unsigned int tail = *ring.sq_tail;
+	unsigned int idx = tail & *ring.sq_mask;
+	struct io_uring_sqe *sqe = &ring.sqes[idx];
+	struct uring_slot *slot = &ring.slots[ring.free_slot];
+	int s = ring.free_slot;
+
+	ring.free_slot = slot->next_free;
+	slot->op = op;
+	slot->iov.iov_len = ops[op].width / 8;
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = ops[op].fd;
+	sqe->addr = (uintptr_t)&slot->iov;
+	sqe->len = 1;
+	sqe->off = ops[op].pos;
+	sqe->user_data = s;
+	ring.sq_array[idx] = idx;
+
+	__atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Reap completions, returning how many there were. */
+static int
+uring_reap(struct lib_pread *ops)
+{
+	unsigned int head = *ring.cq_head;
+	unsigned int tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+	struct io_uring_cqe *cqe;
+	struct uring_slot *slot;
+	struct lib_pread *op;
+	int n = 0;
+
+	for (; head != tail; head++, n++) {
+		cqe = &ring.cqes[head & *ring.cq_mask];
+		slot = &ring.slots[cqe->user_data];
+		op = &ops[slot->op];
+		if (cqe->res == op->width / 8) {
+			op->acc->value = lib_get_reg((uint8_t *)&slot->buf,
+			                             op->width);
+			op->acc->status = 0;
+		} else {
+			op->acc->status = cqe->res < 0 ? cqe->res : -EIO;
+		}
+		slot->next_free = ring.free_slot;
+		ring.free_slot = cqe->user_data;
+	}
+	__atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+static int
+read_uring(struct lib_pread *ops, int n)
+{
+	int queued = 0, unsubmitted = 0, done = 0, in_flight, r;
+
+	while (done < n) {
+		in_flight = queued - done;
+		for (; queued < n && in_flight < ring.sq_entries &&
+		       in_flight < ring.cq_entries; queued++, in_flight++) {
+			uring_queue(ops, queued);
+			unsubmitted++;
+		}
+
+		LIB_SYSCALLS(1);
+		r = syscall(__NR_io_uring_enter, ring.fd, unsubmitted, 1,
+		            IORING_ENTER_GETEVENTS, NULL, 0);
+		if (r >= 0) {
+			unsubmitted -= r;
+		} else if (errno != EINTR && errno != EAGAIN &&
+		           errno != EBUSY) {
+			/* Give up on the ring for good; reads still in
+			 * flight only touch its slots. */
+			ring.state = -1;
+			return -1;
+		}
+		done += uring_reap(ops);
+	}
+
+	return 0;
+}
+
+#else
+
+static int
+uring_setup(void)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+static int
+read_uring(struct lib_pread *ops, int n)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* #ifdef HAVE_IO_URING */
+
+static struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	int nthreads;         /* 0 until started, -1 if unavailable */
+	unsigned long batch;  /* bumped for each batch */
+	struct lib_pread *ops;
+	int n;
+	int next;             /* claimed atomically */
+	int busy;             /* workers still on the batch */
+} pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.start = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+};
+
+static void
+pool_run(void)
+{
+	struct lib_pread *op;
+	int i;
+
+	while ((i = __atomic_fetch_add(&pool.next, 1, __ATOMIC_RELAXED)) <
+	       pool.n) {
+		op = &pool.ops[i];
+		op->acc->status = 0;
+		if (lib_file_pread(op->fd, op->pos, op->width,
+		                   &op->acc->value) < 0)
+			op->acc->status = -errno;
+	}
+}
+
+static void *
+pool_worker(void *arg)
+{
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool.mutex);
+	for (;;) {
+		while (pool.batch == seen)
+			pthread_cond_wait(&pool.start, &pool.mutex);
+		seen = pool.batch;
+		pthread_mutex_unlock(&pool.mutex);
+
+		pool_run();
+
+		pthread_mutex_lock(&pool.mutex);
+		if (--pool.busy == 0)
+			pthread_cond_signal(&pool.done);
+	}
+	return NULL;
+}
+
+static int
+pool_setup(void)
+{
+	sigset_t all, old;
+	pthread_t t;
+	long n;
+
+	if (pool.nthreads != 0)
+		return pool.nthreads < 0 ? -1 : 0;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n < POOL_MIN_THREADS)
+		n = POOL_MIN_THREADS;
+	if (n > POOL_MAX_THREADS)
+		n = POOL_MAX_THREADS;
+
+	/* Signals are for the application's threads. */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (pool.nthreads = 0; pool.nthreads < n; pool.nthreads++) {
+		if (pthread_create(&t, NULL, pool_worker, NULL))
+			break;
+		pthread_detach(t);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (pool.nthreads == 0) {
+		pool.nthreads = -1;
+		return -1;
+	}
+	return 0;
+}
+
+static int
+read_threads(struct lib_pread *ops, int n)
+{
+	if (pool_setup() < 0)
+		return -1;
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.ops = ops;
+	pool.n = n;
+	pool.next = 0;
+	pool.busy = pool.nthreads;
+	pool.batch++;
+	pthread_cond_broadcast(&pool.start);
+	pthread_mutex_unlock(&pool.mutex);
+
+	/* The caller works as well. */
+	pool_run();
+
+	pthread_mutex_lock(&pool.mutex);
+	while (pool.busy > 0)
+		pthread_cond_wait(&pool.done, &pool.mutex);
+	pthread_mutex_unlock(&pool.mutex);
+
+	LIB_SYSCALLS(n);
+	return 0;
+}
+
+void
+lib_engine_read(struct lib_pread *ops, int n)
+{
+	enum iot_engine e = engine;
+	int r = -1;
+
+	if (n == 0)
+		return;
+	if (e == IOT_ENGINE_SYNC ||
+	    (e == IOT_ENGINE_AUTO && n < ENGINE_MIN_BATCH)) {
+		read_sync(ops, n);
+		return;
+	}
+
+	pthread_mutex_lock(&engine_lock);
+	if ((e == IOT_ENGINE_AUTO || e == IOT_ENGINE_URING) &&
+	    uring_setup() == 0)
+		r = read_uring(ops, n);
+	if (r < 0 && e != IOT_ENGINE_URING)
+		r = read_threads(ops, n);
+	pthread_mutex_unlock(&engine_lock);
+
+	/* Nothing else works, or the ring broke down midway. */
+	if (r < 0)
+		read_sync(ops, n);
+}
+
+int
+iot_set_engine(enum iot_engine e)
+{
+	int r = 0;
+
+	if (e < 0 || e >= IOT_ENGINE_MAX) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (e == IOT_ENGINE_URING) {
+		pthread_mutex_lock(&engine_lock);
+		r = uring_setup();
+		pthread_mutex_unlock(&engine_lock);
+	}
+	if (r == 0)
+		engine = e;
+	return r;
+}
+
+enum iot_engine
+iot_get_engine(void)
+{
+	return engine;
+}
+
+const char *
+iot_engine_name(enum iot_engine e)
+{
+	if (e < 0 || e >= IOT_ENGINE_MAX)
+		return NULL;
+	return engine_names[e];
+}
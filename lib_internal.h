@@ -0,0 +1,183 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _LIB_INTERNAL_H_
+#define _LIB_INTERNAL_H_
+
+/*
+ * libiotools internals shared by the address space implementations.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "libiotools.h"
+
+/* MMIO/MEM: a mapping of physical memory, see iot_map(). */
+#define LIB_MAP_WINDOWS 16
+
+struct lib_map_window {
+	volatile void *mem;  /* NULL if the slot is unused */
+	uint64_t addr;       /* page aligned */
+	size_t len;
+	uint64_t last_use;
+};
+
+struct iot_handle {
+	enum iot_space space;
+	int flags;
+	int fd;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	/* MMIO/MEM: mapped windows of physical memory, evicted least
+	 * recently used first. */
+	struct lib_map_window maps[LIB_MAP_WINDOWS];
+	int last_map;
+	uint64_t map_clock;
+	/* MMIO/MEM through the broker: the physical range of the PCI BAR
+	 * whose resource file fd is, from the start of its first page. */
+	uint64_t fd_addr;
+	uint64_t fd_len;
+	/* Read/write twin through which the side effects of stand-in
+	 * registers are applied, see lib_sim.c. NULL on real hardware. */
+	struct iot_handle *sim;
+};
+
+/*
+ * An address space implementation. Widths are checked before read and write
+ * are called. readv and writev are optional; without them vectored accesses
+ * are performed one element at a time. file_pos is set by spaces whose reads
+ * are positioned reads of h->fd; it translates a register address into the
+ * file offset, which lets the batch engine perform the read.
+ */
+struct lib_backend {
+	struct iot_space_info info;
+	int (*open)(struct iot_handle *h);
+	int (*read)(struct iot_handle *h, uint64_t addr, int width,
+	            uint64_t *value);
+	int (*write)(struct iot_handle *h, uint64_t addr, int width,
+	             uint64_t value);
+	int (*readv)(struct iot_handle *h, struct iot_access *acc, int n);
+	int (*writev)(struct iot_handle *h, struct iot_access *acc, int n);
+	int (*file_pos)(const struct iot_handle *h, uint64_t addr,
+	                uint64_t *pos);
+	void (*close)(struct iot_handle *h);
+};
+
+extern const struct lib_backend lib_pci_backend;
+extern const struct lib_backend lib_mmio_backend;
+extern const struct lib_backend lib_mem_backend;
+extern const struct lib_backend lib_io_backend;
+extern const struct lib_backend lib_msr_backend;
+extern const struct lib_backend lib_smbus_backend;
+extern const struct lib_backend lib_cmos_backend;
+extern const struct lib_backend lib_scom_backend;
+
+/* Library counters, see struct iot_stats. Handles may be used from several
+ * threads at once (snapshot lanes, the daemon), so the counters are only
+ * updated and read with relaxed atomics. */
+extern struct iot_stats lib_stats;
+extern int lib_stats_timing;
+
+#define LIB_COUNT(counter_, n_) \
+	__atomic_fetch_add(&(counter_), (n_), __ATOMIC_RELAXED)
+#define LIB_STAT(counter_) __atomic_load_n(&(counter_), __ATOMIC_RELAXED)
+#define LIB_SYSCALLS(n_) LIB_COUNT(lib_stats.syscalls, (n_))
+
+static inline uint64_t
+lib_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Tracing, see iot_trace_start(). lib_trace is NULL unless recording. */
+extern struct iot_trace_header *lib_trace;
+void lib_trace_access(const struct iot_handle *h, int flags, uint64_t addr,
+                      int width, uint64_t value);
+
+/* Open a device file by its usual path, below the root set with
+ * iot_set_root(), or through the broker set with iot_set_broker(). */
+int lib_open(const char *path, int flags);
+
+/* The broker, see broker.h. lib_broker_open() returns the descriptor the
+ * broker handed out for path. */
+int lib_broker_enabled(void);
+int lib_broker_open(const char *path, int flags);
+
+/*
+ * Side effects of the registers of a stand-in tree, read from the file
+ * "effects" at its top. Accesses of a register with the given address and
+ * width clear the rc bits after reading them, treat the w1c bits as write one
+ * to clear, and clear the sc bits again once they have been written.
+ */
+struct lib_sim_reg {
+	enum iot_space space;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	uint64_t addr;
+	int width;
+	uint64_t rc;
+	uint64_t w1c;
+	uint64_t sc;
+};
+
+/* Load the effects below root, or forget them if root is NULL. */
+int lib_sim_load(const char *root);
+/* Whether any register of the device has side effects. */
+int lib_sim_device(enum iot_space space, const unsigned int *dev);
+const struct lib_sim_reg *lib_sim_find(const struct iot_handle *h,
+                                       uint64_t addr, int width);
+
+/* Positioned access to a device file whose registers are little endian. */
+int lib_file_read(int fd, uint64_t pos, int width, uint64_t *value);
+int lib_file_write(int fd, uint64_t pos, int width, uint64_t value);
+
+/* lib_file_read() without accounting, for use outside the calling thread. */
+int lib_file_pread(int fd, uint64_t pos, int width, uint64_t *value);
+/* Decode a little endian register of the given width. */
+uint64_t lib_get_reg(const uint8_t *buf, int width);
+/* A file_pos for files laid out like the register space. */
+int lib_file_pos(const struct iot_handle *h, uint64_t addr, uint64_t *pos);
+
+/* Vectored reads at file position addr - base. Accesses that are adjacent in
+ * the file are merged into a single pread() of up to LIB_MAX_COALESCE bytes.
+ * Addresses below base fail with EINVAL. */
+#define LIB_MAX_COALESCE 4096
+int lib_file_readv(int fd, uint64_t base, struct iot_access *acc, int n);
+
+/*
+ * The batch engine, see iot_read_batch(). Each read stores its value and
+ * status in *acc. The engine may read from other threads, but accounts its
+ * system calls in lib_stats from the calling one.
+ */
+struct lib_pread {
+	int fd;
+	int width;
+	uint64_t pos;
+	struct iot_access *acc;
+};
+
+/* Callers hand the engine at most this many reads at a time. */
+#define LIB_ENGINE_CHUNK 256
+void lib_engine_read(struct lib_pread *ops, int n);
+
+#define NVRAM_DEVICE	"/dev/nvram"
+#define NVRAM_OFFSET	IOT_CMOS_MIN_ADDR  /* From the kernel driver. */
+
+#endif /* _LIB_INTERNAL_H_ */
@@ -0,0 +1,125 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: IO port access. x86 uses in/out instructions, other platforms
+ * go through the /dev/port device node.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "lib_internal.h"
+#include "platform.h"
+#ifdef ARCH_X86
+#include <sys/io.h>
+#endif /* #ifdef ARCH_X86 */
+
+#ifdef ARCH_X86
+
+static int
+lib_io_open(struct iot_handle *h)
+{
+	/* The in/out instructions need IO privilege level 3. */
+	LIB_SYSCALLS(1);
+	return iopl(3);
+}
+
+static int
+lib_io_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	switch (width) {
+	case 8:  *value = inb(addr); break;
+	case 16: *value = inw(addr); break;
+	default: *value = inl(addr); break;
+	}
+	return 0;
+}
+
+static int
+lib_io_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	switch (width) {
+	case 8:  outb(value, addr); break;
+	case 16: outw(value, addr); break;
+	default: outl(value, addr); break;
+	}
+	return 0;
+}
+
+static void
+lib_io_close(struct iot_handle *h)
+{
+}
+
+#else
+
+/* Platform independent IO port access using /dev/port device node */
+static const char dev_port[] = "/dev/port";
+
+static int
+lib_io_open(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	h->fd = lib_open(dev_port, (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY);
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int
+lib_io_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	return lib_file_read(h->fd, addr, width, value);
+}
+
+static int
+lib_io_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	return lib_file_write(h->fd, addr, width, value);
+}
+
+static int
+lib_io_readv(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	return lib_file_readv(h->fd, 0, acc, n);
+}
+
+static void
+lib_io_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	close(h->fd);
+}
+
+#endif  /* #ifdef ARCH_X86 */
+
+const struct lib_backend lib_io_backend = {
+#ifdef ARCH_X86
+	.info = { "io", 0, 8, 32, 0 },
+#else
+	.info = { "io", 0, 8, 32, IOT_CAP_PREAD },
+#endif
+	.open = lib_io_open,
+	.read = lib_io_read,
+	.write = lib_io_write,
+#ifndef ARCH_X86
+	.readv = lib_io_readv,
+	.file_pos = lib_file_pos,
+#endif
+	.close = lib_io_close,
+};
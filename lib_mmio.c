@@ -0,0 +1,424 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: physical memory access through /dev/mem. MMIO handles open
+ * /dev/mem with O_SYNC so that the mapping is uncached, MEM handles get a
+ * cacheable mapping.
+ *
+ * Through the broker, /dev/mem is not available. The handle then maps the
+ * sysfs resource file of the PCI BAR that holds the address instead, which
+ * it requests from the broker once it knows the address.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "lib_internal.h"
+
+#define SYSFS_PCI_DIR "/sys/bus/pci/devices"
+
+/* Resources past the BARs (expansion ROM, bridge windows) have no resource
+ * file that can be mapped. */
+#define PCI_NUM_BARS 6
+#define IORESOURCE_MEM 0x200
+
+static int
+lib_mmio_open(struct iot_handle *h)
+{
+	int flags = (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY;
+
+	if (lib_broker_enabled()) {
+		return 0;
+	}
+	if (h->space == IOT_SPACE_MMIO) {
+		flags |= O_SYNC;
+	}
+	LIB_SYSCALLS(1);
+	h->fd = lib_open("/dev/mem", flags);
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+/* Find the memory BAR holding [addr, addr + len) in the sysfs resource
+ * tables, which anybody may read. */
+static int
+find_bar(uint64_t addr, uint64_t len, char *path, size_t size,
+         uint64_t *bar_start, uint64_t *bar_len)
+{
+	char buf[PATH_MAX], line[128];
+	unsigned long long start, end, flags;
+	struct dirent *de;
+	int found = 0, bar;
+	FILE *f;
+	DIR *d;
+
+	snprintf(buf, sizeof(buf), "%s%s", iot_get_root(), SYSFS_PCI_DIR);
+	LIB_SYSCALLS(1);
+	d = opendir(buf);
+	if (d == NULL)
+		return -1;
+	while (!found && (de = readdir(d)) != NULL) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(buf, sizeof(buf), "%s%s/%s/resource", iot_get_root(),
+		         SYSFS_PCI_DIR, de->d_name);
+		LIB_SYSCALLS(1);
+		f = fopen(buf, "r");
+		if (f == NULL)
+			continue;
+		for (bar = 0; bar < PCI_NUM_BARS &&
+		     fgets(line, sizeof(line), f) != NULL; bar++) {
+			if (sscanf(line, "%llx %llx %llx", &start, &end,
+			           &flags) != 3 ||
+			    !(flags & IORESOURCE_MEM) || end <= start ||
+			    addr < start || addr + len - 1 > end)
+				continue;
+			snprintf(path, size, "%s/%s/resource%d", SYSFS_PCI_DIR,
+			         de->d_name, bar);
+			*bar_start = start;
+			*bar_len = end - start + 1;
+			found = 1;
+			break;
+		}
+		fclose(f);
+	}
+	closedir(d);
+
+	if (!found) {
+		errno = ENXIO;
+		return -1;
+	}
+	return 0;
+}
+
+/* Make h->fd the resource file of the BAR holding [addr, addr + len). */
+static int
+open_bar(struct iot_handle *h, uint64_t addr, uint64_t len)
+{
+	uint64_t pgsize = getpagesize();
+	uint64_t start, bar_len;
+	char path[PATH_MAX];
+	int fd;
+
+	if (len == 0)
+		len = 1;
+	if (h->fd >= 0 && addr >= h->fd_addr &&
+	    addr + len <= h->fd_addr + h->fd_len)
+		return 0;
+
+	if (find_bar(addr, len, path, sizeof(path), &start, &bar_len) < 0)
+		return -1;
+	LIB_SYSCALLS(1);
+	fd = lib_open(path, (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (h->fd >= 0) {
+		LIB_SYSCALLS(1);
+		close(h->fd);
+	}
+	/* A BAR smaller than a page is mapped with the page it starts in. */
+	h->fd = fd;
+	h->fd_addr = start & ~(pgsize - 1);
+	h->fd_len = start + bar_len - h->fd_addr;
+	return 0;
+}
+
+/* Windows grow to take in accesses next to them, at least doubling so that
+ * a sequential scan remaps only a few times, up to this size. */
+#define MAX_MERGED_MAP (64 << 20)
+
+static int
+window_covers(const struct lib_map_window *w, uint64_t addr, size_t len)
+{
+	return w->mem != NULL && addr >= w->addr &&
+		addr + len <= w->addr + w->len;
+}
+
+static void
+unmap_window(struct lib_map_window *w)
+{
+	if (w->mem != NULL) {
+		LIB_SYSCALLS(1);
+		munmap((void *)w->mem, w->len);
+		w->mem = NULL;
+	}
+}
+
+static volatile void *
+use_window(struct iot_handle *h, int i, uint64_t addr)
+{
+	struct lib_map_window *w = &h->maps[i];
+
+	h->last_map = i;
+	w->last_use = ++h->map_clock;
+	return (volatile char *)w->mem + (addr - w->addr);
+}
+
+/* A window touching [start, end) that may be grown to cover it, or -1. */
+static int
+find_neighbour(struct iot_handle *h, uint64_t start, uint64_t end)
+{
+	struct lib_map_window *w;
+	int i;
+
+	for (i = 0; i < LIB_MAP_WINDOWS; i++) {
+		w = &h->maps[i];
+		if (w->mem == NULL || w->addr > end || start > w->addr + w->len)
+			continue;
+		/* Through the broker a mapping can't leave the current BAR. */
+		if (lib_broker_enabled() &&
+		    (w->addr < h->fd_addr ||
+		     w->addr + w->len > h->fd_addr + h->fd_len))
+			continue;
+		return i;
+	}
+	return -1;
+}
+
+/* A free slot, or else the least recently used window. */
+static int
+find_victim(struct iot_handle *h)
+{
+	int i, victim = 0;
+
+	for (i = 0; i < LIB_MAP_WINDOWS; i++) {
+		if (h->maps[i].mem == NULL)
+			return i;
+		if (h->maps[i].last_use < h->maps[victim].last_use)
+			victim = i;
+	}
+	return victim;
+}
+
+static void *
+map_range(struct iot_handle *h, uint64_t start, uint64_t end)
+{
+	int prot = PROT_READ;
+
+	if (h->flags & IOT_RDWR)
+		prot |= PROT_WRITE;
+	LIB_SYSCALLS(1);
+	LIB_COUNT(lib_stats.maps, 1);
+	return mmap(NULL, end - start, prot, MAP_SHARED, h->fd,
+	            start - h->fd_addr);
+}
+
+/*
+ * Mappings are kept per handle, and so per caching mode: MMIO handles map
+ * /dev/mem opened with O_SYNC, MEM handles map it cacheable. A request that
+ * no window covers grows a neighbouring window where it can, otherwise it
+ * gets a window of its own, replacing the least recently used one when all
+ * are taken.
+ */
+volatile void *
+iot_map(struct iot_handle *h, uint64_t addr, size_t len)
+{
+	uint64_t pgsize = getpagesize();
+	uint64_t start, end, grow_start, grow_end;
+	struct lib_map_window *w;
+	uint64_t t0 = 0;
+	void *mem;
+	int i;
+
+	if (h->space != IOT_SPACE_MMIO && h->space != IOT_SPACE_MEM) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (window_covers(&h->maps[h->last_map], addr, len))
+		return use_window(h, h->last_map, addr);
+	for (i = 0; i < LIB_MAP_WINDOWS; i++) {
+		if (window_covers(&h->maps[i], addr, len))
+			return use_window(h, i, addr);
+	}
+
+	start = addr & ~(pgsize - 1);
+	end = (addr + len + pgsize - 1) & ~(pgsize - 1);
+
+	if (lib_stats_timing)
+		t0 = lib_now_ns();
+	if (lib_broker_enabled() && open_bar(h, addr, len) < 0) {
+		if (lib_stats_timing)
+			LIB_COUNT(lib_stats.map_ns, lib_now_ns() - t0);
+		return NULL;
+	}
+
+	i = find_neighbour(h, start, end);
+	if (i >= 0) {
+		w = &h->maps[i];
+		grow_start = start < w->addr ? start : w->addr;
+		grow_end = end > w->addr + w->len ? end : w->addr + w->len;
+		if (grow_end > w->addr + w->len &&
+		    grow_end < w->addr + 2 * w->len)
+			grow_end = w->addr + 2 * w->len;
+		if (grow_start < w->addr && w->addr >= w->len &&
+		    grow_start > w->addr - w->len)
+			grow_start = w->addr - w->len;
+		if (lib_broker_enabled()) {
+			if (grow_start < h->fd_addr)
+				grow_start = h->fd_addr;
+			if (grow_end > ((h->fd_addr + h->fd_len + pgsize - 1) &
+			                ~(pgsize - 1)))
+				grow_end = (h->fd_addr + h->fd_len +
+				            pgsize - 1) & ~(pgsize - 1);
+		}
+		if (grow_end - grow_start <= MAX_MERGED_MAP) {
+			/* Memory the grown window would take in may not be
+			 * mappable; then the request is mapped on its own. */
+			mem = map_range(h, grow_start, grow_end);
+			if (mem != MAP_FAILED) {
+				unmap_window(w);
+				w->mem = mem;
+				w->addr = grow_start;
+				w->len = grow_end - grow_start;
+				if (lib_stats_timing)
+					LIB_COUNT(lib_stats.map_ns,
+					          lib_now_ns() - t0);
+				return use_window(h, i, addr);
+			}
+		}
+	}
+
+	mem = map_range(h, start, end);
+	if (lib_stats_timing)
+		LIB_COUNT(lib_stats.map_ns, lib_now_ns() - t0);
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	i = find_victim(h);
+	w = &h->maps[i];
+	unmap_window(w);
+	w->mem = mem;
+	w->addr = start;
+	w->len = end - start;
+
+	return use_window(h, i, addr);
+}
+
+static int
+lib_mmio_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	volatile void *p = iot_map(h, addr, width / 8);
+
+	if (p == NULL) {
+		return -1;
+	}
+
+	switch (width) {
+	case 8:  *value = *(volatile uint8_t *)p; break;
+	case 16: *value = *(volatile uint16_t *)p; break;
+	case 32: *value = *(volatile uint32_t *)p; break;
+	default: *value = *(volatile uint64_t *)p; break;
+	}
+	return 0;
+}
+
+static int
+lib_mmio_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	volatile void *p = iot_map(h, addr, width / 8);
+
+	if (p == NULL) {
+		return -1;
+	}
+
+	switch (width) {
+	case 8:  *(volatile uint8_t *)p = value; break;
+	case 16: *(volatile uint16_t *)p = value; break;
+	case 32: *(volatile uint32_t *)p = value; break;
+	default: *(volatile uint64_t *)p = value; break;
+	}
+	return 0;
+}
+
+/* Largest span a vectored access maps in one go. */
+#define MAX_VECTOR_MAP (64 << 20)
+
+/* Map the span of all accesses once, then perform each of them with its own
+ * width; registers are never merged into wider loads. */
+static int
+lib_mmio_readv(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	uint64_t lo = UINT64_MAX, hi = 0;
+	int first_errno = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (acc[i].addr < lo)
+			lo = acc[i].addr;
+		if (acc[i].addr + acc[i].width / 8 > hi)
+			hi = acc[i].addr + acc[i].width / 8;
+	}
+	/* Failures show up in the individual accesses. */
+	if (n > 0 && hi - lo <= MAX_VECTOR_MAP)
+		iot_map(h, lo, hi - lo);
+
+	for (i = 0; i < n; i++) {
+		acc[i].status = 0;
+		if (lib_mmio_read(h, acc[i].addr, acc[i].width,
+		                  &acc[i].value) < 0) {
+			acc[i].status = -errno;
+			if (!first_errno)
+				first_errno = errno;
+		}
+	}
+
+	if (first_errno) {
+		errno = first_errno;
+		return -1;
+	}
+	return 0;
+}
+
+static void
+lib_mmio_close(struct iot_handle *h)
+{
+	int i;
+
+	for (i = 0; i < LIB_MAP_WINDOWS; i++)
+		unmap_window(&h->maps[i]);
+	if (h->fd >= 0) {
+		LIB_SYSCALLS(1);
+		close(h->fd);
+	}
+}
+
+const struct lib_backend lib_mmio_backend = {
+	.info = { "mmio", 0, 8, 64, IOT_CAP_MMAP },
+	.open = lib_mmio_open,
+	.read = lib_mmio_read,
+	.write = lib_mmio_write,
+	.readv = lib_mmio_readv,
+	.close = lib_mmio_close,
+};
+
+const struct lib_backend lib_mem_backend = {
+	.info = { "mem", 0, 8, 64, IOT_CAP_MMAP },
+	.open = lib_mmio_open,
+	.read = lib_mmio_read,
+	.write = lib_mmio_write,
+	.readv = lib_mmio_readv,
+	.close = lib_mmio_close,
+};
@@ -0,0 +1,67 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: model specific register access through the linux msr driver.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "lib_internal.h"
+
+static int
+lib_msr_open(struct iot_handle *h)
+{
+	char dev[64];
+
+	snprintf(dev, sizeof(dev), "/dev/cpu/%u/msr", h->dev[0]);
+	LIB_SYSCALLS(1);
+	h->fd = lib_open(dev, (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY);
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int
+lib_msr_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	return lib_file_read(h->fd, addr, width, value);
+}
+
+static int
+lib_msr_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	return lib_file_write(h->fd, addr, width, value);
+}
+
+static void
+lib_msr_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	close(h->fd);
+}
+
+const struct lib_backend lib_msr_backend = {
+	.info = { "msr", 1, 64, 64, IOT_CAP_PREAD },
+	.open = lib_msr_open,
+	.read = lib_msr_read,
+	.write = lib_msr_write,
+	.file_pos = lib_file_pos,
+	.close = lib_msr_close,
+};
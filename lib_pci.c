@@ -0,0 +1,98 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: PCI config space access through sysfs or /proc/bus/pci.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "lib_internal.h"
+
+#define PROCFS_BASE_DIR	"/proc/bus/pci"
+#define SYSFS_BASE_DIR	"/sys/bus/pci/devices"
+
+static int
+lib_pci_open(struct iot_handle *h)
+{
+	char filename[FILENAME_MAX];
+	int mode = (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY;
+	unsigned int segment = h->dev[0];
+	unsigned int bus = h->dev[1];
+	unsigned int device = h->dev[2];
+	unsigned int function = h->dev[3];
+
+	/* Try sysfs first, but fall back on the proc filesystem. */
+	snprintf(filename, sizeof(filename), "%s/%04x:%02x:%02x.%x/config",
+		 SYSFS_BASE_DIR, segment, bus, device, function);
+	LIB_SYSCALLS(1);
+	h->fd = lib_open(filename, mode);
+
+	/* If sysfs failed, try the proc filesystem. */
+	if (h->fd < 0) {
+		if (segment == 0) {
+			snprintf(filename, sizeof(filename), "%s/%02x/%02x.%x",
+				 PROCFS_BASE_DIR, bus, device, function);
+		} else {
+			snprintf(filename, sizeof(filename),
+			         "%s/%04x:%02x/%02x.%x", PROCFS_BASE_DIR,
+			         segment, bus, device, function);
+		}
+		LIB_SYSCALLS(1);
+		h->fd = lib_open(filename, mode);
+	}
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int
+lib_pci_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	return lib_file_read(h->fd, addr, width, value);
+}
+
+static int
+lib_pci_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	return lib_file_write(h->fd, addr, width, value);
+}
+
+static int
+lib_pci_readv(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	return lib_file_readv(h->fd, 0, acc, n);
+}
+
+static void
+lib_pci_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	close(h->fd);
+}
+
+const struct lib_backend lib_pci_backend = {
+	.info = { "pci", 4, 8, 32, IOT_CAP_PREAD },
+	.open = lib_pci_open,
+	.read = lib_pci_read,
+	.write = lib_pci_write,
+	.readv = lib_pci_readv,
+	.file_pos = lib_file_pos,
+	.close = lib_pci_close,
+};
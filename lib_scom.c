@@ -0,0 +1,95 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: POWER CPU SCOM register access, requires linux SCOM debugfs
+ * support.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "lib_internal.h"
+
+/* Translate a SCOM address into an offset in the debugfs access file. */
+static off_t
+scom_offset(uint64_t scom)
+{
+	/* Shift scom address to align to 8 byte boundary, mask high bit */
+	uint64_t offset = (scom & ((1ULL << 63) - 1)) << 3;
+	/* Handle high bit (indirect SCOM) by shifting the bit right one bit.
+	   File offsets are signed, and this is how the kernel expects us to
+	   mangle it.
+	   Note we set bit 62 instead of bit 59 because of a bug in the kernel
+	   scom.c that shifts the whole value right 3 before looking for
+	   bit 59 set.
+	*/
+	if (scom & (1ULL << 63)) {
+		offset |= 1ULL << 62;
+	}
+	return offset;
+}
+
+static int
+lib_scom_open(struct iot_handle *h)
+{
+	char dev[512];
+
+	snprintf(dev, sizeof(dev), "/sys/kernel/debug/powerpc/scom/%08x/access",
+	         h->dev[0]);
+	LIB_SYSCALLS(1);
+	h->fd = lib_open(dev, (h->flags & IOT_RDWR) ? O_RDWR : O_RDONLY);
+
+	return h->fd < 0 ? -1 : 0;
+}
+
+static int
+lib_scom_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	return lib_file_read(h->fd, scom_offset(addr), width, value);
+}
+
+static int
+lib_scom_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	return lib_file_write(h->fd, scom_offset(addr), width, value);
+}
+
+static int
+lib_scom_file_pos(const struct iot_handle *h, uint64_t addr, uint64_t *pos)
+{
+	*pos = scom_offset(addr);
+	return 0;
+}
+
+static void
+lib_scom_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	close(h->fd);
+}
+
+const struct lib_backend lib_scom_backend = {
+	.info = { "scom", 1, 64, 64, IOT_CAP_PREAD },
+	.open = lib_scom_open,
+	.read = lib_scom_read,
+	.write = lib_scom_write,
+	.file_pos = lib_scom_file_pos,
+	.close = lib_scom_close,
+};
@@ -0,0 +1,216 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: side effects of stand-in registers, see iot_set_root().
+ *
+ * A stand-in tree may carry a file named "effects" at its top that gives
+ * registers the behaviour of status and command registers, one register per
+ * line:
+ *
+ *	# space[width] device... address effect=mask...
+ *	pci16 0 0 31 3 0x1e w1c=0xf900
+ *	msr 0 0x179 rc=0xffffffffffffffff
+ *	smbus8 0 0x2d 0x40 sc=0x80
+ *
+ * Effects are rc (clear on read), w1c (write one to clear) and sc (self
+ * clearing). A register may appear on several lines.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lib_internal.h"
+
+#define SIM_EFFECTS "/effects"
+#define SIM_MAX_LINE 512
+
+static struct lib_sim_reg *sim_regs;
+static int sim_nregs;
+
+/* Parse a space name with an optional width, like "pci16" or "msr". */
+static int
+parse_space(const char *name, enum iot_space *space, int *width)
+{
+	const struct iot_space_info *si;
+	enum iot_space s;
+	size_t len;
+	char *end;
+	long w;
+
+	for (s = 0; s < IOT_SPACE_MAX; s++) {
+		si = iot_space_info(s);
+		len = strlen(si->name);
+		if (strncmp(name, si->name, len))
+			continue;
+		if (name[len] == '\0') {
+			if (si->min_width != si->max_width)
+				continue;
+			w = si->min_width;
+		} else {
+			w = strtol(&name[len], &end, 10);
+			if (*end != '\0' || w < si->min_width ||
+			    w > si->max_width || (w & (w - 1)))
+				continue;
+		}
+		*space = s;
+		*width = w;
+		return 0;
+	}
+	return -1;
+}
+
+static int
+parse_number(const char *s, uint64_t *value)
+{
+	char *end;
+
+	if (s == NULL || *s == '\0')
+		return -1;
+	*value = strtoull(s, &end, 0);
+	return *end == '\0' ? 0 : -1;
+}
+
+static struct lib_sim_reg *
+find_reg(const struct lib_sim_reg *key)
+{
+	int ndev = iot_space_info(key->space)->ndev;
+	struct lib_sim_reg *reg;
+	int i;
+
+	for (i = 0; i < sim_nregs; i++) {
+		reg = &sim_regs[i];
+		if (reg->space == key->space && reg->addr == key->addr &&
+		    reg->width == key->width &&
+		    !memcmp(reg->dev, key->dev, ndev * sizeof(*reg->dev)))
+			return reg;
+	}
+	return NULL;
+}
+
+/* Add the register described by one line of the effects file. */
+static int
+parse_line(char *line)
+{
+	struct lib_sim_reg key, *reg;
+	char *tok, *save, *eq;
+	uint64_t value;
+	int i;
+
+	line[strcspn(line, "#\n")] = '\0';
+	tok = strtok_r(line, " \t", &save);
+	if (tok == NULL)
+		return 0;
+
+	memset(&key, 0, sizeof(key));
+	if (parse_space(tok, &key.space, &key.width) < 0)
+		return -1;
+	for (i = 0; i < iot_space_info(key.space)->ndev; i++) {
+		if (parse_number(strtok_r(NULL, " \t", &save), &value) < 0)
+			return -1;
+		key.dev[i] = value;
+	}
+	if (parse_number(strtok_r(NULL, " \t", &save), &key.addr) < 0)
+		return -1;
+
+	reg = find_reg(&key);
+	if (reg == NULL) {
+		reg = realloc(sim_regs, (sim_nregs + 1) * sizeof(*sim_regs));
+		if (reg == NULL)
+			return -1;
+		sim_regs = reg;
+		reg = &sim_regs[sim_nregs++];
+		*reg = key;
+	}
+
+	while ((tok = strtok_r(NULL, " \t", &save)) != NULL) {
+		eq = strchr(tok, '=');
+		if (eq == NULL || parse_number(eq + 1, &value) < 0)
+			return -1;
+		*eq = '\0';
+		if (!strcmp(tok, "rc"))
+			reg->rc |= value;
+		else if (!strcmp(tok, "w1c"))
+			reg->w1c |= value;
+		else if (!strcmp(tok, "sc"))
+			reg->sc |= value;
+		else
+			return -1;
+	}
+	return 0;
+}
+
+int
+lib_sim_load(const char *root)
+{
+	char path[PATH_MAX], line[SIM_MAX_LINE];
+	FILE *f;
+
+	free(sim_regs);
+	sim_regs = NULL;
+	sim_nregs = 0;
+	if (root == NULL)
+		return 0;
+
+	if (snprintf(path, sizeof(path), "%s" SIM_EFFECTS, root) >=
+	    sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	f = fopen(path, "r");
+	if (f == NULL)
+		return errno == ENOENT ? 0 : -1;
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (parse_line(line) < 0) {
+			fclose(f);
+			lib_sim_load(NULL);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	fclose(f);
+	return 0;
+}
+
+int
+lib_sim_device(enum iot_space space, const unsigned int *dev)
+{
+	int ndev = iot_space_info(space)->ndev;
+	int i;
+
+	for (i = 0; i < sim_nregs; i++) {
+		if (sim_regs[i].space == space &&
+		    !memcmp(sim_regs[i].dev, dev, ndev * sizeof(*dev)))
+			return 1;
+	}
+	return 0;
+}
+
+const struct lib_sim_reg *
+lib_sim_find(const struct iot_handle *h, uint64_t addr, int width)
+{
+	struct lib_sim_reg key;
+
+	key.space = h->space;
+	memcpy(key.dev, h->dev, sizeof(key.dev));
+	key.addr = addr;
+	key.width = width;
+	return find_reg(&key);
+}
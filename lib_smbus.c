@@ -0,0 +1,366 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: SMBus register access through the linux i2c-dev interface.
+ * Addresses are SMBus command codes. 32 and 64 bit registers are accessed
+ * with i2c block transfers.
+ *
+ * Below a stand-in root, a regular file in place of the i2c-dev node models
+ * the adapter (see iot_set_root()) and iot_i2c_ioctl() carries out the
+ * transactions on it: each slave is a 256 byte register file with an
+ * address counter that wraps around, like an EEPROM.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "lib_internal.h"
+#define I2C_IOCTL iot_i2c_ioctl
+#include "linux-i2c-dev.h"
+
+#define MODEL_MAX_FD 1024
+#define MODEL_SLAVE_SIZE 256
+
+/* Modelled adapters by file descriptor. */
+static struct i2c_model {
+	uint8_t active;
+	uint8_t slave;
+	uint8_t ptr;     /* register of the next receive byte */
+} i2c_models[MODEL_MAX_FD];
+
+/* Read or write len registers of a slave, starting at reg. */
+static int
+model_xfer(int fd, int slave, uint8_t reg, uint8_t *buf, int len, int write)
+{
+	off_t base = (off_t)slave * MODEL_SLAVE_SIZE;
+	struct stat st;
+	ssize_t r;
+	int n;
+
+	if (fstat(fd, &st) < 0)
+		return -1;
+	if (st.st_size < base + MODEL_SLAVE_SIZE) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	for (; len > 0; len -= n, buf += n, reg += n) {
+		n = MODEL_SLAVE_SIZE - reg < len ? MODEL_SLAVE_SIZE - reg : len;
+		if (write)
+			r = pwrite(fd, buf, n, base + reg);
+		else
+			r = pread(fd, buf, n, base + reg);
+		if (r != n) {
+			if (r >= 0)
+				errno = EIO;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* An SMBus block starts with its length, which the slave sends first. */
+static int
+model_block(int fd, struct i2c_model *m, uint8_t reg, uint8_t *block,
+            int write)
+{
+	if (write) {
+		if (block[0] > I2C_SMBUS_BLOCK_MAX) {
+			errno = EINVAL;
+			return -1;
+		}
+		return model_xfer(fd, m->slave, reg, block, block[0] + 1, 1);
+	}
+
+	if (model_xfer(fd, m->slave, reg, block, 1, 0) < 0)
+		return -1;
+	if (block[0] == 0 || block[0] > I2C_SMBUS_BLOCK_MAX) {
+		errno = EPROTO;
+		return -1;
+	}
+	return model_xfer(fd, m->slave, reg + 1, &block[1], block[0], 0);
+}
+
+static int
+model_smbus(int fd, struct i2c_model *m, struct i2c_smbus_ioctl_data *args)
+{
+	union i2c_smbus_data *data = args->data;
+	int write = (args->read_write == I2C_SMBUS_WRITE);
+	uint8_t reg = args->command;
+	uint8_t word[2];
+
+	switch (args->size) {
+	case I2C_SMBUS_QUICK:
+		return model_xfer(fd, m->slave, 0, NULL, 0, 0);
+	case I2C_SMBUS_BYTE:
+		if (write) {
+			m->ptr = reg;
+			return model_xfer(fd, m->slave, 0, NULL, 0, 0);
+		}
+		if (model_xfer(fd, m->slave, m->ptr, &data->byte, 1, 0) < 0)
+			return -1;
+		m->ptr++;
+		return 0;
+	case I2C_SMBUS_BYTE_DATA:
+		m->ptr = reg + 1;
+		return model_xfer(fd, m->slave, reg, &data->byte, 1, write);
+	case I2C_SMBUS_WORD_DATA:
+	case I2C_SMBUS_PROC_CALL:
+		m->ptr = reg + 2;
+		if (write) {
+			word[0] = data->word;
+			word[1] = data->word >> 8;
+			if (model_xfer(fd, m->slave, reg, word, 2, 1) < 0)
+				return -1;
+			if (args->size != I2C_SMBUS_PROC_CALL)
+				return 0;
+		}
+		if (model_xfer(fd, m->slave, reg, word, 2, 0) < 0)
+			return -1;
+		data->word = word[0] | word[1] << 8;
+		return 0;
+	case I2C_SMBUS_BLOCK_DATA:
+		return model_block(fd, m, reg, data->block, write);
+	case I2C_SMBUS_BLOCK_PROC_CALL:
+		if (model_block(fd, m, reg, data->block, 1) < 0)
+			return -1;
+		return model_block(fd, m, reg, data->block, 0);
+	case I2C_SMBUS_I2C_BLOCK_BROKEN:
+	case I2C_SMBUS_I2C_BLOCK_DATA:
+		if (data->block[0] == 0 ||
+		    data->block[0] > I2C_SMBUS_I2C_BLOCK_MAX) {
+			errno = EINVAL;
+			return -1;
+		}
+		m->ptr = reg + data->block[0];
+		return model_xfer(fd, m->slave, reg, &data->block[1],
+		                  data->block[0], write);
+	}
+
+	errno = EINVAL;
+	return -1;
+}
+
+/* Plain i2c messages: a write sets the address counter with its first byte
+ * and stores the rest, a read continues at the address counter. */
+static int
+model_rdwr(int fd, struct i2c_model *m, struct i2c_rdwr_ioctl_data *rdwr)
+{
+	struct i2c_msg *msg;
+	int i, len;
+
+	for (i = 0; i < rdwr->nmsgs; i++) {
+		msg = &rdwr->msgs[i];
+		if (msg->addr > 0x7f || msg->len < 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		m->slave = msg->addr;
+		len = msg->len;
+		if (msg->flags & I2C_M_RD) {
+			if (model_xfer(fd, m->slave, m->ptr,
+			               (uint8_t *)msg->buf, len, 0) < 0)
+				return -1;
+			m->ptr += len;
+			continue;
+		}
+		if (len == 0) {
+			if (model_xfer(fd, m->slave, 0, NULL, 0, 0) < 0)
+				return -1;
+			continue;
+		}
+		m->ptr = msg->buf[0];
+		if (model_xfer(fd, m->slave, m->ptr, (uint8_t *)msg->buf + 1,
+		               len - 1, 1) < 0)
+			return -1;
+		m->ptr += len - 1;
+	}
+	return rdwr->nmsgs;
+}
+
+int
+iot_i2c_ioctl(int fd, unsigned long request, void *arg)
+{
+	struct i2c_model *m;
+
+	if (fd < 0 || fd >= MODEL_MAX_FD || !i2c_models[fd].active)
+		return ioctl(fd, request, arg);
+
+	m = &i2c_models[fd];
+	switch (request) {
+	case I2C_SLAVE:
+	case I2C_SLAVE_FORCE:
+		if ((uintptr_t)arg > 0x7f) {
+			errno = EINVAL;
+			return -1;
+		}
+		m->slave = (uintptr_t)arg;
+		return 0;
+	case I2C_SMBUS:
+		return model_smbus(fd, m, arg);
+	case I2C_RDWR:
+		return model_rdwr(fd, m, arg);
+	}
+
+	errno = ENOTTY;
+	return -1;
+}
+
+/* Model the adapter if its device file is a regular file. */
+static int
+model_open(int fd)
+{
+	struct stat st;
+
+	if (iot_get_root()[0] == '\0')
+		return 0;
+	LIB_SYSCALLS(1);
+	if (fstat(fd, &st) < 0)
+		return -1;
+	if (!S_ISREG(st.st_mode))
+		return 0;
+	if (fd >= MODEL_MAX_FD) {
+		errno = EMFILE;
+		return -1;
+	}
+	memset(&i2c_models[fd], 0, sizeof(i2c_models[fd]));
+	i2c_models[fd].active = 1;
+	return 0;
+}
+
+static int
+lib_smbus_open(struct iot_handle *h)
+{
+	char devfile[32];
+
+	snprintf(devfile, sizeof(devfile), "/dev/i2c-%u", h->dev[0]);
+	LIB_SYSCALLS(2);
+	h->fd = lib_open(devfile, O_RDWR);
+	if (h->fd < 0) {
+		return -1;
+	}
+
+	/* Double cast the last argument for compat with klibc. */
+	if (model_open(h->fd) < 0 ||
+	    iot_i2c_ioctl(h->fd, I2C_SLAVE, (void *)(intptr_t)h->dev[1]) < 0) {
+		int saved_errno = errno;
+		if (h->fd < MODEL_MAX_FD)
+			i2c_models[h->fd].active = 0;
+		close(h->fd);
+		errno = saved_errno;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+lib_smbus_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	union {
+		uint32_t u32;
+		uint64_t u64;
+	} data;
+	int64_t r;
+
+	LIB_SYSCALLS(1);
+	switch (width) {
+	case 8:
+		r = i2c_smbus_read_byte_data(h->fd, addr);
+		*value = (uint8_t)r;
+		break;
+	case 16:
+		r = i2c_smbus_read_word_data(h->fd, addr);
+		*value = (uint16_t)r;
+		break;
+	case 32:
+		r = i2c_smbus_read_i2c_block_data(h->fd, addr, 4,
+		                                  (uint8_t *)&data.u32);
+		if (r >= 0 && r != 4) {
+			errno = EIO;
+			return -1;
+		}
+		*value = data.u32;
+		break;
+	default:
+		r = i2c_smbus_read_i2c_block_data(h->fd, addr, 8,
+		                                  (uint8_t *)&data.u64);
+		if (r >= 0 && r != 8) {
+			errno = EIO;
+			return -1;
+		}
+		*value = data.u64;
+		break;
+	}
+
+	return r < 0 ? -1 : 0;
+}
+
+static int
+lib_smbus_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	union {
+		uint32_t u32;
+		uint64_t u64;
+	} data;
+	int r;
+
+	LIB_SYSCALLS(1);
+	switch (width) {
+	case 8:
+		r = i2c_smbus_write_byte_data(h->fd, addr, value);
+		break;
+	case 16:
+		r = i2c_smbus_write_word_data(h->fd, addr, value);
+		break;
+	case 32:
+		data.u32 = value;
+		r = i2c_smbus_write_i2c_block_data(h->fd, addr, 4,
+		                                   (uint8_t *)&data.u32);
+		break;
+	default:
+		data.u64 = value;
+		r = i2c_smbus_write_i2c_block_data(h->fd, addr, 8,
+		                                   (uint8_t *)&data.u64);
+		break;
+	}
+
+	return r < 0 ? -1 : 0;
+}
+
+static void
+lib_smbus_close(struct iot_handle *h)
+{
+	LIB_SYSCALLS(1);
+	if (h->fd < MODEL_MAX_FD)
+		i2c_models[h->fd].active = 0;
+	close(h->fd);
+}
+
+const struct lib_backend lib_smbus_backend = {
+	.info = { "smbus", 2, 8, 64, 0 },
+	.open = lib_smbus_open,
+	.read = lib_smbus_read,
+	.write = lib_smbus_write,
+	.close = lib_smbus_close,
+};
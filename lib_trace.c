@@ -0,0 +1,207 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: access trace recording, see iot_trace_start().
+ *
+ * The trace file is mapped shared and writers claim record slots with an
+ * atomic increment of the header's record count, so recording an access
+ * costs no system call and concurrent processes interleave cleanly. A slot
+ * is filled in after it is claimed; a reader of a live trace may see a
+ * record that is still being written.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib_internal.h"
+#include "platform.h"
+
+#define TRACE_DEFAULT_CAPACITY (1 << 20)
+
+struct iot_trace_header *lib_trace;
+static struct iot_trace_record *trace_records;
+static size_t trace_len;
+
+static uint64_t
+raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int
+trace_valid(const struct iot_trace_header *hdr, off_t size)
+{
+	return !memcmp(hdr->magic, IOT_TRACE_MAGIC, sizeof(hdr->magic)) &&
+	       hdr->version == IOT_TRACE_VERSION &&
+	       hdr->record_size == sizeof(struct iot_trace_record) &&
+	       hdr->capacity > 0 &&
+	       size == sizeof(*hdr) +
+	               hdr->capacity * sizeof(struct iot_trace_record);
+}
+
+int
+iot_trace_start(const char *path, uint64_t capacity)
+{
+	struct iot_trace_header hdr;
+	struct stat st;
+	void *map;
+	int fd, saved_errno;
+
+	if (lib_trace) {
+		errno = EBUSY;
+		return -1;
+	}
+	if (capacity > (SIZE_MAX - sizeof(hdr)) /
+	               sizeof(struct iot_trace_record)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -1;
+
+	/* Other writers may be creating the same trace. */
+	if (flock(fd, LOCK_EX) < 0 || fstat(fd, &st) < 0)
+		goto fail;
+
+	if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	    !trace_valid(&hdr, st.st_size) ||
+	    (capacity != 0 && capacity != hdr.capacity)) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, IOT_TRACE_MAGIC, sizeof(hdr.magic));
+		hdr.version = IOT_TRACE_VERSION;
+		hdr.record_size = sizeof(struct iot_trace_record);
+		hdr.capacity = capacity ? capacity : TRACE_DEFAULT_CAPACITY;
+		hdr.start_ns = raw_ns();
+		hdr.start_ticks = read_ticks();
+		hdr.end_ns = hdr.start_ns;
+		hdr.end_ticks = hdr.start_ticks;
+		if (ftruncate(fd, 0) < 0 ||
+		    ftruncate(fd, sizeof(hdr) + hdr.capacity *
+		                  sizeof(struct iot_trace_record)) < 0 ||
+		    pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+			goto fail;
+	}
+
+	trace_len = sizeof(hdr) + hdr.capacity * sizeof(struct iot_trace_record);
+	map = mmap(NULL, trace_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	close(fd);
+
+	lib_trace = map;
+	trace_records = (struct iot_trace_record *)(lib_trace + 1);
+	return 0;
+
+fail:
+	saved_errno = errno;
+	close(fd);
+	errno = saved_errno;
+	return -1;
+}
+
+void
+iot_trace_stop(void)
+{
+	uint64_t ticks = read_ticks();
+
+	if (lib_trace == NULL)
+		return;
+
+	/* Widen the calibration window for whoever replays the trace. */
+	if (ticks > lib_trace->end_ticks) {
+		lib_trace->end_ns = raw_ns();
+		lib_trace->end_ticks = ticks;
+	}
+
+	munmap(lib_trace, trace_len);
+	lib_trace = NULL;
+	trace_records = NULL;
+}
+
+void
+lib_trace_access(const struct iot_handle *h, int flags, uint64_t addr,
+                 int width, uint64_t value)
+{
+	struct iot_trace_record *rec;
+	uint64_t n;
+	int i;
+
+	n = __atomic_fetch_add(&lib_trace->written, 1, __ATOMIC_RELAXED);
+	rec = &trace_records[n % lib_trace->capacity];
+
+	rec->ticks = read_ticks();
+	rec->addr = addr;
+	rec->value = value;
+	for (i = 0; i < IOT_MAX_DEV_ARGS; i++)
+		rec->dev[i] = h->dev[i];
+	rec->space = h->space;
+	rec->width = width;
+	rec->flags = flags;
+	memset(rec->reserved, 0, sizeof(rec->reserved));
+}
+
+void
+iot_trace_mapped(const struct iot_handle *h, uint64_t addr, int width,
+                 const void *data, size_t n)
+{
+	const uint8_t *p = data;
+	uint64_t v64;
+	uint32_t v32;
+	uint16_t v16;
+	size_t i;
+
+	if (lib_trace == NULL)
+		return;
+
+	/* Wider loads go down as their 64 bit pieces. */
+	if (width > 64) {
+		n *= width / 64;
+		width = 64;
+	}
+	for (i = 0; i < n; i++, p += width / 8, addr += width / 8) {
+		switch (width) {
+		case 8:
+			v64 = *p;
+			break;
+		case 16:
+			memcpy(&v16, p, sizeof(v16));
+			v64 = v16;
+			break;
+		case 32:
+			memcpy(&v32, p, sizeof(v32));
+			v64 = v32;
+			break;
+		default:
+			memcpy(&v64, p, sizeof(v64));
+			break;
+		}
+		lib_trace_access(h, 0, addr, width, v64);
+	}
+}
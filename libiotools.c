@@ -0,0 +1,775 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * libiotools: address space independent part of the handle API.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lib_internal.h"
+#include "platform.h"
+
+struct iot_stats lib_stats;
+int lib_stats_timing;
+
+/* Prefix of every device path, without a trailing slash. */
+static char lib_root[PATH_MAX];
+
+static const struct lib_backend *lib_backends[IOT_SPACE_MAX] = {
+	[IOT_SPACE_PCI]   = &lib_pci_backend,
+	[IOT_SPACE_MMIO]  = &lib_mmio_backend,
+	[IOT_SPACE_MEM]   = &lib_mem_backend,
+	[IOT_SPACE_IO]    = &lib_io_backend,
+	[IOT_SPACE_MSR]   = &lib_msr_backend,
+	[IOT_SPACE_SMBUS] = &lib_smbus_backend,
+	[IOT_SPACE_CMOS]  = &lib_cmos_backend,
+	[IOT_SPACE_SCOM]  = &lib_scom_backend,
+};
+
+const struct iot_space_info *
+iot_space_info(enum iot_space space)
+{
+	if (space < 0 || space >= IOT_SPACE_MAX)
+		return NULL;
+	return &lib_backends[space]->info;
+}
+
+const char *
+iot_space_name(enum iot_space space)
+{
+	if (space < 0 || space >= IOT_SPACE_MAX)
+		return NULL;
+	return lib_backends[space]->info.name;
+}
+
+enum iot_space
+iot_space(const struct iot_handle *h)
+{
+	return h->space;
+}
+
+int
+iot_fd(const struct iot_handle *h)
+{
+	return h->fd;
+}
+
+int
+iot_dev(const struct iot_handle *h, unsigned int *dev)
+{
+	int i;
+
+	for (i = 0; i < lib_backends[h->space]->info.ndev; i++)
+		dev[i] = h->dev[i];
+	return lib_backends[h->space]->info.ndev;
+}
+
+int
+iot_set_root(const char *root)
+{
+	size_t len;
+
+	if (root == NULL)
+		root = "";
+	len = strlen(root);
+	while (len > 0 && root[len - 1] == '/')
+		len--;
+	if (len >= sizeof(lib_root)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	memcpy(lib_root, root, len);
+	lib_root[len] = '\0';
+
+	if (lib_sim_load(len ? lib_root : NULL) < 0) {
+		lib_root[0] = '\0';
+		return -1;
+	}
+	return 0;
+}
+
+const char *
+iot_get_root(void)
+{
+	return lib_root;
+}
+
+int
+lib_open(const char *path, int flags)
+{
+	char buf[PATH_MAX];
+
+	if (lib_broker_enabled())
+		return lib_broker_open(path, flags);
+	if (lib_root[0] == '\0')
+		return open(path, flags);
+	if (snprintf(buf, sizeof(buf), "%s%s", lib_root, path) >= sizeof(buf)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	return open(buf, flags);
+}
+
+void
+iot_stats_timing(int enable)
+{
+	lib_stats_timing = enable;
+}
+
+void
+iot_stats_get(struct iot_stats *stats)
+{
+	const uint64_t *from = (const uint64_t *)&lib_stats;
+	uint64_t *to = (uint64_t *)stats;
+	size_t i;
+
+	for (i = 0; i < sizeof(lib_stats) / sizeof(*from); i++)
+		to[i] = LIB_STAT(from[i]);
+}
+
+void
+iot_stats_reset(void)
+{
+	uint64_t *counter = (uint64_t *)&lib_stats;
+	size_t i;
+
+	for (i = 0; i < sizeof(lib_stats) / sizeof(*counter); i++)
+		__atomic_store_n(&counter[i], 0, __ATOMIC_RELAXED);
+}
+
+/* Open the read/write twin of a handle to a stand-in device whose registers
+ * have side effects. */
+static int
+sim_open(struct iot_handle *h)
+{
+	struct iot_handle *sim;
+
+	sim = calloc(1, sizeof(*sim));
+	if (sim == NULL)
+		return -1;
+	*sim = *h;
+	sim->flags = IOT_RDWR;
+	sim->fd = -1;
+	if (lib_backends[h->space]->open(sim) < 0) {
+		int saved_errno = errno;
+		free(sim);
+		errno = saved_errno;
+		return -1;
+	}
+	h->sim = sim;
+	return 0;
+}
+
+struct iot_handle *
+iot_open(enum iot_space space, const unsigned int *dev, int flags)
+{
+	struct iot_handle *h;
+	uint64_t t0 = 0;
+	int i, r;
+
+	if (space < 0 || space >= IOT_SPACE_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (lib_stats_timing)
+		t0 = lib_now_ns();
+	LIB_COUNT(lib_stats.opens, 1);
+
+	h = calloc(1, sizeof(*h));
+	if (h == NULL)
+		return NULL;
+	h->space = space;
+	h->flags = flags;
+	h->fd = -1;
+	for (i = 0; i < lib_backends[space]->info.ndev; i++)
+		h->dev[i] = dev[i];
+
+	r = lib_backends[space]->open(h);
+	if (r == 0 && lib_sim_device(space, h->dev)) {
+		r = sim_open(h);
+		if (r < 0) {
+			int saved_errno = errno;
+			lib_backends[space]->close(h);
+			errno = saved_errno;
+		}
+	}
+
+	if (lib_stats_timing)
+		LIB_COUNT(lib_stats.open_ns, lib_now_ns() - t0);
+
+	if (r < 0) {
+		int saved_errno = errno;
+		free(h);
+		errno = saved_errno;
+		return NULL;
+	}
+
+	return h;
+}
+
+struct iot_handle *
+iot_pci_open(int segment, int bus, int device, int function, int flags)
+{
+	unsigned int dev[] = { segment, bus, device, function };
+	return iot_open(IOT_SPACE_PCI, dev, flags);
+}
+
+struct iot_handle *
+iot_mmio_open(int cached, int flags)
+{
+	return iot_open(cached ? IOT_SPACE_MEM : IOT_SPACE_MMIO, NULL, flags);
+}
+
+struct iot_handle *
+iot_io_open(int flags)
+{
+	return iot_open(IOT_SPACE_IO, NULL, flags);
+}
+
+struct iot_handle *
+iot_msr_open(int cpu, int flags)
+{
+	unsigned int dev[] = { cpu };
+	return iot_open(IOT_SPACE_MSR, dev, flags);
+}
+
+struct iot_handle *
+iot_smbus_open(int adapter, int address)
+{
+	unsigned int dev[] = { adapter, address };
+	return iot_open(IOT_SPACE_SMBUS, dev, IOT_RDWR);
+}
+
+struct iot_handle *
+iot_cmos_open(int flags)
+{
+	return iot_open(IOT_SPACE_CMOS, NULL, flags);
+}
+
+struct iot_handle *
+iot_scom_open(int chip, int flags)
+{
+	unsigned int dev[] = { chip };
+	return iot_open(IOT_SPACE_SCOM, dev, flags);
+}
+
+void
+iot_close(struct iot_handle *h)
+{
+	uint64_t t0 = 0;
+
+	if (h == NULL)
+		return;
+
+	if (lib_stats_timing)
+		t0 = lib_now_ns();
+
+	if (h->sim != NULL) {
+		lib_backends[h->space]->close(h->sim);
+		free(h->sim);
+	}
+	lib_backends[h->space]->close(h);
+	free(h);
+
+	if (lib_stats_timing)
+		LIB_COUNT(lib_stats.close_ns, lib_now_ns() - t0);
+}
+
+static int
+check_width(const struct iot_handle *h, int width)
+{
+	const struct iot_space_info *info = &lib_backends[h->space]->info;
+
+	if ((width != 8 && width != 16 && width != 32 && width != 64) ||
+	    width < info->min_width || width > info->max_width) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/* Account an access that started at t0, when map_ns0 worth of mapping time
+ * had been accounted. Mapping done by the access is not counted twice. */
+static void
+account_access(uint64_t t0, uint64_t map_ns0)
+{
+	uint64_t elapsed = lib_now_ns() - t0;
+	uint64_t mapping = LIB_STAT(lib_stats.map_ns) - map_ns0;
+
+	LIB_COUNT(lib_stats.access_ns,
+	          elapsed > mapping ? elapsed - mapping : 0);
+}
+
+/* Clear the clear on read bits of a stand-in register that was read. */
+static int
+sim_read(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	const struct lib_sim_reg *reg = lib_sim_find(h, addr, width);
+
+	if (reg == NULL || !(value & reg->rc))
+		return 0;
+	return lib_backends[h->space]->write(h->sim, addr, width,
+	                                     value & ~reg->rc);
+}
+
+/* Write a stand-in register: ones written to its w1c bits clear them, and
+ * its sc bits are clear again once the write has been performed. */
+static int
+sim_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	const struct lib_sim_reg *reg = lib_sim_find(h, addr, width);
+	const struct lib_backend *b = lib_backends[h->space];
+	uint64_t old;
+
+	if (reg == NULL)
+		return b->write(h, addr, width, value);
+
+	if (reg->w1c) {
+		if (b->read(h->sim, addr, width, &old) < 0)
+			return -1;
+		value = (value & ~reg->w1c) | (old & reg->w1c & ~value);
+	}
+	if (b->write(h, addr, width, value) < 0)
+		return -1;
+	if (value & reg->sc)
+		return b->write(h->sim, addr, width, value & ~reg->sc);
+	return 0;
+}
+
+int
+iot_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value)
+{
+	uint64_t t0 = 0, map_ns0 = 0;
+	int r;
+
+	if (check_width(h, width) < 0)
+		return -1;
+
+	if (lib_stats_timing) {
+		map_ns0 = LIB_STAT(lib_stats.map_ns);
+		t0 = lib_now_ns();
+	}
+	r = lib_backends[h->space]->read(h, addr, width, value);
+	if (r == 0 && h->sim != NULL)
+		r = sim_read(h, addr, width, *value);
+	if (lib_stats_timing)
+		account_access(t0, map_ns0);
+	if (r == 0)
+		LIB_COUNT(lib_stats.reads[h->space], 1);
+	if (lib_trace)
+		lib_trace_access(h, r ? IOT_TRACE_FAILED : 0, addr, width,
+		                 r ? 0 : *value);
+
+	return r;
+}
+
+int
+iot_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value)
+{
+	uint64_t t0 = 0, map_ns0 = 0;
+	int r;
+
+	if (check_width(h, width) < 0)
+		return -1;
+	if (!(h->flags & IOT_RDWR)) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if (lib_stats_timing) {
+		map_ns0 = LIB_STAT(lib_stats.map_ns);
+		t0 = lib_now_ns();
+	}
+	if (h->sim != NULL)
+		r = sim_write(h, addr, width, value);
+	else
+		r = lib_backends[h->space]->write(h, addr, width, value);
+	if (lib_stats_timing)
+		account_access(t0, map_ns0);
+	if (r == 0)
+		LIB_COUNT(lib_stats.writes[h->space], 1);
+	if (lib_trace)
+		lib_trace_access(h, IOT_TRACE_WRITE | (r ? IOT_TRACE_FAILED : 0),
+		                 addr, width, value);
+
+	return r;
+}
+
+/* Hand a whole vector to the backend. Returns 1 without doing anything if
+ * some width is invalid, the caller then falls back to single accesses so
+ * that every element gets its status. */
+static int
+backend_vector(struct iot_handle *h, struct iot_access *acc, int n,
+               int (*fn)(struct iot_handle *, struct iot_access *, int),
+               uint64_t *counter, int trace_flags)
+{
+	uint64_t t0 = 0, map_ns0 = 0;
+	int i, r;
+
+	for (i = 0; i < n; i++) {
+		if (check_width(h, acc[i].width) < 0)
+			return 1;
+	}
+
+	if (lib_stats_timing) {
+		map_ns0 = LIB_STAT(lib_stats.map_ns);
+		t0 = lib_now_ns();
+	}
+	r = fn(h, acc, n);
+	if (lib_stats_timing)
+		account_access(t0, map_ns0);
+	for (i = 0; i < n; i++) {
+		if (acc[i].status == 0)
+			LIB_COUNT(*counter, 1);
+		if (lib_trace)
+			lib_trace_access(h, trace_flags |
+			                 (acc[i].status ? IOT_TRACE_FAILED : 0),
+			                 acc[i].addr, acc[i].width,
+			                 acc[i].value);
+	}
+
+	return r;
+}
+
+int
+iot_readv(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	const struct lib_backend *b = lib_backends[h->space];
+	int first_errno = 0;
+	int i, r;
+
+	if (b->readv != NULL && h->sim == NULL) {
+		r = backend_vector(h, acc, n, b->readv,
+		                   &lib_stats.reads[h->space], 0);
+		if (r <= 0)
+			return r;
+	}
+
+	for (i = 0; i < n; i++) {
+		acc[i].status = 0;
+		if (iot_read(h, acc[i].addr, acc[i].width, &acc[i].value) < 0) {
+			acc[i].status = -errno;
+			if (!first_errno)
+				first_errno = errno;
+		}
+	}
+
+	if (first_errno) {
+		errno = first_errno;
+		return -1;
+	}
+	return 0;
+}
+
+int
+iot_writev(struct iot_handle *h, struct iot_access *acc, int n)
+{
+	const struct lib_backend *b = lib_backends[h->space];
+	int first_errno = 0;
+	int i, r;
+
+	if (b->writev != NULL && (h->flags & IOT_RDWR) && h->sim == NULL) {
+		r = backend_vector(h, acc, n, b->writev,
+		                   &lib_stats.writes[h->space],
+		                   IOT_TRACE_WRITE);
+		if (r <= 0)
+			return r;
+	}
+
+	for (i = 0; i < n; i++) {
+		acc[i].status = 0;
+		if (iot_write(h, acc[i].addr, acc[i].width, acc[i].value) < 0) {
+			acc[i].status = -errno;
+			if (!first_errno)
+				first_errno = errno;
+		}
+	}
+
+	if (first_errno) {
+		errno = first_errno;
+		return -1;
+	}
+	return 0;
+}
+
+int
+lib_file_pread(int fd, uint64_t pos, int width, uint64_t *value)
+{
+	union {
+		uint8_t u8;
+		uint16_t u16;
+		uint32_t u32;
+		uint64_t u64;
+	} data;
+	ssize_t r;
+
+	r = pread(fd, &data, width / 8, pos);
+	if (r != width / 8) {
+		if (r >= 0)
+			errno = EIO;
+		return -1;
+	}
+
+	switch (width) {
+	case 8:  *value = data.u8; break;
+	case 16: *value = le_to_host_16(data.u16); break;
+	case 32: *value = le_to_host_32(data.u32); break;
+	default: *value = le_to_host_64(data.u64); break;
+	}
+	return 0;
+}
+
+int
+lib_file_read(int fd, uint64_t pos, int width, uint64_t *value)
+{
+	LIB_SYSCALLS(1);
+	return lib_file_pread(fd, pos, width, value);
+}
+
+int
+lib_file_write(int fd, uint64_t pos, int width, uint64_t value)
+{
+	union {
+		uint8_t u8;
+		uint16_t u16;
+		uint32_t u32;
+		uint64_t u64;
+	} data;
+	ssize_t r;
+
+	switch (width) {
+	case 8:  data.u8 = value; break;
+	case 16: data.u16 = host_to_le_16((uint16_t)value); break;
+	case 32: data.u32 = host_to_le_32((uint32_t)value); break;
+	default: data.u64 = host_to_le_64(value); break;
+	}
+
+	LIB_SYSCALLS(1);
+	r = pwrite(fd, &data, width / 8, pos);
+	if (r != width / 8) {
+		if (r >= 0)
+			errno = EIO;
+		return -1;
+	}
+	return 0;
+}
+
+uint64_t
+lib_get_reg(const uint8_t *buf, int width)
+{
+	uint64_t value = 0;
+	int i;
+
+	if (width == 64) {
+		memcpy(&value, buf, sizeof(value));
+		return le_to_host_64(value);
+	}
+	for (i = width / 8 - 1; i >= 0; i--)
+		value = (value << 8) | buf[i];
+	return value;
+}
+
+int
+lib_file_pos(const struct iot_handle *h, uint64_t addr, uint64_t *pos)
+{
+	*pos = addr;
+	return 0;
+}
+
+/* Return value of a vectored access whose elements have their status. */
+static int
+vector_result(const struct iot_access *acc, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (acc[i].status) {
+			errno = -acc[i].status;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int
+lib_file_readv(int fd, uint64_t base, struct iot_access *acc, int n)
+{
+	struct lib_pread ops[LIB_ENGINE_CHUNK];
+	uint8_t buf[LIB_MAX_COALESCE];
+	uint64_t start, end;
+	int nops = 0;
+	ssize_t r;
+	int i, j, k;
+
+	for (i = 0; i < n; i = j) {
+		j = i + 1;
+		if (acc[i].addr < base) {
+			acc[i].status = -EINVAL;
+			continue;
+		}
+
+		/* Extend the run while accesses continue where the previous
+		 * one ended. */
+		start = acc[i].addr - base;
+		end = start + acc[i].width / 8;
+		for (; j < n; j++) {
+			if (acc[j].addr < base || acc[j].addr - base != end ||
+			    end + acc[j].width / 8 - start > sizeof(buf))
+				break;
+			end += acc[j].width / 8;
+		}
+
+		if (j - i > 1) {
+			/* Keep the reads in order. */
+			lib_engine_read(ops, nops);
+			nops = 0;
+
+			LIB_SYSCALLS(1);
+			r = pread(fd, buf, end - start, start);
+			if (r == end - start) {
+				for (k = i; k < j; k++) {
+					acc[k].value = lib_get_reg(
+						&buf[acc[k].addr - base - start],
+						acc[k].width);
+					acc[k].status = 0;
+				}
+				continue;
+			}
+			/* Fall back to single reads so that every access
+			 * gets its own status. */
+		}
+
+		/* Single reads are left to the batch engine. */
+		for (k = i; k < j; k++) {
+			if (nops == LIB_ENGINE_CHUNK) {
+				lib_engine_read(ops, nops);
+				nops = 0;
+			}
+			ops[nops].fd = fd;
+			ops[nops].pos = acc[k].addr - base;
+			ops[nops].width = acc[k].width;
+			ops[nops].acc = &acc[k];
+			nops++;
+		}
+	}
+	lib_engine_read(ops, nops);
+
+	return vector_result(acc, n);
+}
+
+/* Hand the file backed reads of a batch to the engine. Other reads are left
+ * with a status of 1. */
+static int
+engine_batch(struct iot_handle *const *h, struct iot_access *acc, int n,
+             struct lib_pread *ops)
+{
+	const struct lib_backend *b;
+	int nops = 0, i;
+
+	for (i = 0; i < n; i++) {
+		b = lib_backends[h[i]->space];
+		if (b->file_pos == NULL || h[i]->sim != NULL) {
+			acc[i].status = 1;
+			continue;
+		}
+		if (check_width(h[i], acc[i].width) < 0 ||
+		    b->file_pos(h[i], acc[i].addr, &ops[nops].pos) < 0) {
+			acc[i].status = -errno;
+			continue;
+		}
+		ops[nops].fd = h[i]->fd;
+		ops[nops].width = acc[i].width;
+		ops[nops].acc = &acc[i];
+		nops++;
+	}
+	return nops;
+}
+
+int
+iot_read_batch(struct iot_handle *const *h, struct iot_access *acc, int n)
+{
+	struct lib_pread ops[LIB_ENGINE_CHUNK];
+	uint64_t t0 = 0, map_ns0 = 0;
+	struct iot_access *a;
+	int chunk, nops, i, k;
+
+	for (i = 0; i < n; i += chunk) {
+		chunk = (n - i < LIB_ENGINE_CHUNK) ? n - i : LIB_ENGINE_CHUNK;
+		nops = engine_batch(&h[i], &acc[i], chunk, ops);
+
+		if (lib_stats_timing) {
+			map_ns0 = LIB_STAT(lib_stats.map_ns);
+			t0 = lib_now_ns();
+		}
+		lib_engine_read(ops, nops);
+		if (lib_stats_timing)
+			account_access(t0, map_ns0);
+
+		for (k = i; k < i + chunk; k++) {
+			a = &acc[k];
+			if (a->status == 1) {
+				a->status = 0;
+				if (iot_read(h[k], a->addr, a->width,
+				             &a->value) < 0)
+					a->status = -errno;
+				continue;
+			}
+			if (a->status == 0)
+				LIB_COUNT(lib_stats.reads[h[k]->space], 1);
+			if (lib_trace)
+				lib_trace_access(h[k], a->status ?
+				                 IOT_TRACE_FAILED : 0, a->addr,
+				                 a->width, a->value);
+		}
+	}
+
+	return vector_result(acc, n);
+}
+
+int
+iot_file_read_batch(const int *fd, struct iot_access *acc, int n)
+{
+	struct lib_pread ops[LIB_ENGINE_CHUNK];
+	int chunk, nops, w, i, k;
+
+	for (i = 0; i < n; i += chunk) {
+		chunk = (n - i < LIB_ENGINE_CHUNK) ? n - i : LIB_ENGINE_CHUNK;
+		for (nops = 0, k = i; k < i + chunk; k++) {
+			w = acc[k].width;
+			if (w != 8 && w != 16 && w != 32 && w != 64) {
+				acc[k].status = -EINVAL;
+				continue;
+			}
+			ops[nops].fd = fd[k];
+			ops[nops].pos = acc[k].addr;
+			ops[nops].width = w;
+			ops[nops].acc = &acc[k];
+			nops++;
+		}
+		lib_engine_read(ops, nops);
+	}
+
+	return vector_result(acc, n);
+}
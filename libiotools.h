@@ -0,0 +1,272 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _LIBIOTOOLS_H_
+#define _LIBIOTOOLS_H_
+
+/*
+ * libiotools: handle based register access.
+ *
+ * A handle names a device within an address space (a PCI function, a CPU's
+ * MSRs, an i2c slave, ...). Registers are then accessed by address within
+ * that device and access width in bits. Handles are opened once and can be
+ * used for any number of accesses.
+ *
+ * Unless stated otherwise, functions return 0 on success and -1 with errno
+ * set on failure; the library never prints. A handle must not be used by
+ * more than one thread at a time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum iot_space {
+	IOT_SPACE_PCI,    /* dev: segment, bus, device, function */
+	IOT_SPACE_MMIO,   /* uncached physical memory */
+	IOT_SPACE_MEM,    /* cached physical memory */
+	IOT_SPACE_IO,     /* IO ports */
+	IOT_SPACE_MSR,    /* dev: cpu */
+	IOT_SPACE_SMBUS,  /* dev: adapter, slave address */
+	IOT_SPACE_CMOS,
+	IOT_SPACE_SCOM,   /* dev: chip id */
+	IOT_SPACE_MAX,
+};
+
+#define IOT_MAX_DEV_ARGS 4
+
+/* CMOS indexes below this hold the RTC and are not accessible. */
+#define IOT_CMOS_MIN_ADDR 14
+
+/* Address space capabilities. */
+#define IOT_CAP_MMAP  0x1  /* iot_map() is supported */
+#define IOT_CAP_PREAD 0x2  /* accesses are positioned reads/writes of iot_fd() */
+
+struct iot_space_info {
+	const char *name;
+	int ndev;       /* number of device selector values */
+	int min_width;  /* supported access widths, in bits */
+	int max_width;
+	int caps;       /* IOT_CAP_* */
+};
+
+/* Open flags. */
+#define IOT_RDONLY 0x0
+#define IOT_RDWR   0x1
+
+struct iot_handle;
+
+/* One element of a vectored access. */
+struct iot_access {
+	uint64_t addr;
+	uint64_t value;  /* read result, or value to write */
+	int width;       /* in bits */
+	int status;      /* 0 or negative errno, set by the library */
+};
+
+struct iot_handle *iot_open(enum iot_space space, const unsigned int *dev,
+                            int flags);
+struct iot_handle *iot_pci_open(int segment, int bus, int device,
+                                int function, int flags);
+struct iot_handle *iot_mmio_open(int cached, int flags);
+struct iot_handle *iot_io_open(int flags);
+struct iot_handle *iot_msr_open(int cpu, int flags);
+struct iot_handle *iot_smbus_open(int adapter, int address);
+struct iot_handle *iot_cmos_open(int flags);
+struct iot_handle *iot_scom_open(int chip, int flags);
+void iot_close(struct iot_handle *h);
+
+int iot_read(struct iot_handle *h, uint64_t addr, int width, uint64_t *value);
+int iot_write(struct iot_handle *h, uint64_t addr, int width, uint64_t value);
+
+/* Perform n accesses on one handle. Every element gets its status set; the
+ * call fails if any element failed. */
+int iot_readv(struct iot_handle *h, struct iot_access *acc, int n);
+int iot_writev(struct iot_handle *h, struct iot_access *acc, int n);
+
+/*
+ * Reads across many handles: acc[i] is read through h[i]. Accesses that are
+ * positioned reads of a device file (PCI, MSR, CMOS, SCOM) are handed to the
+ * batch engine, which keeps many of them in flight at once; the others are
+ * performed one at a time. Every element gets its status set; the call fails
+ * if any element failed. Handles are not used by more than one thread, but
+ * the engine may read their files from several.
+ */
+int iot_read_batch(struct iot_handle *const *h, struct iot_access *acc, int n);
+
+enum iot_engine {
+	IOT_ENGINE_AUTO,     /* io_uring for larger batches, else threads */
+	IOT_ENGINE_SYNC,     /* one pread() after the other */
+	IOT_ENGINE_URING,    /* io_uring submission and completion rings */
+	IOT_ENGINE_THREADS,  /* a pool of threads issuing pread() */
+	IOT_ENGINE_MAX,
+};
+
+/* Select the batch engine for the whole process. Selecting io_uring fails
+ * with errno set if the kernel does not provide it. */
+int iot_set_engine(enum iot_engine engine);
+enum iot_engine iot_get_engine(void);
+/* NULL if engine is not a valid engine. */
+const char *iot_engine_name(enum iot_engine engine);
+
+/* The batch engine applied to plain files: acc[i].addr is the offset of a
+ * little endian register in fd[i]. Regular files can thus stand in for
+ * devices when measuring the engines. */
+int iot_file_read_batch(const int *fd, struct iot_access *acc, int n);
+
+/* MMIO/MEM handles only: map [addr, addr + len) and return a pointer to addr.
+ * The pointer stays valid until the next access or mapping on the handle.
+ * Handles keep their mappings, so a region is mapped once however often it
+ * is accessed; keep handles open to benefit. */
+volatile void *iot_map(struct iot_handle *h, uint64_t addr, size_t len);
+
+/* The underlying file descriptor, for transactions the library does not
+ * model (SMBus block and process calls). -1 if there is none. */
+int iot_fd(const struct iot_handle *h);
+
+/* Copy the device selector the handle was opened with into dev, which must
+ * have room for IOT_MAX_DEV_ARGS entries. Returns the number of entries. */
+int iot_dev(const struct iot_handle *h, unsigned int *dev);
+
+enum iot_space iot_space(const struct iot_handle *h);
+const char *iot_space_name(enum iot_space space);
+/* NULL if space is not a valid address space. */
+const struct iot_space_info *iot_space_info(enum iot_space space);
+
+/*
+ * Look for device files below root instead of /, where a tree of regular
+ * files laid out like the real one (sys/bus/pci/devices/.../config,
+ * dev/cpu/N/msr, dev/mem, dev/nvram, ...) stands in for the hardware. NULL
+ * or "/" selects the real devices again. Affects handles opened later.
+ *
+ * A regular file dev/i2c-N models an SMBus adapter: the 256 registers of
+ * slave address a are the bytes at a * 256, and slaves beyond the end of the
+ * file do not answer. A file named "effects" at the top of the tree may give
+ * registers side effects, such as bits that clear on read; see lib_sim.c.
+ * Accesses of such registers are performed one at a time, and accesses
+ * through iot_map() have no side effects. Fails with EINVAL if the effects
+ * can't be parsed.
+ */
+int iot_set_root(const char *root);
+/* The root set with iot_set_root(), "" for the real devices. */
+const char *iot_get_root(void);
+
+/*
+ * Obtain device files from the iotools broker listening on the unix socket
+ * path, see broker.h, instead of opening them. This lets unprivileged
+ * processes access the MSRs, PCI config spaces, PCI BARs and i2c adapters
+ * the broker's policy grants them, at the speed of a local open file. MMIO
+ * and MEM handles then map the resource file of the PCI BAR that holds the
+ * address and cannot reach other physical memory; IO, CMOS and SCOM are not
+ * available. NULL disconnects. Affects handles opened later.
+ */
+int iot_set_broker(const char *path);
+/* The broker socket in use, "" if there is none. */
+const char *iot_get_broker(void);
+
+/* ioctl() for the i2c-dev file descriptor of an SMBus handle. On a modelled
+ * adapter the I2C_SLAVE, I2C_SLAVE_FORCE, I2C_SMBUS and I2C_RDWR requests
+ * are carried out on the model. */
+int iot_i2c_ioctl(int fd, unsigned long request, void *arg);
+
+/*
+ * Library wide counters. Transactions and system calls are always counted;
+ * time spent in each phase is only measured after iot_stats_timing(1).
+ * Each counter is updated atomically, so threads may share handles and the
+ * library, but iot_stats_get() reads them one by one rather than as a
+ * consistent snapshot.
+ */
+struct iot_stats {
+	uint64_t reads[IOT_SPACE_MAX];   /* hardware read transactions */
+	uint64_t writes[IOT_SPACE_MAX];  /* hardware write transactions */
+	uint64_t syscalls;
+	uint64_t opens;
+	uint64_t maps;
+	uint64_t open_ns;    /* opening handles */
+	uint64_t map_ns;     /* setting up /dev/mem mappings */
+	uint64_t access_ns;  /* register accesses, excluding mapping */
+	uint64_t close_ns;   /* closing handles */
+};
+
+void iot_stats_timing(int enable);
+void iot_stats_get(struct iot_stats *stats);
+void iot_stats_reset(void);
+
+/*
+ * Access tracing. While a trace is active every hardware access made through
+ * the library, and every read through a mapping that the caller reports with
+ * iot_trace_mapped(), is appended to the trace file, which is a fixed size
+ * ring:
+ * once full, the oldest records are overwritten. Any number of processes
+ * may record into the same file at once. The file holds a struct
+ * iot_trace_header followed by capacity records; record n (counting from 0
+ * across all writers) lives in slot n % capacity.
+ */
+#define IOT_TRACE_MAGIC "IOTTRACE"
+#define IOT_TRACE_VERSION 1
+
+struct iot_trace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;     /* records */
+	uint64_t written;      /* records appended since the file was created */
+	/* Two (timestamp, CLOCK_MONOTONIC_RAW ns) pairs that relate record
+	 * timestamps to time: when the file was created and when a writer
+	 * last stopped. */
+	uint64_t start_ticks;
+	uint64_t start_ns;
+	uint64_t end_ticks;
+	uint64_t end_ns;
+};
+
+/* Record flags. */
+#define IOT_TRACE_WRITE  0x1
+#define IOT_TRACE_FAILED 0x2
+
+struct iot_trace_record {
+	uint64_t ticks;      /* TSC on x86, CLOCK_MONOTONIC_RAW ns elsewhere */
+	uint64_t addr;
+	uint64_t value;      /* read or written */
+	uint16_t dev[IOT_MAX_DEV_ARGS];
+	uint8_t space;       /* enum iot_space */
+	uint8_t width;
+	uint8_t flags;       /* IOT_TRACE_* */
+	uint8_t reserved[5];
+};
+
+/* Start recording into path. An existing trace with a matching layout is
+ * appended to; otherwise the file is (re)created with room for capacity
+ * records, or a default size if capacity is 0. */
+int iot_trace_start(const char *path, uint64_t capacity);
+void iot_trace_stop(void);
+/* Record n reads of width bits at addr that the caller made itself through
+ * a mapping from iot_map(), with the values as they were copied into data.
+ * Values wider than 64 bits are recorded as 64 bit pieces. Nothing is
+ * recorded unless a trace is active. */
+void iot_trace_mapped(const struct iot_handle *h, uint64_t addr, int width,
+                      const void *data, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LIBIOTOOLS_H_ */
@@ -30,6 +30,11 @@
 #define inline
 #endif
 
+/* The ioctl() that performs SMBus transactions, see iot_i2c_ioctl(). */
+#ifndef I2C_IOCTL
+#define I2C_IOCTL ioctl
+#endif
+
 /* -- i2c.h -- */
 
 
@@ -204,7 +209,7 @@ static inline __s32 i2c_smbus_access(int file, char read_write, __u8 command,
 	args.command = command;
 	args.size = size;
 	args.data = data;
-	return ioctl(file,I2C_SMBUS,&args);
+	return I2C_IOCTL(file,I2C_SMBUS,&args);
 }
 
 
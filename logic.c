@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <limits.h>
 #include "commands.h"
+#include "output.h"
 
 typedef enum {
 	OR_OP,
@@ -81,7 +82,8 @@ logic_op(int argc, const char *argv[], const struct cmd_info *info)
 		argc--; argv++;
 	}
 
-	printf("0x%llx\n", result);
+	output_hex(result, 0, 0);
+	output_char('\n');
 
 	return rc;
 }
@@ -94,7 +96,8 @@ not(int argc, const char *argv[], const struct cmd_info *info)
 	result = strtoull(argv[1], NULL, 0);
 	result = ~result;
 
-	printf("0x%llx\n", result);
+	output_hex(result, 0, 0);
+	output_char('\n');
 
 	return (result == 0);
 }
@@ -120,7 +123,8 @@ shift(int argc, const char *argv[], const struct cmd_info *info)
 		fprintf(stderr, "Invalid shift operation\n");
 		return -1;
 	}
-	printf("0x%llx\n", val);
+	output_hex(val, 0, 0);
+	output_char('\n');
 
 	return 0;
 }
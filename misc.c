@@ -31,7 +31,9 @@
 #include <unistd.h>
 #include <sched.h>
 #include "commands.h"
+#include "output.h"
 #include "platform.h"
+#include "simd.h"
 
 /*
  * There is a chance that we don't have cpu_set_t available to us, like
@@ -111,7 +113,9 @@ busy_loop(int argc, const char *argv[], const struct cmd_info *info)
 			elapsed = (t1.tv_sec - t0.tv_sec)*1000000;
 			elapsed += t1.tv_usec - t0.tv_usec;
 			if (elapsed >= 1000000) {
-				printf("%llu\n", count);
+				output_dec(count);
+				output_char('\n');
+				output_flush();
 				gettimeofday(&t0, NULL);
 				count = 0;
 				if (reps != -1) {
@@ -126,19 +130,11 @@ busy_loop(int argc, const char *argv[], const struct cmd_info *info)
 
 #ifdef ARCH_X86
 
-#define rdtscll(val) do { \
-	uint32_t __a, __d; \
-	__asm__ __volatile__("rdtsc" : "=a" (__a), "=d" (__d)); \
-	(val) = ((uint64_t)__a) | (((uint64_t)__d)<<32); \
-} while(0)
-
 static int
 rdtsc(int argc, const char *argv[], const struct cmd_info *info)
 {
-	unsigned long long tsc;
-
-	rdtscll(tsc);
-	printf("0x%016llx\n", tsc);
+	output_hex(read_ticks(), 16, 0);
+	output_char('\n');
 
 	return 0;
 }
@@ -151,27 +147,7 @@ cpuid_inline(int cpu, int function, int index, uint32_t *data)
 		return -1;
 	}
 
-	asm volatile (
-#if defined(__i386__) && defined(__PIC__)
-	      /* We can't use %ebx on 32 bit builds with PIC.
-	       *
-	       * The need for this is, IMO, a bug in GCC.  We should not
-	       * need to know what registers it is using internally.  It
-	       * should be saving and restoring them itself.
-	       */
-	      "xchg %%ebx, %%esi;" /* save ebx in esi */
-	      "cpuid;"
-	      "xchg %%esi, %%ebx;" /* restore ebx, data moves to esi */
-	      : "=a" (data[0]), "=S" (data[1]), "=c" (data[2]), "=d" (data[3])
-	      : "0" (function), "2" (index)
-	      : "memory"
-#else
-	      "cpuid;"
-	      : "=a" (data[0]), "=b" (data[1]), "=c" (data[2]), "=d" (data[3])
-	      : "0" (function), "2" (index)
-	      : "memory"
-#endif
-	);
+	cpuid_count(function, index, data);
 
 	return 0;
 }
@@ -183,6 +159,7 @@ cpuid(int argc, const char *argv[], const struct cmd_info *info)
 	unsigned long index;
 	int cpu;
 	uint32_t data[4];
+	int i;
 
 	cpu = strtol(argv[1], NULL, 0);
 	function = strtoul(argv[2], NULL, 0);
@@ -196,14 +173,30 @@ cpuid(int argc, const char *argv[], const struct cmd_info *info)
 		return -1;
 	}
 
-	printf("0x%08x 0x%08x 0x%08x 0x%08x\n",
-	       data[0], data[1], data[2], data[3]);
+	for (i = 0; i < 4; i++) {
+		output_hex(data[i], 8, 0);
+		output_char(i == 3 ? '\n' : ' ');
+	}
 
 	return 0;
 }
 
 #endif /* #ifdef ARCH_X86 */
 
+/* The vector levels the CPU supports; the one in use is marked. */
+static int
+simd_info(int argc, const char *argv[], const struct cmd_info *info)
+{
+	enum simd_level level;
+
+	for (level = 0; level <= simd_detected(); level++) {
+		output_str(simd_level_name(level));
+		output_str(level == simd_selected() ? " *\n" : "\n");
+	}
+
+	return 0;
+}
+
 static int
 cpu_list(int argc, const char *argv[], const struct cmd_info *info)
 {
@@ -212,7 +205,8 @@ cpu_list(int argc, const char *argv[], const struct cmd_info *info)
 	int i;
 
 	for (i = 0; i < ncpus; i++) {
-		printf("%d\n", i);
+		output_dec(i);
+		output_char('\n');
 	}
 	return 0;
 #else /* ifdef _SC_NPROCESSORS_ONLN */
@@ -268,6 +262,7 @@ static const struct cmd_info misc_cmds[] = {
 #endif /* #ifdef ARCH_X86 */
 	MAKE_CMD(busy_loop, &busy_loop, NULL),
 	MAKE_CMD(cpu_list, cpu_list, NULL),
+	MAKE_CMD(simd_info, simd_info, NULL),
 	MAKE_CMD_WITH_PARAMS(runon, &runon, NULL, &runon_params),
 };
 
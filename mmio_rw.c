@@ -28,269 +28,355 @@
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
-#include <sys/mman.h>
 #include "commands.h"
+#include "output.h"
+#include "simd.h"
 
-struct mmap_info {
-	int fd;
-	volatile void *mem;
-	int off;
-	size_t pgsize;
-	size_t length;
-	uint64_t addr;
-};
+/* Device memory is copied out CHUNK_SIZE bytes at a time, a multiple of
+ * every line of dump output, before anything looks at it. mmio_find keeps
+ * up to MAX_PATTERN - 1 bytes of the previous chunk in front. */
+#define CHUNK_SIZE 16384
+#define MAX_PATTERN 256
 
-struct mmap_file_flags {
-	int flags;
-};
+static uint8_t chunk[MAX_PATTERN + CHUNK_SIZE] __attribute__((aligned(64)));
+
+/* Copy len bytes of device memory at addr, mapped at src, with loads of
+ * width bits, the bytes past the last whole value one by one. Unlike
+ * memcpy() or the vector kernels, this neither widens, merges nor drops
+ * loads. The loads are traced like any other access. */
+static void
+read_region(const struct iot_handle *h, uint64_t addr, uint8_t *dst,
+            const volatile uint8_t *src, size_t len, int width)
+{
+	size_t values = len / (width / 8), i;
+
+	simd_load_io(dst, src, values, width);
+	for (i = values * (width / 8); i < len; i++) {
+		dst[i] = src[i];
+	}
+	iot_trace_mapped(h, addr, width, dst, values);
+	iot_trace_mapped(h, addr + values * (width / 8), 8,
+	                 dst + values * (width / 8), len - values * (width / 8));
+}
 
-/* open /dev/mem and mmap the address specified in mmap_addr. return 1 on
- * success, 0 on failure. */
 static int
-open_mapping(struct mmap_info *mmap_addr, int flags, unsigned bytes)
+mmio_dump(int argc, const char *argv[], const struct cmd_info *info)
 {
-	int prot;
+	unsigned long bytes_to_dump;
+	unsigned long bytes_left;
+	struct iot_handle *h;
+	volatile void *mem;
+	volatile uint8_t *addr;
+	uint64_t desired_addr;
+	size_t len;
+	int write_binary;
+	int width, width_given, arg;
+	char *end;
 
-	/* align addr */
-	mmap_addr->pgsize = getpagesize();
-	mmap_addr->off = mmap_addr->addr & (mmap_addr->pgsize - 1);
-	mmap_addr->addr &= ~ ((uint64_t)mmap_addr->pgsize - 1);
+	desired_addr = strtoull(argv[1], NULL, 0);
+	bytes_to_dump = strtoul(argv[2], NULL, 0);
 
-	mmap_addr->fd = open("/dev/mem", flags);
-	if (mmap_addr->fd < 0) {
-		fprintf(stderr, "open(/dev/mem): %s\n", strerror(errno));
+	width = 32;
+	width_given = 0;
+	write_binary = 0;
+	for (arg = 3; arg < argc; arg++) {
+		if (!strcmp(argv[arg], "-b")) {
+			write_binary = 1;
+		} else if (!strcmp(argv[arg], "--width") && arg + 1 < argc) {
+			width = strtol(argv[++arg], &end, 0);
+			if (*end != '\0' ||
+			    simd_load_isa(width) == NULL) {
+				fprintf(stderr, "bad width '%s'\n", argv[arg]);
+				return -1;
+			}
+			width_given = 1;
+		} else {
+			fprintf(stderr, "usage: %s %s\n", argv[0],
+			        info->params->usage);
+			return -1;
+		}
+	}
+	/* Without --width, a trailing partial value is read byte by byte as
+	 * it always was. */
+	if (width_given && (desired_addr % (width / 8) ||
+	                    bytes_to_dump % (width / 8))) {
+		fprintf(stderr, "%s: --width %d needs an address and length "
+		        "that are multiples of %d\n", argv[0], width, width / 8);
+		fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
 		return -1;
 	}
-
-	prot = 0;
-	if ((flags&O_ACCMODE) == O_RDWR) {
-		prot = PROT_READ | PROT_WRITE;
-	} else if ((flags & O_ACCMODE) == O_RDONLY) {
-		prot = PROT_READ;
-	} else if  ((flags & O_ACCMODE) == O_WRONLY) {
-		prot = PROT_WRITE;
+	if (!simd_load_supported(width)) {
+		fprintf(stderr, "%d bit loads need %s, which this CPU lacks\n",
+		        width, simd_load_isa(width));
+		return -1;
 	}
 
-	/* The length is comprised of the bytes requested including the partial
-	 * number of bytes that do not make up a full page. */
-	mmap_addr->length = bytes + mmap_addr->off;
-
-	mmap_addr->mem = mmap(NULL, mmap_addr->length, prot, MAP_SHARED,
-	           mmap_addr->fd, mmap_addr->addr);
+	h = backend_open(info->privdata, NULL, IOT_RDONLY);
+	if (h == NULL) {
+		return -1;
+	}
 
-	if (!mmap_addr->mem || mmap_addr->mem == MAP_FAILED) {
+	mem = iot_map(h, desired_addr, bytes_to_dump);
+	if (mem == NULL) {
 		fprintf(stderr, "mmap(/dev/mem): %s\n", strerror(errno));
-		close(mmap_addr->fd);
+		put_handle(h);
 		return -1;
 	}
 
+	/* Read the device a value at a time with loads of the given width,
+	 * then format whole chunks. The trailing bytes are read one by
+	 * one. */
+	addr = mem;
+	bytes_left = bytes_to_dump;
+	while (bytes_left) {
+		len = (bytes_left < CHUNK_SIZE) ? bytes_left : CHUNK_SIZE;
+		read_region(h, desired_addr, chunk, addr, len, width);
+
+		if (write_binary) {
+			output_raw(chunk, len);
+		} else {
+			output_dump(h, desired_addr, chunk, len, width);
+		}
+		addr += len;
+		bytes_left -= len;
+		desired_addr += len;
+	}
+
+	put_handle(h);
+
 	return 0;
 }
 
-static void
-close_mapping(struct mmap_info *mmap_addr)
+/* Map the <addr> <num_bytes> region given in argv[1] and argv[2]. */
+static volatile void *
+map_region(const struct cmd_info *info, const char *argv[],
+           struct iot_handle **h, uint64_t *addr, unsigned long *len)
 {
-	munmap((void *)mmap_addr->mem, mmap_addr->length);
-	close(mmap_addr->fd);
+	volatile void *mem;
+
+	*addr = strtoull(argv[1], NULL, 0);
+	*len = strtoul(argv[2], NULL, 0);
+
+	*h = backend_open(info->privdata, NULL, IOT_RDONLY);
+	if (*h == NULL) {
+		return NULL;
+	}
+
+	mem = iot_map(*h, *addr, *len);
+	if (mem == NULL) {
+		fprintf(stderr, "mmap(/dev/mem): %s\n", strerror(errno));
+		put_handle(*h);
+	}
+	return mem;
 }
 
 static int
-mmio_read_x(int argc, const char *argv[], const struct cmd_info *info)
+hex_digit(char c)
 {
-	int ret;
-	data_store data;
-	struct mmap_info mmap_addr;
-	const struct mmap_file_flags *mmf;
-
-	mmf = info->privdata;
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
 
-	mmap_addr.addr = strtoull(argv[1], NULL, 0);
+/* Bytes written as hex digits, e.g. 55aa or 0x55aa. */
+static int
+parse_pattern(const char *arg, uint8_t *pat, size_t max)
+{
+	size_t n = 0;
+	int hi, lo;
 
-	if (open_mapping(&mmap_addr, O_RDONLY | mmf->flags, sizeof(data)) < 0) {
-		return -1;
+	if (arg[0] == '0' && (arg[1] == 'x' || arg[1] == 'X')) {
+		arg += 2;
 	}
-
-	ret = 0;
-
-	#define DO_READ(mem_, off_, size_)\
-		data.u ##size_ = *(typeof(data.u ##size_) *)(mem_ + off_); \
-		fprintf(stdout, "0x%0*llx\n", (int)sizeof(data.u ##size_)*2, \
-		        (unsigned long long)data.u ##size_)
-
-	switch (get_command_size(info)) {
-	case SIZE8:
-		DO_READ(mmap_addr.mem, mmap_addr.off, 8);
-		break;
-	case SIZE16:
-		DO_READ(mmap_addr.mem, mmap_addr.off, 16);
-		break;
-	case SIZE32:
-		DO_READ(mmap_addr.mem, mmap_addr.off, 32);
-		break;
-	case SIZE64:
-		if (sizeof(void *) != sizeof(uint64_t)) {
-			fprintf(stderr, "warning: 64 bit operations might "
-			        "not be atomic on 32 bit builds\n");
+	while (arg[0] && n < max) {
+		hi = hex_digit(arg[0]);
+		lo = hex_digit(arg[1]);
+		if (hi < 0 || lo < 0) {
+			return -1;
 		}
-		DO_READ(mmap_addr.mem, mmap_addr.off, 64);
-		break;
-	default:
-		fprintf(stderr, "invalid mmio_read parameter\n");
-		ret = -1;
+		pat[n++] = hi << 4 | lo;
+		arg += 2;
 	}
-
-	close_mapping(&mmap_addr);
-
-	return ret;
+	return (arg[0] || n == 0) ? -1 : n;
 }
 
 static int
-mmio_write_x(int argc, const char *argv[], const struct cmd_info *info)
+mmio_find(int argc, const char *argv[], const struct cmd_info *info)
 {
-	int ret;
-	unsigned long ldata;
-	data_store data;
-	struct mmap_info mmap_addr;
+	uint8_t pat[MAX_PATTERN];
+	unsigned long len, done, n;
+	struct iot_handle *h;
+	volatile void *mem;
+	const uint8_t *p;
+	uint64_t addr;
+	size_t keep, have;
+	int patlen;
 
-	mmap_addr.addr = strtoull(argv[1], NULL, 0);
-	ldata = strtoul(argv[2], NULL, 0);
+	patlen = parse_pattern(argv[3], pat, sizeof(pat));
+	if (patlen < 0) {
+		fprintf(stderr, "bad pattern '%s'\n", argv[3]);
+		return -1;
+	}
 
-	if (open_mapping(&mmap_addr, O_RDWR, sizeof(data)) < 0) {
+	mem = map_region(info, argv, &h, &addr, &len);
+	if (mem == NULL) {
 		return -1;
 	}
 
-	ret = 0;
-
-	#define DO_WRITE(mem_, off_, size_)\
-		data.u ##size_ = (typeof(data.u ##size_))ldata;\
-		*(typeof(data.u ##size_) *)(mem_+off_) = data.u ##size_
-
-	switch (get_command_size(info)) {
-	case SIZE8:
-		DO_WRITE(mmap_addr.mem, mmap_addr.off, 8);
-		break;
-	case SIZE16:
-		DO_WRITE(mmap_addr.mem, mmap_addr.off, 16);
-		break;
-	case SIZE32:
-		DO_WRITE(mmap_addr.mem, mmap_addr.off, 32);
-		break;
-	case SIZE64:
-		if (sizeof(void *) != sizeof(uint64_t)) {
-			fprintf(stderr, "warning: 64 bit operations might "
-			        "not be atomic on 32 bit builds\n");
+	/* Every match is printed, overlapping ones included. A match that
+	 * starts in the kept tail of a chunk did not fit in it, so none is
+	 * found twice. */
+	keep = 0;
+	for (done = 0; done < len; done += n) {
+		n = (len - done < CHUNK_SIZE) ? len - done : CHUNK_SIZE;
+		read_region(h, addr + done, chunk + keep,
+		            (const volatile uint8_t *)mem + done, n, 32);
+		have = keep + n;
+		for (p = chunk; (p = simd->find(p, have - (p - chunk), pat,
+		                                patlen)) != NULL; p++) {
+			output_hex(addr + done - keep + (p - chunk), 16, 0);
+			output_char('\n');
 		}
-		DO_WRITE(mmap_addr.mem, mmap_addr.off, 64);
-		break;
-	default:
-		fprintf(stderr, "invalid mmio_write parameter\n");
-		ret = -1;
+		keep = (have < patlen - 1) ? have : patlen - 1;
+		memmove(chunk, chunk + have - keep, keep);
 	}
 
-	close_mapping(&mmap_addr);
+	put_handle(h);
 
-	return ret;
+	return 0;
 }
 
 static int
-mmio_dump(int argc, const char *argv[], const struct cmd_info *info)
+mmio_crc32c(int argc, const char *argv[], const struct cmd_info *info)
 {
-	unsigned long bytes_to_dump;
-	unsigned long bytes_left;
-	struct mmap_info mmap_addr;
-	uint32_t *addr;
-	uint64_t desired_addr;
-	int fields_on_line;
-	int write_binary;
-	const struct mmap_file_flags *mmf = info->privdata;
-
-	desired_addr = strtoull(argv[1], NULL, 0);
-	bytes_to_dump = strtoul(argv[2], NULL, 0);
-
-	write_binary = 0;
-	if (argc == 4) {
-		if (!strcmp(argv[3], "-b")) {
-			write_binary = 1;
-		} else {
-			return -1;
-		}
-	}
+	unsigned long len, done, n;
+	struct iot_handle *h;
+	volatile void *mem;
+	uint64_t addr;
+	uint32_t crc = 0;
 
-	mmap_addr.addr = desired_addr;
-	if (open_mapping(&mmap_addr, O_RDONLY | mmf->flags, bytes_to_dump) < 0) {
+	mem = map_region(info, argv, &h, &addr, &len);
+	if (mem == NULL) {
 		return -1;
 	}
 
-	if (write_binary) {
-		void *buffer_to_write = (void *)mmap_addr.mem + mmap_addr.off;
-		int ret = fwrite(buffer_to_write, bytes_to_dump, 1, stdout);
-		close_mapping(&mmap_addr);
-		return ret == 1 ? 0 : -1;
+	for (done = 0; done < len; done += n) {
+		n = (len - done < CHUNK_SIZE) ? len - done : CHUNK_SIZE;
+		read_region(h, addr + done, chunk,
+		            (const volatile uint8_t *)mem + done, n, 32);
+		crc = simd->crc32c(crc, chunk, n);
 	}
+	output_hex(crc, 8, 0);
+	output_char('\n');
 
-	addr = (void *)mmap_addr.mem + mmap_addr.off;
-	bytes_left = bytes_to_dump;
+	put_handle(h);
 
-	fields_on_line = 0;
-	while (bytes_left) {
-		int bytes_printed = sizeof(*addr);
-		/* Print out the current address. */
-		if (!fields_on_line) {
-			fprintf(stdout, "0x%016llx:",
-			        (unsigned long long)desired_addr);
-		}
+	return 0;
+}
 
-		/* Print out the leftover bytes. */
-		if (bytes_left < sizeof(*addr)) {
-			unsigned char *ptr = (unsigned char *)addr;
-			fprintf(stdout, " 0x%02x", *ptr);
-			/* Adjust the working pointer and the bytes_printed */
-			addr = (typeof(addr))++ptr;
-			bytes_printed = sizeof(*ptr);
-		} else {
-			fprintf(stdout, " 0x%08x", *addr);
-			addr++;
-		}
+/* Print every byte of the region that differs from the file, as
+ * "<addr>: <memory> <file>". Fails, like cmp(1), if any byte differs. */
+static int
+mmio_cmp(int argc, const char *argv[], const struct cmd_info *info)
+{
+	unsigned long len, off;
+	struct iot_handle *h;
+	volatile void *mem;
+	uint8_t *buf = NULL;
+	uint8_t *file;
+	uint64_t addr;
+	ssize_t r;
+	size_t got;
+	int fd, rc = 0;
 
-		/* Keep track of statistics. */
-		bytes_left -= bytes_printed;
-		desired_addr += bytes_printed;
+	fd = open(argv[3], O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "open(%s): %s\n", argv[3], strerror(errno));
+		return -1;
+	}
 
-		/* Default to printing out 4 sets of 32-bit values. */
-		fields_on_line = (fields_on_line + 1) % 4;
+	mem = map_region(info, argv, &h, &addr, &len);
+	if (mem == NULL) {
+		close(fd);
+		return -1;
+	}
 
-		/* Handle the new line once we are field 0 again. */
-		if (!fields_on_line) {
-			fprintf(stdout, "\n");
+	file = malloc(len ? len : 1);
+	buf = malloc(len ? len : 1);
+	if (file == NULL || buf == NULL) {
+		fprintf(stderr, "out of memory\n");
+		rc = -1;
+		goto out;
+	}
+	for (got = 0; got < len; got += r) {
+		r = read(fd, file + got, len - got);
+		if (r < 0 && errno == EINTR) {
+			r = 0;
+		} else if (r <= 0) {
+			fprintf(stderr, "%s: %s\n", argv[3],
+			        r < 0 ? strerror(errno) : "file too short");
+			rc = -1;
+			goto out;
 		}
 	}
 
-	/* Print newline if we stopped printing in the middle of a line. */
-	if (fields_on_line) {
-		fprintf(stdout, "\n");
+	read_region(h, addr, buf, mem, len, 32);
+	for (off = 0; (off += simd->mismatch(buf + off, file + off,
+	                                     len - off)) < len; off++) {
+		output_hex(addr + off, 16, 0);
+		output_str(": ");
+		output_hex(buf[off], 2, 0);
+		output_char(' ');
+		output_hex(file[off], 2, 0);
+		output_char('\n');
+		rc = -1;
 	}
 
-	close_mapping(&mmap_addr);
+out:
+	free(buf);
+	free(file);
+	put_handle(h);
+	close(fd);
 
-	return 0;
+	return rc;
 }
 
-static struct mmap_file_flags cacheable_access = {};
-static struct mmap_file_flags uncacheable_access = { O_SYNC };
+static const struct backend cacheable_access = {
+	.space = IOT_SPACE_MEM,
+	.dev_fmt = "/dev/mem",
+};
+static const struct backend uncacheable_access = {
+	.space = IOT_SPACE_MMIO,
+	.dev_fmt = "/dev/mem",
+};
 
-MAKE_PREREQ_PARAMS_FIXED_ARGS(rd_params, 2, "<addr>", 0);
+MAKE_PREREQ_PARAMS_SAMPLED(rd_params, 2, 2, "<addr|range>", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(wr_params, 3, "<addr> <value>", 0);
-MAKE_PREREQ_PARAMS_VAR_ARGS(dump_params, 3, 4, "<addr> <num_bytes> [-b]", 0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(rmw_params, 4, 5, "<addr> <clear> <set> [-v]", 0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(dump_params, 3, 6,
+                            "<addr> <num_bytes> [-b] [--width bits]", 0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(find_params, 4, "<addr> <num_bytes> <hexbytes>",
+                              0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(crc_params, 3, "<addr> <num_bytes>", 0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(cmp_params, 4, "<addr> <num_bytes> <file>", 0);
 
 #define MAKE_MMIO_READ_CMD(prefix_, size_, access_) \
-	MAKE_CMD_WITH_PARAMS_SIZE(prefix_ ## _read ##size_, &mmio_read_x, \
+	MAKE_CMD_WITH_PARAMS_SIZE(prefix_ ## _read ##size_, &backend_read_cmd, \
 	                          &access_, &rd_params, &size ##size_)
 #define MAKE_MMIO_WRITE_CMD(prefix_, size_, access_) \
-	MAKE_CMD_WITH_PARAMS_SIZE(prefix_ ## _write ##size_, &mmio_write_x, \
+	MAKE_CMD_WITH_PARAMS_SIZE(prefix_ ## _write ##size_, &backend_write_cmd, \
 	                          &access_, &wr_params, &size ##size_)
+#define MAKE_MMIO_RMW_CMD(prefix_, size_, access_) \
+	MAKE_CMD_WITH_PARAMS_SIZE(prefix_ ## _rmw ##size_, &backend_rmw_cmd, \
+	                          &access_, &rmw_params, &size ##size_)
 #define MAKE_MMIO_RW_CMD_PAIR(prefix_, size_, access_) \
 	MAKE_MMIO_READ_CMD(prefix_, size_, access_), \
-	MAKE_MMIO_WRITE_CMD(prefix_, size_, access_)
+	MAKE_MMIO_WRITE_CMD(prefix_, size_, access_), \
+	MAKE_MMIO_RMW_CMD(prefix_, size_, access_)
 
 #define MAKE_UC_MMIO_RW_CMD_PAIR(size_) \
 	MAKE_MMIO_RW_CMD_PAIR(mmio, size_, uncacheable_access)
@@ -303,7 +389,13 @@ static const struct cmd_info mmio_cmds[] = {
 	MAKE_UC_MMIO_RW_CMD_PAIR(32),
 	MAKE_UC_MMIO_RW_CMD_PAIR(64),
 	MAKE_CMD_WITH_PARAMS(mmio_dump, &mmio_dump, &uncacheable_access,
-	                     &dump_params)
+	                     &dump_params),
+	MAKE_CMD_WITH_PARAMS(mmio_find, &mmio_find, &uncacheable_access,
+	                     &find_params),
+	MAKE_CMD_WITH_PARAMS(mmio_crc32c, &mmio_crc32c, &uncacheable_access,
+	                     &crc_params),
+	MAKE_CMD_WITH_PARAMS(mmio_cmp, &mmio_cmp, &uncacheable_access,
+	                     &cmp_params),
 };
 
 MAKE_CMD_GROUP(MMIO,
@@ -317,7 +409,13 @@ static const struct cmd_info cacheable_mmio_cmds[] = {
 	MAKE_WB_MMIO_RW_CMD_PAIR(32),
 	MAKE_WB_MMIO_RW_CMD_PAIR(64),
 	MAKE_CMD_WITH_PARAMS(mem_dump, &mmio_dump, &cacheable_access,
-	                     &dump_params)
+	                     &dump_params),
+	MAKE_CMD_WITH_PARAMS(mem_find, &mmio_find, &cacheable_access,
+	                     &find_params),
+	MAKE_CMD_WITH_PARAMS(mem_crc32c, &mmio_crc32c, &cacheable_access,
+	                     &crc_params),
+	MAKE_CMD_WITH_PARAMS(mem_cmp, &mmio_cmp, &cacheable_access,
+	                     &cmp_params),
 };
 
 MAKE_CMD_GROUP(MEM,
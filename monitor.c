@@ -0,0 +1,333 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Register change monitoring.
+ *
+ * "monitor [-d duration] [-f file] [register ...]" reads a list of
+ * registers round robin, as fast as the backends allow, and reports only
+ * the values that change. Registers are written like poll's: a type such as
+ * pci16, msr or smbus8 followed by the device values and the address, e.g.
+ *
+ *	monitor pci16 0 0x1c 0 0x52 msr 0 0x19c smbus8 3 0x50 0x10
+ *
+ * A file holds one register per line; # starts a comment. Every register's
+ * first value is reported as its baseline. Each report line carries the TSC
+ * (see read_ticks()), the microseconds since monitoring started, the
+ * register and its old and new value. Monitoring lasts until the duration
+ * has passed or the process is interrupted; the scan rate is then printed
+ * to stderr. The slowest scan bounds how short a change can be and still
+ * be seen.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "output.h"
+#include "platform.h"
+
+#define MAX_MONITOR_REGS 1024
+
+struct monitor_reg {
+	struct reg_ref ref;
+	uint64_t value;
+};
+
+struct monitor {
+	struct monitor_reg *regs;
+	int nregs;
+	struct handle_set handles;
+	/* Each scan is one batch, see iot_read_batch(). */
+	struct iot_handle **h;
+	struct iot_access *acc;
+};
+
+static volatile sig_atomic_t monitor_stop;
+
+static void
+monitor_signal(int sig)
+{
+	monitor_stop = 1;
+}
+
+static uint64_t
+monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+report(const struct monitor_reg *reg, uint64_t ticks, uint64_t ns,
+       uint64_t old, int baseline)
+{
+	/* A baseline has no old value; it carries its own. */
+	const struct output_field fields[] = {
+		{ "ticks", ticks, 0 },
+		{ "elapsed_ns", ns, 0 },
+		{ "old", baseline ? reg->value : old, reg->ref.spec.width / 4 },
+	};
+	char buf[160];
+	int len, i;
+
+	if (output_get_format() != OUTPUT_TEXT) {
+		output_record_fields(reg->ref.spec.space, reg->ref.dev,
+		                     reg->ref.spec.ndev, reg->ref.addr,
+		                     reg->ref.spec.width, reg->value, 0, fields,
+		                     sizeof(fields) / sizeof(fields[0]));
+		return;
+	}
+
+	len = snprintf(buf, sizeof(buf), "%llu %llu.%03llu %s",
+	               (unsigned long long)ticks,
+	               (unsigned long long)(ns / 1000),
+	               (unsigned long long)(ns % 1000), reg->ref.name);
+	for (i = 0; i < reg->ref.spec.ndev; i++) {
+		len += snprintf(&buf[len], sizeof(buf) - len, " 0x%x",
+		                reg->ref.dev[i]);
+	}
+	snprintf(&buf[len], sizeof(buf) - len, " 0x%llx ",
+	         (unsigned long long)reg->ref.addr);
+	output_str(buf);
+	if (baseline) {
+		output_str("-");
+	} else {
+		output_hex(old, reg->ref.spec.width / 4, 0);
+	}
+	output_str(" ");
+	output_hex(reg->value, reg->ref.spec.width / 4, 0);
+	output_char('\n');
+}
+
+/* Read every register into m->acc, failing on any error. */
+static int
+scan(struct monitor *m)
+{
+	const struct monitor_reg *reg;
+	int i;
+
+	if (iot_read_batch(m->h, m->acc, m->nregs) == 0) {
+		return 0;
+	}
+	for (i = 0; i < m->nregs; i++) {
+		reg = &m->regs[i];
+		if (m->acc[i].status != 0) {
+			fprintf(stderr, "can't read %s register 0x%llx: %s\n",
+			        reg->ref.name, (unsigned long long)reg->ref.addr,
+			        strerror(-m->acc[i].status));
+			break;
+		}
+	}
+	return -1;
+}
+
+static int
+run_monitor(struct monitor *m, uint64_t duration_ns)
+{
+	struct monitor_reg *reg;
+	struct sigaction sa, old_int, old_term;
+	uint64_t start, end, now, t0, t1, ticks0, scan_ticks, max_scan = 0;
+	uint64_t scans = 0, changes = 0, old;
+	double ns_per_tick;
+	int i, changed, rc = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = monitor_signal;
+	sigemptyset(&sa.sa_mask);
+	monitor_stop = 0;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+
+	start = monotonic_ns();
+	ticks0 = read_ticks();
+	if (scan(m) < 0) {
+		rc = -1;
+		goto out;
+	}
+	t1 = read_ticks();
+	now = monotonic_ns() - start;
+	for (i = 0; i < m->nregs; i++) {
+		reg = &m->regs[i];
+		reg->value = m->acc[i].value;
+		report(reg, t1, now, 0, 1);
+	}
+	output_flush();
+
+	while (!monitor_stop) {
+		changed = 0;
+		t0 = read_ticks();
+		if (scan(m) < 0) {
+			rc = -1;
+			goto out;
+		}
+		t1 = read_ticks();
+		now = 0;
+		for (i = 0; i < m->nregs; i++) {
+			reg = &m->regs[i];
+			if (m->acc[i].value == reg->value) {
+				continue;
+			}
+			if (now == 0) {
+				now = monotonic_ns() - start;
+			}
+			old = reg->value;
+			reg->value = m->acc[i].value;
+			report(reg, t1, now, old, 0);
+			changed++;
+		}
+		scan_ticks = t1 - t0;
+		if (scan_ticks > max_scan) {
+			max_scan = scan_ticks;
+		}
+		scans++;
+
+		if (changed) {
+			changes += changed;
+			output_flush();
+		}
+		/* The clock is only consulted every so often. */
+		if (duration_ns != 0 && (scans & 63) == 0 &&
+		    monotonic_ns() - start >= duration_ns) {
+			break;
+		}
+	}
+
+out:
+	end = monotonic_ns();
+	now = read_ticks();
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	output_flush();
+
+	ns_per_tick = (now > ticks0) ? (double)(end - start) / (now - ticks0) : 0;
+	if (scans > 0) {
+		fprintf(stderr, "%llu scans of %d registers in %.3fs: "
+		        "%.0f scans/s, mean scan %.3fus, slowest %.3fus, "
+		        "%llu changes\n",
+		        (unsigned long long)scans, m->nregs,
+		        (end - start) / 1e9, scans * 1e9 / (end - start),
+		        (end - start) / 1e3 / scans,
+		        max_scan * ns_per_tick / 1e3,
+		        (unsigned long long)changes);
+	}
+
+	return rc;
+}
+
+static int
+monitor(int argc, const char *argv[], const struct cmd_info *info)
+{
+	struct monitor m;
+	struct reg_ref *refs;
+	uint64_t duration = 0;
+	int arg = 1, nrefs = 0, i, rc = -1;
+
+	memset(&m, 0, sizeof(m));
+	m.regs = calloc(MAX_MONITOR_REGS, sizeof(*m.regs));
+	refs = calloc(MAX_MONITOR_REGS, sizeof(*refs));
+	if (m.regs == NULL || refs == NULL) {
+		free(m.regs);
+		free(refs);
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		if (arg + 1 == argc) {
+			goto usage;
+		}
+		if (!strcmp(argv[arg], "-d")) {
+			if (parse_duration(argv[arg + 1], &duration) < 0) {
+				fprintf(stderr, "bad duration '%s'\n",
+				        argv[arg + 1]);
+				goto done;
+			}
+		} else if (!strcmp(argv[arg], "-f")) {
+			if (parse_reg_ref_file(argv[arg + 1], refs, &nrefs,
+			                       MAX_MONITOR_REGS) < 0) {
+				goto done;
+			}
+		} else {
+			goto usage;
+		}
+	}
+	if (parse_reg_refs(argc - arg, &argv[arg], refs, &nrefs,
+	                   MAX_MONITOR_REGS) < 0) {
+		goto done;
+	}
+	if (nrefs == 0) {
+		goto usage;
+	}
+	for (m.nregs = 0; m.nregs < nrefs; m.nregs++) {
+		m.regs[m.nregs].ref = refs[m.nregs];
+	}
+
+	m.h = calloc(m.nregs, sizeof(*m.h));
+	m.acc = calloc(m.nregs, sizeof(*m.acc));
+	if (m.h == NULL || m.acc == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto done;
+	}
+	for (i = 0; i < m.nregs; i++) {
+		m.acc[i].addr = m.regs[i].ref.addr;
+		m.acc[i].width = m.regs[i].ref.spec.width;
+		m.h[i] = handle_set_get(&m.handles, m.regs[i].ref.spec.space,
+		                        m.regs[i].ref.dev, IOT_RDONLY);
+		if (m.h[i] == NULL) {
+			fprintf(stderr, "can't open %s device: %s\n",
+			        m.regs[i].ref.name, strerror(errno));
+			goto done;
+		}
+	}
+	if (m.handles.recycled) {
+		fprintf(stderr, "at most %d devices can be monitored\n",
+		        HANDLE_SET_SIZE);
+		goto done;
+	}
+
+	rc = run_monitor(&m, duration);
+	goto done;
+
+usage:
+	fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+done:
+	handle_set_release(&m.handles);
+	free(m.h);
+	free(m.acc);
+	free(m.regs);
+	free(refs);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(monitor_params, 2, INT_MAX,
+                            "[-d duration] [-f file] "
+                            "[<type> [dev ...] <addr> ...]", 0);
+
+static const struct cmd_info monitor_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(monitor, monitor, NULL, &monitor_params),
+};
+
+MAKE_CMD_GROUP(MONITOR, "commands to watch registers for changes",
+               monitor_cmds);
+REGISTER_CMD_GROUP(MONITOR);
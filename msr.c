@@ -23,99 +23,83 @@
 #define _FILE_OFFSET_BITS 64
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <fcntl.h>
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include "commands.h"
+#include "output.h"
 #include "platform.h"
+#include "regmap.h"
 
 #ifdef ARCH_X86
 
-static int
-open_and_seek(int cpu, unsigned long msr, int mode, int *fd)
-{
-	char dev[512];
-
-	snprintf(dev, sizeof(dev), "/dev/cpu/%d/msr", cpu);
-	*fd = open(dev, mode);
-	if (*fd < 0) {
-		fprintf(stderr, "open(\"%s\"): %s\n", dev, strerror(errno));
-		return -1;
-	}
+static const struct backend msr_backend = {
+	.space = IOT_SPACE_MSR,
+	.width = 64,
+	.addr_step = 1,
+	.dev_fmt = "/dev/cpu/%u/msr",
+};
 
-	if (lseek(*fd, msr, SEEK_SET) == (off_t)-1) {
-		fprintf(stderr, "lseek(%lu): %s\n", msr, strerror(errno));
-		close(*fd);
-		return -1;
-	}
+MAKE_PREREQ_PARAMS_SAMPLED(rd_params, 3, 3, "<cpu> <msr|range>", 0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(wr_params, 4, "<cpu> <msr> <data>", 0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(rmw_params, 5, 6, "<cpu> <msr> <clear> <set> [-v]",
+                            0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(rmw_all_params, 4, 5,
+                            "<msr> <clear> <set> [-v]", 0);
 
-	return 0;
-}
+#define MAX_CPUS 4096
 
+/* The same read-modify-write on every online CPU. All CPUs are tried even if
+ * some of them fail. */
 static int
-rd_msr(int argc, const char *argv[], const struct cmd_info *info)
+msr_rmw_all(int argc, const char *argv[], const struct cmd_info *info)
 {
-	unsigned long msr;
-	int cpu;
-	uint64_t data;
-	int fd;
-
-	cpu = strtol(argv[1], NULL, 0);
-	msr = strtoul(argv[2], NULL, 0);
-
-	if (open_and_seek(cpu, msr, O_RDONLY, &fd) < 0) {
-		return -1;
-	}
+	static unsigned int cpus[MAX_CPUS];
+	unsigned int dev[IOT_MAX_DEV_ARGS] = { 0 };
+	uint64_t msr, clear, set;
+	struct iot_handle *h;
+	int verify, ncpus, i;
+	int ret = 0;
 
-	if (read(fd, &data, sizeof(data)) != sizeof(data)) {
-		fprintf(stderr, "read(): %s\n", strerror(errno));
-		close(fd);
+	verify = parse_rmw_verify(&argc, argv);
+	if (argc != 4) {
+		fprintf(stderr, "%s: expected <msr> <clear> <set>\n", argv[0]);
 		return -1;
 	}
-
-	close(fd);
-
-	printf("0x%016" PRIx64 "\n", data);
-
-	return 0;
-}
-
-static int
-wr_msr(int argc, const char *argv[], const struct cmd_info *info)
-{
-	unsigned long msr;
-	int cpu;
-	uint64_t data;
-	int fd;
-	int ret = 0;
-
-	cpu = strtol(argv[1], NULL, 0);
-	msr = strtoul(argv[2], NULL, 0);
-	data = strtoull(argv[3], NULL, 0);
-
-	if (open_and_seek(cpu, msr, O_WRONLY, &fd) < 0) {
+	if (parse_reg_addr(IOT_SPACE_MSR, argv[1], &msr) < 0 ||
+	    parse_reg_value(argv[2], &clear) < 0 ||
+	    parse_reg_value(argv[3], &set) < 0) {
 		return -1;
 	}
 
-	if (write(fd, &data, sizeof(data)) != sizeof(data)) {
-		fprintf(stderr, "write(): %s\n", strerror(errno));
-		ret = -1;
+	ncpus = online_cpus(cpus, MAX_CPUS);
+	for (i = 0; i < ncpus; i++) {
+		dev[0] = cpus[i];
+		h = backend_open(&msr_backend, dev, IOT_RDWR);
+		if (h == NULL) {
+			ret = -1;
+			continue;
+		}
+		if (backend_modify(&msr_backend, h, msr, 64, clear, set,
+		                   verify) < 0) {
+			ret = -1;
+		}
+		put_handle(h);
 	}
 
-	close(fd);
-
 	return ret;
 }
 
-MAKE_PREREQ_PARAMS_FIXED_ARGS(rd_params, 3, "<cpu> <msr>", 0);
-MAKE_PREREQ_PARAMS_FIXED_ARGS(wr_params, 4, "<cpu> <msr> <data>", 0);
-
 static const struct cmd_info msr_cmds[] = {
-	MAKE_CMD_WITH_PARAMS(rdmsr, &rd_msr, NULL, &rd_params),
-	MAKE_CMD_WITH_PARAMS(wrmsr, &wr_msr, NULL, &wr_params),
+	MAKE_CMD_WITH_PARAMS(rdmsr, &backend_read_cmd, &msr_backend,
+	                     &rd_params),
+	MAKE_CMD_WITH_PARAMS(wrmsr, &backend_write_cmd, &msr_backend,
+	                     &wr_params),
+	MAKE_CMD_WITH_PARAMS(msr_rmw, &backend_rmw_cmd, &msr_backend,
+	                     &rmw_params),
+	MAKE_CMD_WITH_PARAMS(msr_rmw_all, &msr_rmw_all, &msr_backend,
+	                     &rmw_all_params),
 };
 
 MAKE_CMD_GROUP(MSR, "commands to access CPU model specific registers",
@@ -0,0 +1,689 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Buffered output and record formatting, see output.h.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "commands.h"
+#include "output.h"
+#include "platform.h"
+#include "simd.h"
+
+#define OUTPUT_BUF_SIZE (256 * 1024)
+
+/* Largest amount of space a single formatting call reserves. */
+#define MAX_FIELD 64
+
+static char out_buf[OUTPUT_BUF_SIZE];
+static size_t out_len;
+static enum output_format out_format = OUTPUT_TEXT;
+static int out_batching;
+static int csv_header_done;
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+static const char *format_names[] = {
+	[OUTPUT_TEXT] = "text",
+	[OUTPUT_JSON] = "json",
+	[OUTPUT_CSV] = "csv",
+	[OUTPUT_BIN] = "bin",
+};
+
+int
+output_set_format(const char *name)
+{
+	int i;
+
+	for (i = 0; i < arraysize(format_names); i++) {
+		if (!strcmp(name, format_names[i])) {
+			out_format = i;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "unknown output format '%s'\n", name);
+	return -1;
+}
+
+enum output_format
+output_get_format(void)
+{
+	return out_format;
+}
+
+static int
+write_all(const char *data, size_t len)
+{
+	ssize_t r;
+
+	while (len) {
+		r = write(STDOUT_FILENO, data, len);
+		if (r < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += r;
+		len -= r;
+	}
+	return 0;
+}
+
+int
+output_flush(void)
+{
+	int ret;
+
+	/* Keep anything written through stdio in order. */
+	fflush(stdout);
+	ret = write_all(out_buf, out_len);
+	out_len = 0;
+
+	return ret;
+}
+
+void
+output_batching(int enable)
+{
+	out_batching = enable;
+	if (!enable) {
+		output_flush();
+	}
+}
+
+int
+output_command_done(void)
+{
+	if (!out_batching) {
+		return output_flush();
+	}
+	return 0;
+}
+
+/* Make room for len bytes and return where to put them. Formatting calls
+ * reserve MAX_FIELD; len must not exceed the buffer. */
+static char *
+reserve(size_t len)
+{
+	if (out_len + len > sizeof(out_buf)) {
+		output_flush();
+	}
+	return &out_buf[out_len];
+}
+
+static size_t
+fmt_hex(char *p, uint64_t value, int digits, int flags)
+{
+	const char *set = (flags & OUTPUT_UPPER) ? hex_upper : hex_lower;
+	char tmp[16];
+	size_t len = 0;
+	int n = 0;
+
+	do {
+		tmp[n++] = set[value & 0xf];
+		value >>= 4;
+	} while (value);
+	while (n < digits && n < sizeof(tmp)) {
+		tmp[n++] = '0';
+	}
+
+	if (!(flags & OUTPUT_NO_PREFIX)) {
+		p[len++] = '0';
+		p[len++] = 'x';
+	}
+	while (n) {
+		p[len++] = tmp[--n];
+	}
+	return len;
+}
+
+static size_t
+fmt_dec(char *p, uint64_t value)
+{
+	char tmp[20];
+	size_t len = 0;
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n) {
+		p[len++] = tmp[--n];
+	}
+	return len;
+}
+
+void
+output_char(char c)
+{
+	*reserve(1) = c;
+	out_len++;
+}
+
+void
+output_str(const char *s)
+{
+	output_raw(s, strlen(s));
+}
+
+void
+output_hex(uint64_t value, int digits, int flags)
+{
+	out_len += fmt_hex(reserve(MAX_FIELD), value, digits, flags);
+}
+
+void
+output_dec(uint64_t value)
+{
+	out_len += fmt_dec(reserve(MAX_FIELD), value);
+}
+
+void
+output_raw(const volatile void *data, size_t len)
+{
+	if (out_len + len > sizeof(out_buf)) {
+		output_flush();
+		/* Large blocks skip the buffer. */
+		if (len > sizeof(out_buf) / 2) {
+			write_all((const void *)data, len);
+			return;
+		}
+	}
+	memcpy(&out_buf[out_len], (const void *)data, len);
+	out_len += len;
+}
+
+static uint64_t
+timestamp_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+output_dev(const unsigned int *dev, int ndev, char sep)
+{
+	int i;
+
+	for (i = 0; i < ndev; i++) {
+		if (i) {
+			output_char(sep);
+		}
+		output_dec(dev[i]);
+	}
+}
+
+/* Everything of a JSON or CSV record up to the value. The CSV header names
+ * the extra fields of the first record. */
+static void
+output_record_start(enum iot_space space, const unsigned int *dev, int ndev,
+                    uint64_t addr, int width,
+                    const struct output_field *fields, int nfields)
+{
+	int i;
+
+	if (out_format == OUTPUT_JSON) {
+		output_str("{\"timestamp_ns\":");
+		output_dec(timestamp_ns());
+		output_str(",\"backend\":\"");
+		output_str(iot_space_name(space));
+		output_str("\",\"dev\":[");
+		output_dev(dev, ndev, ',');
+		output_str("],\"addr\":\"");
+		output_hex(addr, 0, 0);
+		output_str("\",\"width\":");
+		output_dec(width);
+		output_str(",\"value\":\"");
+		return;
+	}
+
+	if (!csv_header_done) {
+		output_str("timestamp_ns,backend,dev,addr,width,value");
+		for (i = 0; i < nfields; i++) {
+			output_char(',');
+			output_str(fields[i].name);
+		}
+		output_char('\n');
+		csv_header_done = 1;
+	}
+	output_dec(timestamp_ns());
+	output_char(',');
+	output_str(iot_space_name(space));
+	output_char(',');
+	output_dev(dev, ndev, ':');
+	output_char(',');
+	output_hex(addr, 0, 0);
+	output_char(',');
+	output_dec(width);
+	output_char(',');
+}
+
+/* The extra fields after the value, and the end of the line. */
+static void
+output_record_end(const struct output_field *fields, int nfields)
+{
+	int i;
+
+	if (out_format == OUTPUT_JSON) {
+		output_char('"');
+	}
+	for (i = 0; i < nfields; i++) {
+		if (out_format == OUTPUT_JSON) {
+			output_str(",\"");
+			output_str(fields[i].name);
+			output_str("\":");
+		} else {
+			output_char(',');
+		}
+		if (!fields[i].hex_digits) {
+			output_dec(fields[i].value);
+		} else if (out_format == OUTPUT_JSON) {
+			output_char('"');
+			output_hex(fields[i].value, fields[i].hex_digits, 0);
+			output_char('"');
+		} else {
+			output_hex(fields[i].value, fields[i].hex_digits, 0);
+		}
+	}
+	if (out_format == OUTPUT_JSON) {
+		output_char('}');
+	}
+	output_char('\n');
+}
+
+static void
+output_bin(enum iot_space space, const unsigned int *dev, int ndev,
+           uint64_t addr, int width, uint64_t value)
+{
+	struct output_bin_record rec;
+	int i;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.timestamp_ns = timestamp_ns();
+	rec.addr = addr;
+	rec.value = value;
+	for (i = 0; i < ndev; i++) {
+		rec.dev[i] = dev[i];
+	}
+	rec.space = space;
+	rec.width = width;
+	rec.ndev = ndev;
+	output_raw(&rec, sizeof(rec));
+}
+
+void
+output_record_fields(enum iot_space space, const unsigned int *dev, int ndev,
+                     uint64_t addr, int width, uint64_t value, int flags,
+                     const struct output_field *fields, int nfields)
+{
+	switch (out_format) {
+	case OUTPUT_TEXT:
+		output_hex(value, width / 4, flags);
+		output_char('\n');
+		break;
+	case OUTPUT_JSON:
+	case OUTPUT_CSV:
+		output_record_start(space, dev, ndev, addr, width, fields,
+		                    nfields);
+		output_hex(value, width / 4, 0);
+		output_record_end(fields, nfields);
+		break;
+	case OUTPUT_BIN:
+		output_bin(space, dev, ndev, addr, width, value);
+		break;
+	}
+}
+
+void
+output_record(enum iot_space space, const unsigned int *dev, int ndev,
+              uint64_t addr, int width, uint64_t value, int flags)
+{
+	output_record_fields(space, dev, ndev, addr, width, value, flags,
+	                     NULL, 0);
+}
+
+void
+output_read(const struct iot_handle *h, uint64_t addr, int width,
+            uint64_t value, int flags)
+{
+	output_read_fields(h, addr, width, value, flags, NULL, 0);
+}
+
+void
+output_read_fields(const struct iot_handle *h, uint64_t addr, int width,
+                   uint64_t value, int flags,
+                   const struct output_field *fields, int nfields)
+{
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	int ndev = iot_dev(h, dev);
+
+	output_record_fields(iot_space(h), dev, ndev, addr, width, value,
+	                     flags, fields, nfields);
+}
+
+/* Two hex digits per byte, without separators. */
+static void
+output_hex_bytes(const uint8_t *data, size_t len, int flags)
+{
+	size_t n;
+
+	while (len) {
+		n = (len < MAX_FIELD / 2) ? len : MAX_FIELD / 2;
+		simd->hex(reserve(MAX_FIELD), data, n, 1, flags & OUTPUT_UPPER);
+		out_len += 2 * n;
+		data += n;
+		len -= n;
+	}
+}
+
+/* A line of mmio_dump output covers 16 bytes, or one value if that is
+ * wider: the address, the values and a newline. */
+#define DUMP_LINE_BYTES 16
+#define DUMP_LINE_LEN(fields, digits) \
+	(2 + 16 + 1 + (fields) * (3 + (digits)) + 1)
+/* Bytes formatted per call of the hex kernel. */
+#define DUMP_BATCH_BYTES 4096
+
+/* A value of up to 64 bits, in host byte order. */
+static uint64_t
+dump_value(const uint8_t *data, int bytes)
+{
+	uint64_t v64;
+	uint32_t v32;
+	uint16_t v16;
+
+	switch (bytes) {
+	case 1:
+		return *data;
+	case 2:
+		memcpy(&v16, data, sizeof(v16));
+		return v16;
+	case 4:
+		memcpy(&v32, data, sizeof(v32));
+		return v32;
+	}
+	memcpy(&v64, data, sizeof(v64));
+	return v64;
+}
+
+/* memcpy() of the digits of one value, inlined for every size. */
+static inline void
+copy_digits(char *dst, const char *src, int n)
+{
+	switch (n) {
+	case 2:
+		memcpy(dst, src, 2);
+		break;
+	case 4:
+		memcpy(dst, src, 4);
+		break;
+	case 8:
+		memcpy(dst, src, 8);
+		break;
+	default:
+		memcpy(dst, src, 16);
+		break;
+	}
+}
+
+/* The old formatter, one field at a time, for the last partial line. Bytes
+ * past the last whole value count as fields of their own, 16 to a line
+ * where a line holds a single value. */
+static void
+output_dump_tail(uint64_t addr, const uint8_t *data, size_t len,
+                 int value_bytes, int fields)
+{
+	int fields_on_line = 0;
+	int n;
+
+	if (fields == 1) {
+		fields = DUMP_LINE_BYTES;
+	}
+	while (len) {
+		if (!fields_on_line) {
+			output_hex(addr, 16, 0);
+			output_char(':');
+		}
+		output_char(' ');
+		n = (len < value_bytes) ? 1 : value_bytes;
+		output_hex(dump_value(data, n), 2 * n, 0);
+		data += n;
+		addr += n;
+		len -= n;
+		fields_on_line = (fields_on_line + 1) % fields;
+		if (!fields_on_line) {
+			output_char('\n');
+		}
+	}
+	if (fields_on_line) {
+		output_char('\n');
+	}
+}
+
+/* A record of a value wider than 64 bits. JSON and CSV show it like the
+ * text dump does: in host byte order, as 0x and the digits of its 64 bit
+ * parts, most significant first. Bin records carry the bytes. */
+static void
+output_dump_wide(const struct iot_handle *h, uint64_t addr,
+                 const uint8_t *data, int bytes)
+{
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	int ndev = iot_dev(h, dev);
+	int k;
+
+	if (out_format == OUTPUT_BIN) {
+		output_block(h, addr, data, bytes, 0);
+		return;
+	}
+	output_record_start(iot_space(h), dev, ndev, addr, 8 * bytes, NULL, 0);
+	output_str("0x");
+	for (k = 0; k < bytes / 8; k++) {
+#ifdef IS_LITTLE_ENDIAN
+		output_hex(dump_value(data + bytes - 8 * (k + 1), 8), 16,
+		           OUTPUT_NO_PREFIX);
+#else
+		output_hex(dump_value(data + 8 * k, 8), 16, OUTPUT_NO_PREFIX);
+#endif
+	}
+	output_record_end(NULL, 0);
+}
+
+/* One record per value; bytes past the last whole value get one each. */
+static void
+output_dump_records(const struct iot_handle *h, uint64_t addr,
+                    const uint8_t *data, size_t len, int value_bytes)
+{
+	int n;
+
+	while (len) {
+		n = (len < value_bytes) ? 1 : value_bytes;
+		if (n > 8) {
+			output_dump_wide(h, addr, data, n);
+		} else {
+			output_read(h, addr, 8 * n, dump_value(data, n), 0);
+		}
+		data += n;
+		addr += n;
+		len -= n;
+	}
+}
+
+void
+output_dump(const struct iot_handle *h, uint64_t addr, const void *data,
+            size_t len, int width)
+{
+	char addr_hex[DUMP_BATCH_BYTES / DUMP_LINE_BYTES * 16];
+	char value_hex[DUMP_BATCH_BYTES * 2];
+	uint64_t addrs[DUMP_BATCH_BYTES / DUMP_LINE_BYTES];
+	const int value_bytes = width / 8;
+	/* The hex kernel takes values of up to 8 bytes; wider ones are
+	 * converted in parts and put together here. */
+	const int part_bytes = (value_bytes < 8) ? value_bytes : 8;
+	const int parts = value_bytes / part_bytes;
+	const int digits = 2 * part_bytes;
+	const size_t line_bytes = (value_bytes > DUMP_LINE_BYTES) ?
+	                          value_bytes : DUMP_LINE_BYTES;
+	const int fields = line_bytes / value_bytes;
+	const size_t line_len = DUMP_LINE_LEN(fields, 2 * value_bytes);
+	const uint8_t *src = data;
+	size_t lines, i;
+	char *p, *w;
+	const char *v;
+	int j, k;
+
+	if (out_format != OUTPUT_TEXT) {
+		output_dump_records(h, addr, data, len, value_bytes);
+		return;
+	}
+
+	while (len >= line_bytes) {
+		lines = len / line_bytes;
+		if (lines > DUMP_BATCH_BYTES / line_bytes) {
+			lines = DUMP_BATCH_BYTES / line_bytes;
+		}
+		for (i = 0; i < lines; i++) {
+			addrs[i] = addr + i * line_bytes;
+		}
+		simd->hex(addr_hex, addrs, lines, 8, 0);
+		simd->hex(value_hex, src, lines * line_bytes / part_bytes,
+		          part_bytes, 0);
+
+		/* Lay the digits out into lines right in the buffer. */
+		p = reserve(lines * line_len);
+		v = value_hex;
+		for (i = 0; i < lines; i++) {
+			p[0] = '0';
+			p[1] = 'x';
+			memcpy(p + 2, addr_hex + i * 16, 16);
+			p[18] = ':';
+			w = p + 19;
+			for (j = 0; j < fields; j++) {
+				w[0] = ' ';
+				w[1] = '0';
+				w[2] = 'x';
+				w += 3;
+				for (k = 0; k < parts; k++) {
+#ifdef IS_LITTLE_ENDIAN
+					copy_digits(w + k * digits,
+					            v + (parts - 1 - k) * digits,
+					            digits);
+#else
+					copy_digits(w + k * digits,
+					            v + k * digits, digits);
+#endif
+				}
+				w += 2 * value_bytes;
+				v += 2 * value_bytes;
+			}
+			*w = '\n';
+			p += line_len;
+		}
+		out_len += lines * line_len;
+
+		addr += lines * line_bytes;
+		src += lines * line_bytes;
+		len -= lines * line_bytes;
+	}
+
+	output_dump_tail(addr, src, len, value_bytes, fields);
+}
+
+void
+output_block(const struct iot_handle *h, uint64_t addr,
+             const uint8_t *data, int len, int flags)
+{
+	static const uint8_t zeroes[8];
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	int ndev = iot_dev(h, dev);
+
+	switch (out_format) {
+	case OUTPUT_TEXT:
+		output_hex_bytes(data, len, flags);
+		output_char('\n');
+		break;
+	case OUTPUT_JSON:
+	case OUTPUT_CSV:
+		output_record_start(iot_space(h), dev, ndev, addr, len * 8,
+		                    NULL, 0);
+		output_hex_bytes(data, len, 0);
+		output_record_end(NULL, 0);
+		break;
+	case OUTPUT_BIN:
+		output_bin(iot_space(h), dev, ndev, addr, 0, len);
+		output_raw(data, len);
+		output_raw(zeroes, (8 - len % 8) % 8);
+		break;
+	}
+}
+
+void
+output_table(const struct iot_handle *h, const struct iot_access *acc,
+             int n, int flags)
+{
+	uint64_t max_addr = 0;
+	int per_line, digits;
+	int i, j;
+
+	if (out_format != OUTPUT_TEXT) {
+		for (i = 0; i < n; i++) {
+			if (acc[i].status == 0) {
+				output_read(h, acc[i].addr, acc[i].width,
+				            acc[i].value, flags);
+			}
+		}
+		return;
+	}
+
+	/* Label every line with an address of uniform width. */
+	for (i = 0; i < n; i++) {
+		if (acc[i].addr > max_addr)
+			max_addr = acc[i].addr;
+	}
+	for (digits = 4; digits < 16 && (max_addr >> (digits * 4)); digits++)
+		;
+
+	for (i = 0; i < n; i++) {
+		per_line = 128 / acc[i].width;
+		if (i % per_line == 0) {
+			output_hex(acc[i].addr, digits, 0);
+			output_char(':');
+		}
+		output_char(' ');
+		if (acc[i].status == 0) {
+			output_hex(acc[i].value, acc[i].width / 4, flags);
+		} else {
+			output_str("--");
+			for (j = 0; j < acc[i].width / 4; j++) {
+				output_char('-');
+			}
+		}
+		if (i % per_line == per_line - 1 || i == n - 1) {
+			output_char('\n');
+		}
+	}
+}
@@ -0,0 +1,126 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+/*
+ * Shared output layer for subcommands.
+ *
+ * All subcommand output to stdout goes through a preallocated buffer that is
+ * written out with plain write() calls once a command finishes (at the end of
+ * the run, or when the buffer fills up, in batch mode). Numbers are
+ * formatted by hand rather than through printf.
+ *
+ * Register values are emitted as records, rendered according to the global
+ * --format option:
+ *   text  the traditional output, e.g. "0x0d578086"
+ *   json  one object per line with backend, device, address, width, value
+ *         and a CLOCK_REALTIME timestamp in nanoseconds
+ *   csv   the same fields, preceded by a header line
+ *   bin   struct output_bin_record in host byte order
+ * Output that is not a register value (logic results, listings) is always
+ * plain text.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "libiotools.h"
+
+enum output_format {
+	OUTPUT_TEXT,
+	OUTPUT_JSON,
+	OUTPUT_CSV,
+	OUTPUT_BIN,
+};
+
+/* Flags for the text format. */
+#define OUTPUT_UPPER     0x1  /* upper case hex digits */
+#define OUTPUT_NO_PREFIX 0x2  /* omit the 0x prefix */
+
+/* A --format=bin record. Block records (width 0) are followed by value bytes
+ * of data, padded with zeroes to a multiple of 8 bytes. */
+struct output_bin_record {
+	uint64_t timestamp_ns;
+	uint64_t addr;
+	uint64_t value;
+	uint32_t dev[IOT_MAX_DEV_ARGS];
+	uint8_t space;      /* enum iot_space */
+	uint8_t width;      /* in bits, 0 for a block of bytes */
+	uint8_t ndev;       /* valid entries in dev */
+	uint8_t reserved[5];
+};
+
+int output_set_format(const char *name);
+enum output_format output_get_format(void);
+
+/* Register values. output_read() takes the device from the handle. */
+void output_read(const struct iot_handle *h, uint64_t addr, int width,
+                 uint64_t value, int flags);
+void output_record(enum iot_space space, const unsigned int *dev, int ndev,
+                   uint64_t addr, int width, uint64_t value, int flags);
+
+/* A field JSON and CSV records carry after the value: a decimal number, or
+ * a hex string like the value if hex_digits is set. */
+struct output_field {
+	const char *name;
+	uint64_t value;
+	int hex_digits;
+};
+
+/* output_read() and output_record() with extra fields. Text prints the
+ * value alone and bin records have no room for the fields. A CSV header only
+ * names the fields of the first record. */
+void output_read_fields(const struct iot_handle *h, uint64_t addr, int width,
+                        uint64_t value, int flags,
+                        const struct output_field *fields, int nfields);
+void output_record_fields(enum iot_space space, const unsigned int *dev,
+                          int ndev, uint64_t addr, int width, uint64_t value,
+                          int flags, const struct output_field *fields,
+                          int nfields);
+void output_block(const struct iot_handle *h, uint64_t addr,
+                  const uint8_t *data, int len, int flags);
+/* The results of a vectored read. Text output is a table with 16 bytes worth
+ * of registers per line; failed reads are shown as dashes and skipped in the
+ * other formats. */
+void output_table(const struct iot_handle *h, const struct iot_access *acc,
+                  int n, int flags);
+/* Memory as mmio_dump prints it: lines of an address and 16 bytes' worth
+ * of values of width bits (8 to 512; one value per line from 128 up) in
+ * host byte order, with a trailing partial value printed byte by byte.
+ * Whole lines are formatted by the vector hex kernel straight into the
+ * output buffer. Other formats get a record per value as output_read()
+ * prints it, values wider than 64 bits with the same digits as the text;
+ * only they use h. */
+void output_dump(const struct iot_handle *h, uint64_t addr,
+                 const void *data, size_t len, int width);
+
+/* Plain text. output_hex() pads to at least digits digits. */
+void output_str(const char *s);
+void output_char(char c);
+void output_hex(uint64_t value, int digits, int flags);
+void output_dec(uint64_t value);
+void output_raw(const volatile void *data, size_t len);
+
+/* Write out buffered output. Returns -1 if stdout could not be written. */
+int output_flush(void);
+/* Called after every command; flushes unless batching is enabled. */
+int output_command_done(void);
+void output_batching(int enable);
+
+#endif /* _OUTPUT_H_ */
@@ -29,22 +29,96 @@
 # define ARCH_X86 1
 #endif
 
+#include <stdint.h>
+
+/* read_ticks() is a cheap, monotonic, fixed rate counter: the TSC on x86,
+ * CLOCK_MONOTONIC_RAW nanoseconds elsewhere. cpu_relax() tells the CPU it
+ * is in a spin loop. cpuid_count() only exists on x86. */
+#ifdef ARCH_X86
+static inline uint64_t
+read_ticks(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void
+cpu_relax(void)
+{
+	__asm__ __volatile__("pause" ::: "memory");
+}
+
+/* Execute CPUID on the current CPU. data receives eax, ebx, ecx, edx. */
+static inline void
+cpuid_count(uint32_t function, uint32_t index, uint32_t *data)
+{
+	__asm__ __volatile__(
+#if defined(__i386__) && defined(__PIC__)
+	      /* We can't use %ebx on 32 bit builds with PIC.
+	       *
+	       * The need for this is, IMO, a bug in GCC.  We should not
+	       * need to know what registers it is using internally.  It
+	       * should be saving and restoring them itself.
+	       */
+	      "xchg %%ebx, %%esi;" /* save ebx in esi */
+	      "cpuid;"
+	      "xchg %%esi, %%ebx;" /* restore ebx, data moves to esi */
+	      : "=a" (data[0]), "=S" (data[1]), "=c" (data[2]), "=d" (data[3])
+	      : "0" (function), "2" (index)
+	      : "memory"
+#else
+	      "cpuid;"
+	      : "=a" (data[0]), "=b" (data[1]), "=c" (data[2]), "=d" (data[3])
+	      : "0" (function), "2" (index)
+	      : "memory"
+#endif
+	);
+}
+#else
+#include <time.h>
+
+static inline uint64_t
+read_ticks(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void
+cpu_relax(void)
+{
+#if defined(__aarch64__) || defined(__arm__)
+	__asm__ __volatile__("yield" ::: "memory");
+#else
+	__asm__ __volatile__("" ::: "memory");
+#endif
+}
+#endif
+
 #if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
 # define IS_BIG_ENDIAN 1
 # define le_to_host_8(x) (x)
 # define le_to_host_16(x) bswap_16(x)
 # define le_to_host_32(x) bswap_32(x)
+# define le_to_host_64(x) bswap_64(x)
 # define host_to_le_8(x) (x)
 # define host_to_le_16(x) bswap_16(x)
 # define host_to_le_32(x) bswap_32(x)
+# define host_to_le_64(x) bswap_64(x)
 #else
 # define IS_LITTLE_ENDIAN 1
 # define le_to_host_8(x) (x)
 # define le_to_host_16(x) (x)
 # define le_to_host_32(x) (x)
+# define le_to_host_64(x) (x)
 # define host_to_le_8(x) (x)
 # define host_to_le_16(x) (x)
 # define host_to_le_32(x) (x)
+# define host_to_le_64(x) (x)
 #endif
 
 #endif /* _PLATFORM_H_ */
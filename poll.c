@@ -0,0 +1,265 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Waiting for register conditions.
+ *
+ * poll_register() re-reads a register until a masked compare succeeds. It
+ * starts with back to back reads, since most conditions (a reset or
+ * calibration done bit) become true within microseconds, and backs off the
+ * longer the wait takes so that long waits don't burn a CPU:
+ *
+ *	< POLL_SPIN_NS    read back to back
+ *	< POLL_PAUSE_NS   cpu_relax() between reads
+ *	< POLL_YIELD_NS   sched_yield() between reads
+ *	after that        sleep between reads, doubling up to POLL_SLEEP_MAX_NS
+ *
+ * Each read is stamped with read_ticks(). The stamp of the read that
+ * satisfied the condition is converted to nanoseconds using the tick rate
+ * measured over the wait itself, so no calibration is needed up front.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "output.h"
+#include "platform.h"
+#include "regmap.h"
+
+#define POLL_SPIN_NS      20000ULL
+#define POLL_PAUSE_NS     200000ULL
+#define POLL_YIELD_NS     2000000ULL
+#define POLL_SLEEP_MIN_NS 10000ULL
+#define POLL_SLEEP_MAX_NS 1000000ULL
+
+/* Reads between clock checks while spinning. */
+#define POLL_CLOCK_INTERVAL 16
+#define POLL_PAUSES 32
+
+#define POLL_DEFAULT_TIMEOUT_NS 1000000000ULL
+
+static uint64_t
+monotonic_raw_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+sleep_ns(uint64_t ns)
+{
+	struct timespec ts;
+
+	ts.tv_sec = ns / 1000000000ULL;
+	ts.tv_nsec = ns % 1000000000ULL;
+	nanosleep(&ts, NULL);
+}
+
+int
+poll_register(struct iot_handle *h, uint64_t addr, int width, uint64_t mask,
+              uint64_t value, uint64_t timeout_ns, struct poll_result *res)
+{
+	uint64_t t0, m0, t, t1, m1, now, elapsed = 0;
+	uint64_t sleep = POLL_SLEEP_MIN_NS;
+	int i;
+
+	memset(res, 0, sizeof(*res));
+	m0 = monotonic_raw_ns();
+	t0 = read_ticks();
+
+	for (;;) {
+		if (iot_read(h, addr, width, &res->value) < 0) {
+			return -1;
+		}
+		t = read_ticks();
+		res->reads++;
+
+		if ((res->value & mask) == value) {
+			t1 = read_ticks();
+			m1 = monotonic_raw_ns();
+			if (t1 > t0) {
+				res->elapsed_ns = (uint64_t)((double)(t - t0) *
+				                             (m1 - m0) / (t1 - t0));
+			}
+			return 0;
+		}
+
+		/* The clock is cheap next to a register read, but while
+		 * spinning it is only looked at every few reads. */
+		if (elapsed < POLL_SPIN_NS &&
+		    res->reads % POLL_CLOCK_INTERVAL != 0) {
+			continue;
+		}
+		now = monotonic_raw_ns();
+		elapsed = now - m0;
+		if (timeout_ns != 0 && elapsed >= timeout_ns) {
+			res->elapsed_ns = elapsed;
+			return 1;
+		}
+
+		if (elapsed < POLL_SPIN_NS) {
+			continue;
+		} else if (elapsed < POLL_PAUSE_NS) {
+			for (i = 0; i < POLL_PAUSES; i++) {
+				cpu_relax();
+			}
+		} else if (elapsed < POLL_YIELD_NS) {
+			sched_yield();
+		} else {
+			if (timeout_ns != 0 && sleep > timeout_ns - elapsed) {
+				sleep = timeout_ns - elapsed;
+			}
+			sleep_ns(sleep);
+			sleep = (sleep * 2 < POLL_SLEEP_MAX_NS) ?
+			        sleep * 2 : POLL_SLEEP_MAX_NS;
+		}
+	}
+}
+
+static int
+has_unit(const char *arg)
+{
+	size_t len = strlen(arg);
+
+	return len > 0 && arg[len - 1] == 's';
+}
+
+static void
+print_elapsed(uint64_t ns)
+{
+	char buf[64];
+
+	snprintf(buf, sizeof(buf), "%llu.%03lluus",
+	         (unsigned long long)(ns / 1000),
+	         (unsigned long long)(ns % 1000));
+	output_str(buf);
+}
+
+/*
+ * poll <spec> [dev...] <addr> <mask> <value> [timeout]
+ *
+ * With the optional PCI segment left out, a timeout takes the same position
+ * as the segment would; it is told apart by its unit suffix.
+ */
+static int
+poll_cmd(int argc, const char *argv[], const struct cmd_info *info)
+{
+	unsigned int dev[IOT_MAX_DEV_ARGS] = { 0 };
+	uint64_t addr, mask, value, timeout = POLL_DEFAULT_TIMEOUT_NS;
+	struct poll_result res;
+	struct reg_spec spec;
+	struct iot_handle *h;
+	uint64_t devval;
+	int nargs, ndev, has_timeout, i, rc;
+
+	if (parse_reg_spec(argv[1], &spec) < 0) {
+		fprintf(stderr, "unknown register type '%s'\n", argv[1]);
+		return -1;
+	}
+
+	nargs = argc - 2;
+	has_timeout = (nargs == spec.ndev + 4) ||
+	              (spec.opt_dev && nargs == spec.ndev + 3 &&
+	               has_unit(argv[argc - 1]));
+	ndev = nargs - 3 - has_timeout;
+	if (ndev < spec.ndev - spec.opt_dev || ndev > spec.ndev) {
+		fprintf(stderr, "%s takes %d device values before the address\n",
+		        argv[1], spec.ndev);
+		return -1;
+	}
+
+	/* Omitted leading device values are 0. */
+	for (i = 0; i < ndev; i++) {
+		if (parse_reg_value(argv[2 + i], &devval) < 0) {
+			return -1;
+		}
+		if (devval > UINT_MAX) {
+			fprintf(stderr, "device value '%s' is too large\n",
+			        argv[2 + i]);
+			return -1;
+		}
+		dev[spec.ndev - ndev + i] = devval;
+	}
+	if (parse_reg_addr(spec.space, argv[2 + ndev], &addr) < 0 ||
+	    parse_reg_value(argv[3 + ndev], &mask) < 0 ||
+	    parse_reg_value(argv[4 + ndev], &value) < 0) {
+		return -1;
+	}
+	if (has_timeout && parse_duration(argv[argc - 1], &timeout) < 0) {
+		fprintf(stderr, "bad timeout '%s'\n", argv[argc - 1]);
+		return -1;
+	}
+	if (value & ~mask) {
+		fprintf(stderr, "value 0x%llx has bits outside mask 0x%llx\n",
+		        (unsigned long long)value, (unsigned long long)mask);
+		return -1;
+	}
+
+	h = get_handle(spec.space, dev, IOT_RDONLY);
+	if (h == NULL) {
+		fprintf(stderr, "can't open %s device: %s\n",
+		        iot_space_name(spec.space), strerror(errno));
+		return -1;
+	}
+
+	rc = poll_register(h, addr, spec.width, mask, value, timeout, &res);
+	if (rc < 0) {
+		fprintf(stderr, "can't read %s register 0x%llx: %s\n", argv[1],
+		        (unsigned long long)addr, strerror(errno));
+	} else if (rc > 0) {
+		fprintf(stderr, "timed out after %llu reads, last value 0x%llx\n",
+		        (unsigned long long)res.reads,
+		        (unsigned long long)res.value);
+		rc = -1;
+	} else if (output_get_format() != OUTPUT_TEXT) {
+		struct output_field fields[] = {
+			{ "elapsed_ns", res.elapsed_ns, 0 },
+			{ "reads", res.reads, 0 },
+		};
+
+		output_read_fields(h, addr, spec.width, res.value, 0, fields,
+		                   arraysize(fields));
+	} else {
+		output_hex(res.value, spec.width / 4, 0);
+		output_char(' ');
+		print_elapsed(res.elapsed_ns);
+		output_str(" reads=");
+		output_dec(res.reads);
+		output_char('\n');
+	}
+
+	put_handle(h);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(poll_params, 5, 10,
+                            "<type> [dev ...] <addr> <mask> <value> "
+                            "[timeout[ns|us|ms|s]]", 0);
+
+static const struct cmd_info poll_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(poll, poll_cmd, NULL, &poll_params),
+};
+
+MAKE_CMD_GROUP(POLL, "commands to wait for register conditions", poll_cmds);
+REGISTER_CMD_GROUP(POLL);
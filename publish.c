@@ -0,0 +1,419 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Publishing register values in shared memory.
+ *
+ * "publish [-i interval] [-d duration] [-f file] <name> [register ...]"
+ * reads a set of registers, named as for monitor, once per interval and
+ * stores their latest values in the POSIX shared memory object <name>.
+ * Other processes map the object and read values without any system call
+ * or hardware access of their own; see publish.h for the layout and the
+ * sequence lock that guards each entry. "publish_read <name>" prints what
+ * is currently published.
+ *
+ * Only one publisher may own an object at a time; it holds an exclusive
+ * lock on it while running. The object is left in place when the publisher
+ * stops, so readers keep their mapping across restarts. It is never made
+ * smaller, since readers of an older, larger layout would fault on the
+ * truncated pages.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "output.h"
+#include "publish.h"
+
+#define MAX_PUBLISH_REGS 1024
+#define DEFAULT_PUBLISH_INTERVAL_NS 100000000ULL
+
+struct publisher {
+	struct reg_ref *refs;
+	struct iot_handle **h;
+	struct iot_access *acc;
+	int nregs;
+	struct handle_set handles;
+	struct iot_publish_header *hdr;
+	struct iot_publish_entry *entries;
+	size_t size;
+	int fd;
+};
+
+static volatile sig_atomic_t publish_stop;
+
+static void
+publish_signal(int sig)
+{
+	publish_stop = 1;
+}
+
+/* Shared memory object names start with a slash and contain no other. */
+static int
+shm_name(const char *name, char *buf, size_t len)
+{
+	if (name[0] == '/') {
+		name++;
+	}
+	if (name[0] == '\0' || strchr(name, '/') != NULL ||
+	    strlen(name) + 2 > len) {
+		fprintf(stderr, "bad shared memory name '%s'\n", name);
+		return -1;
+	}
+	snprintf(buf, len, "/%s", name);
+	return 0;
+}
+
+static int
+create_segment(struct publisher *p, const char *name, uint64_t interval_ns)
+{
+	struct iot_publish_header old;
+	struct stat st;
+	char path[NAME_MAX];
+	uint32_t generation = 0;
+	void *mem;
+	int i;
+
+	if (shm_name(name, path, sizeof(path)) < 0) {
+		return -1;
+	}
+	p->fd = shm_open(path, O_RDWR | O_CREAT, 0644);
+	if (p->fd < 0) {
+		fprintf(stderr, "can't open shared memory %s: %s\n", path,
+		        strerror(errno));
+		return -1;
+	}
+	if (flock(p->fd, LOCK_EX | LOCK_NB) < 0) {
+		fprintf(stderr, "%s is already being published\n", path);
+		return -1;
+	}
+
+	/* Take over the generation of an earlier publisher, and invalidate
+	 * its header while the layout changes. */
+	if (fstat(p->fd, &st) < 0) {
+		fprintf(stderr, "can't stat %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (st.st_size >= sizeof(old) &&
+	    pread(p->fd, &old, sizeof(old), 0) == sizeof(old) &&
+	    !memcmp(old.magic, IOT_PUBLISH_MAGIC, sizeof(old.magic))) {
+		generation = old.generation + 1;
+		memset(old.magic, 0, sizeof(old.magic));
+		pwrite(p->fd, old.magic, sizeof(old.magic), 0);
+	}
+
+	p->size = sizeof(*p->hdr) + p->nregs * sizeof(*p->entries);
+	if (st.st_size < p->size && ftruncate(p->fd, p->size) < 0) {
+		fprintf(stderr, "can't size %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	mem = mmap(NULL, p->size, PROT_READ | PROT_WRITE, MAP_SHARED, p->fd, 0);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "can't map %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	p->hdr = mem;
+	p->entries = (struct iot_publish_entry *)(p->hdr + 1);
+
+	memset(mem, 0, p->size);
+	for (i = 0; i < p->nregs; i++) {
+		p->entries[i].status = -ENODATA;
+		p->entries[i].addr = p->refs[i].addr;
+		memcpy(p->entries[i].dev, p->refs[i].dev,
+		       sizeof(p->entries[i].dev));
+		p->entries[i].space = p->refs[i].spec.space;
+		p->entries[i].width = p->refs[i].spec.width;
+	}
+	p->hdr->version = IOT_PUBLISH_VERSION;
+	p->hdr->entry_size = sizeof(*p->entries);
+	p->hdr->count = p->nregs;
+	p->hdr->generation = generation;
+	p->hdr->pid = getpid();
+	p->hdr->interval_ns = interval_ns;
+
+	/* Readers may use the header as soon as they see the magic. */
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(p->hdr->magic, IOT_PUBLISH_MAGIC, sizeof(IOT_PUBLISH_MAGIC));
+
+	return 0;
+}
+
+static void
+publish_entry(struct iot_publish_entry *e, const struct iot_access *acc,
+              uint64_t now)
+{
+	uint32_t seq;
+
+	seq = e->seq;
+	__atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (acc->status == 0) {
+		__atomic_store_n(&e->value, acc->value, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&e->timestamp_ns, now, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->status, acc->status, __ATOMIC_RELAXED);
+	__atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void
+run_publisher(struct publisher *p, uint64_t interval_ns, uint64_t duration_ns)
+{
+	struct sigaction sa, old_int, old_term;
+	uint64_t start, deadline, now;
+	int i;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = publish_signal;
+	sigemptyset(&sa.sa_mask);
+	publish_stop = 0;
+	sigaction(SIGINT, &sa, &old_int);
+	sigaction(SIGTERM, &sa, &old_term);
+
+	start = deadline = deadline_now_ns();
+	while (!publish_stop) {
+		/* All registers are read as one batch, so that entries are
+		 * only locked for as long as it takes to store them. */
+		iot_read_batch(p->h, p->acc, p->nregs);
+		now = deadline_now_ns();
+		for (i = 0; i < p->nregs; i++) {
+			publish_entry(&p->entries[i], &p->acc[i], now);
+		}
+		__atomic_store_n(&p->hdr->update_ns, now, __ATOMIC_RELAXED);
+		__atomic_store_n(&p->hdr->updates, p->hdr->updates + 1,
+		                 __ATOMIC_RELEASE);
+
+		if (duration_ns != 0 && now - start >= duration_ns) {
+			break;
+		}
+		/* Passes that ran late are dropped rather than caught up. */
+		deadline += interval_ns;
+		if (deadline < now) {
+			deadline = now;
+		}
+		wait_until_deadline_or(deadline, &publish_stop);
+	}
+
+	__atomic_store_n(&p->hdr->pid, 0, __ATOMIC_RELEASE);
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+}
+
+static int
+publish(int argc, const char *argv[], const struct cmd_info *info)
+{
+	struct publisher p;
+	uint64_t interval = DEFAULT_PUBLISH_INTERVAL_NS, duration = 0;
+	int arg = 1, i, rc = -1;
+
+	memset(&p, 0, sizeof(p));
+	p.fd = -1;
+	p.refs = calloc(MAX_PUBLISH_REGS, sizeof(*p.refs));
+	if (p.refs == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	for (; arg < argc && argv[arg][0] == '-'; arg += 2) {
+		if (arg + 1 == argc) {
+			goto usage;
+		}
+		if (!strcmp(argv[arg], "-i") || !strcmp(argv[arg], "-d")) {
+			if (parse_duration(argv[arg + 1], argv[arg][1] == 'i' ?
+			                   &interval : &duration) < 0 ||
+			    (argv[arg][1] == 'i' && interval == 0)) {
+				fprintf(stderr, "bad duration '%s'\n",
+				        argv[arg + 1]);
+				goto done;
+			}
+		} else if (!strcmp(argv[arg], "-f")) {
+			if (parse_reg_ref_file(argv[arg + 1], p.refs, &p.nregs,
+			                       MAX_PUBLISH_REGS) < 0) {
+				goto done;
+			}
+		} else {
+			goto usage;
+		}
+	}
+	if (arg == argc) {
+		goto usage;
+	}
+	if (parse_reg_refs(argc - arg - 1, &argv[arg + 1], p.refs, &p.nregs,
+	                   MAX_PUBLISH_REGS) < 0) {
+		goto done;
+	}
+	if (p.nregs == 0) {
+		goto usage;
+	}
+
+	p.h = calloc(p.nregs, sizeof(*p.h));
+	p.acc = calloc(p.nregs, sizeof(*p.acc));
+	if (p.h == NULL || p.acc == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto done;
+	}
+	for (i = 0; i < p.nregs; i++) {
+		p.acc[i].addr = p.refs[i].addr;
+		p.acc[i].width = p.refs[i].spec.width;
+		p.h[i] = handle_set_get(&p.handles, p.refs[i].spec.space,
+		                        p.refs[i].dev, IOT_RDONLY);
+		if (p.h[i] == NULL) {
+			fprintf(stderr, "can't open %s device: %s\n",
+			        p.refs[i].name, strerror(errno));
+			goto done;
+		}
+	}
+	if (p.handles.recycled) {
+		fprintf(stderr, "at most %d devices can be published\n",
+		        HANDLE_SET_SIZE);
+		goto done;
+	}
+
+	if (create_segment(&p, argv[arg], interval) < 0) {
+		goto done;
+	}
+	run_publisher(&p, interval, duration);
+	rc = 0;
+	goto done;
+
+usage:
+	fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+done:
+	if (p.hdr != NULL) {
+		munmap(p.hdr, p.size);
+	}
+	if (p.fd >= 0) {
+		close(p.fd);
+	}
+	handle_set_release(&p.handles);
+	free(p.h);
+	free(p.acc);
+	free(p.refs);
+	return rc;
+}
+
+static int
+publish_read(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct iot_publish_header *hdr;
+	const struct iot_publish_entry *e;
+	struct stat st;
+	char path[NAME_MAX], buf[160];
+	uint64_t value, ts, now;
+	int fd, ndev, len, status, i, j, rc = -1;
+	void *mem;
+
+	if (shm_name(argv[1], path, sizeof(path)) < 0) {
+		return -1;
+	}
+	fd = shm_open(path, O_RDONLY, 0);
+	if (fd < 0) {
+		fprintf(stderr, "can't open shared memory %s: %s\n", path,
+		        strerror(errno));
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		fprintf(stderr, "%s is not being published\n", path);
+		close(fd);
+		return -1;
+	}
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		fprintf(stderr, "can't map %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	hdr = mem;
+	if (memcmp(hdr->magic, IOT_PUBLISH_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != IOT_PUBLISH_VERSION ||
+	    hdr->entry_size != sizeof(*e) ||
+	    sizeof(*hdr) + (uint64_t)hdr->count * sizeof(*e) > st.st_size) {
+		fprintf(stderr, "%s is not being published\n", path);
+		goto out;
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&hdr->pid, __ATOMIC_RELAXED) == 0) {
+		fprintf(stderr, "warning: the publisher of %s has stopped\n",
+		        path);
+	}
+
+	now = deadline_now_ns();
+	e = (const struct iot_publish_entry *)(hdr + 1);
+	for (i = 0; i < hdr->count; i++, e++) {
+		status = iot_publish_load(e, &value, &ts);
+		if (e->space >= IOT_SPACE_MAX) {
+			continue;
+		}
+		ndev = iot_space_info(e->space)->ndev;
+
+		if (output_get_format() != OUTPUT_TEXT) {
+			if (status == 0) {
+				output_record(e->space, e->dev, ndev, e->addr,
+				              e->width, value, 0);
+			}
+			continue;
+		}
+
+		len = snprintf(buf, sizeof(buf), "%s", iot_space_name(e->space));
+		for (j = 0; j < ndev; j++) {
+			len += snprintf(&buf[len], sizeof(buf) - len, "%c%x",
+			                j ? ':' : ' ', e->dev[j]);
+		}
+		snprintf(&buf[len], sizeof(buf) - len, " 0x%llx %d ",
+		         (unsigned long long)e->addr, e->width);
+		output_str(buf);
+		if (status != 0) {
+			output_str(strerror(-status));
+		} else {
+			output_hex(value, e->width / 4, 0);
+			snprintf(buf, sizeof(buf), " %lluus",
+			         (unsigned long long)(now > ts ?
+			                              (now - ts) / 1000 : 0));
+			output_str(buf);
+		}
+		output_char('\n');
+	}
+	rc = 0;
+
+out:
+	munmap(mem, st.st_size);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(publish_params, 2, INT_MAX,
+                            "[-i interval] [-d duration] [-f file] <name> "
+                            "[<type> [dev ...] <addr> ...]", 0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(publish_read_params, 2, "<name>", 0);
+
+static const struct cmd_info publish_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(publish, publish, NULL, &publish_params),
+	MAKE_CMD_WITH_PARAMS(publish_read, publish_read, NULL,
+	                     &publish_read_params),
+};
+
+MAKE_CMD_GROUP(PUBLISH, "commands to share register values in memory",
+               publish_cmds);
+REGISTER_CMD_GROUP(PUBLISH);
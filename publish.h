@@ -0,0 +1,97 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _PUBLISH_H_
+#define _PUBLISH_H_
+
+/*
+ * Shared memory layout written by "iotools publish".
+ *
+ * The publisher reads a set of registers at a fixed interval and stores the
+ * latest value of each in a POSIX shared memory object, which any number of
+ * local processes can map read only. A struct iot_publish_header is
+ * followed by count entries, one per register, in the order they were
+ * configured. Each entry is guarded by a sequence lock: the publisher makes
+ * seq odd while it updates the entry and even again when it is done, so a
+ * reader copies the entry and retries if seq was odd or changed meanwhile.
+ * Readers never block the publisher and need no system calls, see
+ * iot_publish_load().
+ *
+ * The header is valid once magic is set. The layout only changes when a
+ * publisher is started with a different register set, which also changes
+ * generation; long running readers should compare generation now and then
+ * and map the object again when it differs. pid is 0 once the publisher has
+ * stopped. All fields are in host byte order.
+ */
+
+#include <stdint.h>
+#include "libiotools.h"
+
+#define IOT_PUBLISH_MAGIC "IOTPUBL"
+#define IOT_PUBLISH_VERSION 1
+
+struct iot_publish_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t count;
+	uint32_t generation;    /* bumped on every publisher start */
+	uint32_t pid;           /* of the publisher, 0 when it has stopped */
+	uint32_t reserved0;
+	uint64_t interval_ns;
+	uint64_t updates;       /* completed passes over all entries */
+	uint64_t update_ns;     /* CLOCK_MONOTONIC at the last pass */
+	uint8_t reserved[8];
+};
+
+/* One cache line, so that entries never share one. */
+struct iot_publish_entry {
+	uint32_t seq;
+	int32_t status;         /* 0 or negative errno of the last read */
+	uint64_t value;         /* last value read successfully */
+	uint64_t timestamp_ns;  /* CLOCK_MONOTONIC of the last read */
+	uint64_t addr;
+	uint32_t dev[IOT_MAX_DEV_ARGS];
+	uint8_t space;          /* enum iot_space */
+	uint8_t width;
+	uint8_t reserved[14];
+};
+
+/* Copy a consistent value, timestamp and status out of e. Returns status. */
+static inline int
+iot_publish_load(const struct iot_publish_entry *e, uint64_t *value,
+                 uint64_t *timestamp_ns)
+{
+	uint32_t seq;
+	int status;
+
+	for (;;) {
+		seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+		*value = __atomic_load_n(&e->value, __ATOMIC_RELAXED);
+		*timestamp_ns = __atomic_load_n(&e->timestamp_ns,
+		                                __ATOMIC_RELAXED);
+		status = __atomic_load_n(&e->status, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == seq)
+			return status;
+	}
+}
+
+#endif /* _PUBLISH_H_ */
@@ -0,0 +1,813 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Register maps: compiling map files into their index, caching the index
+ * and looking registers up by name and by address. See regmap.h.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "output.h"
+#include "regmap.h"
+
+#define MAX_MAP_LINE 1024
+#define MAX_MAP_ARGS 8
+/* Most addresses a register covers: 8 bytes of a 64 bit register. */
+#define MAX_EXTENT 8
+
+/* The loaded map, mapped from the cache or compiled in memory. */
+static const struct iot_regmap_header *map;
+static size_t map_size;
+static int map_mapped;
+static const struct iot_regmap_reg *map_regs;
+static const uint32_t *map_buckets;
+static const struct iot_regmap_field *map_fields;
+static const char *map_strings;
+
+/* A map being compiled. */
+struct regmap_build {
+	struct iot_regmap_reg *regs;
+	uint32_t nregs;
+	uint32_t regs_size;
+	struct iot_regmap_field *fields;
+	uint32_t nfields;
+	uint32_t fields_size;
+	char *strings;
+	uint32_t strings_len;
+	uint32_t strings_size;
+};
+
+static uint32_t
+name_hash(const char *s)
+{
+	uint32_t h = 2166136261U;
+
+	while (*s != '\0') {
+		h ^= (uint8_t)*s++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static uint64_t
+path_hash(const char *s)
+{
+	uint64_t h = 14695981039346656037ULL;
+
+	while (*s != '\0') {
+		h ^= (uint8_t)*s++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+/* Addresses an access of width bits covers. MSRs and SCOMs are numbered,
+ * everything else is byte addressed. */
+static int
+addr_extent(enum iot_space space, int width)
+{
+	return (space == IOT_SPACE_MSR || space == IOT_SPACE_SCOM) ?
+		1 : width / 8;
+}
+
+/* Make room for one more of n elements of elem_size bytes in *array. */
+static int
+grow(void *array, uint32_t n, uint32_t *size, size_t elem_size)
+{
+	void *p;
+
+	if (n < *size) {
+		return 0;
+	}
+	*size = *size ? *size * 2 : 256;
+	p = realloc(*(void **)array, (size_t)*size * elem_size);
+	if (p == NULL) {
+		return -1;
+	}
+	*(void **)array = p;
+	return 0;
+}
+
+static int
+add_string(struct regmap_build *b, const char *s, uint32_t *offset)
+{
+	size_t len = strlen(s) + 1;
+
+	while (b->strings_len + len > b->strings_size) {
+		if (grow(&b->strings, b->strings_size, &b->strings_size, 1) < 0) {
+			return -1;
+		}
+	}
+	memcpy(b->strings + b->strings_len, s, len);
+	*offset = b->strings_len;
+	b->strings_len += len;
+	return 0;
+}
+
+static void
+free_build(struct regmap_build *b)
+{
+	free(b->regs);
+	free(b->fields);
+	free(b->strings);
+}
+
+static int
+valid_name(const char *name)
+{
+	if (!isalpha((unsigned char)*name) && *name != '_') {
+		return 0;
+	}
+	for (; *name != '\0'; name++) {
+		if (!isalnum((unsigned char)*name) && *name != '_' &&
+		    *name != '.') {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* Parse <msb>:<lsb> or a single bit of a register width bits wide. */
+static int
+parse_bits(const char *arg, int width, struct iot_regmap_field *f)
+{
+	unsigned long msb, lsb;
+	char *end;
+
+	msb = lsb = strtoul(arg, &end, 0);
+	if (end == arg) {
+		return -1;
+	}
+	if (*end == ':') {
+		arg = end + 1;
+		lsb = strtoul(arg, &end, 0);
+		if (end == arg) {
+			return -1;
+		}
+	}
+	if (*end != '\0' || lsb > msb || msb >= width) {
+		return -1;
+	}
+	f->msb = msb;
+	f->lsb = lsb;
+	return 0;
+}
+
+static int
+add_register(struct regmap_build *b, int argc, const char *argv[],
+             const char **err)
+{
+	struct iot_regmap_reg *r;
+	struct reg_spec spec;
+	char *end;
+
+	if (argc != 3) {
+		*err = "expected <name> <type> <address>";
+		return -1;
+	}
+	if (!valid_name(argv[0])) {
+		*err = "register names start with a letter or _";
+		return -1;
+	}
+	if (parse_reg_spec(argv[1], &spec) < 0) {
+		*err = "unknown register type";
+		return -1;
+	}
+	if (grow(&b->regs, b->nregs, &b->regs_size, sizeof(*b->regs)) < 0) {
+		*err = "out of memory";
+		return -1;
+	}
+
+	r = &b->regs[b->nregs];
+	memset(r, 0, sizeof(*r));
+	r->addr = strtoull(argv[2], &end, 0);
+	if (end == argv[2] || *end != '\0') {
+		*err = "bad address";
+		return -1;
+	}
+	if (add_string(b, argv[0], &r->name) < 0) {
+		*err = "out of memory";
+		return -1;
+	}
+	r->first_field = b->nfields;
+	r->space = spec.space;
+	r->width = spec.width;
+	r->extent = spec.addr_step;
+	b->nregs++;
+	return 0;
+}
+
+static int
+add_field(struct regmap_build *b, int argc, const char *argv[],
+          const char **err)
+{
+	struct iot_regmap_reg *r;
+	struct iot_regmap_field *f;
+
+	if (b->nregs == 0) {
+		*err = "field outside of a register";
+		return -1;
+	}
+	r = &b->regs[b->nregs - 1];
+	if (argc != 2) {
+		*err = "expected <field> <msb>:<lsb>";
+		return -1;
+	}
+	if (!valid_name(argv[0])) {
+		*err = "field names start with a letter or _";
+		return -1;
+	}
+	if (r->nfields == UINT16_MAX) {
+		*err = "too many fields";
+		return -1;
+	}
+	if (grow(&b->fields, b->nfields, &b->fields_size,
+	         sizeof(*b->fields)) < 0) {
+		*err = "out of memory";
+		return -1;
+	}
+
+	f = &b->fields[b->nfields];
+	memset(f, 0, sizeof(*f));
+	if (parse_bits(argv[1], r->width, f) < 0) {
+		*err = "bad bit range";
+		return -1;
+	}
+	if (add_string(b, argv[0], &f->name) < 0) {
+		*err = "out of memory";
+		return -1;
+	}
+	r->nfields++;
+	b->nfields++;
+	return 0;
+}
+
+static int
+parse_map(const char *path, struct regmap_build *b)
+{
+	const char *argv[MAX_MAP_ARGS + 1];
+	char line[MAX_MAP_LINE];
+	const char *err = NULL;
+	int argc, indented, lineno = 0, rc = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		indented = (line[0] == ' ' || line[0] == '\t');
+		argc = split_args(line, argv, MAX_MAP_ARGS);
+		if (argc == 0) {
+			continue;
+		}
+		if (argc < 0) {
+			err = "too many words";
+		} else if (indented) {
+			add_field(b, argc, argv, &err);
+		} else {
+			add_register(b, argc, argv, &err);
+		}
+		if (err != NULL) {
+			fprintf(stderr, "%s:%d: %s\n", path, lineno, err);
+			rc = -1;
+			break;
+		}
+	}
+	fclose(f);
+
+	return rc;
+}
+
+static int
+compare_regs(const void *a, const void *b)
+{
+	const struct iot_regmap_reg *ra = a, *rb = b;
+
+	if (ra->space != rb->space) {
+		return ra->space < rb->space ? -1 : 1;
+	}
+	if (ra->addr != rb->addr) {
+		return ra->addr < rb->addr ? -1 : 1;
+	}
+	return (int)ra->width - (int)rb->width;
+}
+
+/* Lay the compiled map out as an index image. */
+static void *
+build_index(const char *path, struct regmap_build *b, const struct stat *st,
+            size_t *size)
+{
+	struct iot_regmap_header *hdr;
+	struct iot_regmap_reg *regs;
+	uint32_t *buckets;
+	uint32_t nbuckets, i, j, slot;
+	char *image, *strings;
+
+	qsort(b->regs, b->nregs, sizeof(*b->regs), compare_regs);
+	for (nbuckets = 1; nbuckets < 2 * b->nregs; nbuckets <<= 1)
+		;
+
+	*size = sizeof(*hdr) + (size_t)b->nregs * sizeof(*regs) +
+		(size_t)nbuckets * sizeof(*buckets) +
+		(size_t)b->nfields * sizeof(*b->fields) + b->strings_len;
+	image = calloc(1, *size);
+	if (image == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return NULL;
+	}
+
+	hdr = (struct iot_regmap_header *)image;
+	memcpy(hdr->magic, IOT_REGMAP_MAGIC, sizeof(hdr->magic));
+	hdr->version = IOT_REGMAP_VERSION;
+	hdr->nregs = b->nregs;
+	hdr->nbuckets = nbuckets;
+	hdr->nfields = b->nfields;
+	hdr->strings_size = b->strings_len;
+	hdr->src_size = st->st_size;
+	hdr->src_mtime_ns = st->st_mtim.tv_sec * 1000000000ULL +
+		st->st_mtim.tv_nsec;
+	hdr->src_ino = st->st_ino;
+
+	regs = (struct iot_regmap_reg *)(hdr + 1);
+	buckets = (uint32_t *)(regs + b->nregs);
+	memcpy(regs, b->regs, (size_t)b->nregs * sizeof(*regs));
+	memcpy(buckets + nbuckets, b->fields,
+	       (size_t)b->nfields * sizeof(*b->fields));
+	strings = (char *)buckets + (size_t)nbuckets * sizeof(*buckets) +
+		(size_t)b->nfields * sizeof(*b->fields);
+	memcpy(strings, b->strings, b->strings_len);
+
+	for (i = 0; i < nbuckets; i++) {
+		buckets[i] = IOT_REGMAP_NONE;
+	}
+	for (i = 0; i < b->nregs; i++) {
+		regs[i].hash = name_hash(strings + regs[i].name);
+		slot = regs[i].hash & (nbuckets - 1);
+		for (j = buckets[slot]; j != IOT_REGMAP_NONE; j = regs[j].next) {
+			if (regs[j].hash == regs[i].hash &&
+			    !strcmp(strings + regs[j].name,
+			            strings + regs[i].name)) {
+				fprintf(stderr, "%s: register %s is defined "
+				        "twice\n", path, strings + regs[i].name);
+				free(image);
+				return NULL;
+			}
+		}
+		regs[i].next = buckets[slot];
+		buckets[slot] = i;
+	}
+
+	return image;
+}
+
+static void
+unload_map(void)
+{
+	if (map == NULL) {
+		return;
+	}
+	if (map_mapped) {
+		munmap((void *)map, map_size);
+	} else {
+		free((void *)map);
+	}
+	map = NULL;
+}
+
+static void
+set_map(const void *image, size_t size, int mapped)
+{
+	unload_map();
+	map = image;
+	map_size = size;
+	map_mapped = mapped;
+	map_regs = (const struct iot_regmap_reg *)(map + 1);
+	map_buckets = (const uint32_t *)(map_regs + map->nregs);
+	map_fields = (const struct iot_regmap_field *)(map_buckets +
+	                                               map->nbuckets);
+	map_strings = (const char *)(map_fields + map->nfields);
+}
+
+/* Name the cached index of the map at path. */
+static int
+cache_path(const char *path, char *buf, size_t size)
+{
+	char real[PATH_MAX], dir[PATH_MAX];
+	const char *env;
+
+	if (realpath(path, real) == NULL) {
+		return -1;
+	}
+	env = getenv("XDG_CACHE_HOME");
+	if (env != NULL && *env != '\0') {
+		snprintf(dir, sizeof(dir), "%s", env);
+	} else {
+		env = getenv("HOME");
+		if (env == NULL || *env == '\0') {
+			return -1;
+		}
+		snprintf(dir, sizeof(dir), "%s/.cache", env);
+	}
+	mkdir(dir, 0755);
+	strncat(dir, "/iotools", sizeof(dir) - strlen(dir) - 1);
+	mkdir(dir, 0755);
+
+	snprintf(buf, size, "%s/%s-%016llx.idx", dir, strrchr(real, '/') + 1,
+	         (unsigned long long)path_hash(real));
+	return 0;
+}
+
+/* Whether the offsets and counts of an index whose size matches its header
+ * stay within it, so that a corrupt cache is compiled anew instead of
+ * crashing a lookup. Hash chains must lead to lower registers, as
+ * build_index() links them, which also rules out loops. */
+static int
+check_index(const struct iot_regmap_header *hdr)
+{
+	const struct iot_regmap_reg *regs;
+	const struct iot_regmap_field *fields;
+	const uint32_t *buckets;
+	const char *strings;
+	uint32_t i;
+
+	regs = (const struct iot_regmap_reg *)(hdr + 1);
+	buckets = (const uint32_t *)(regs + hdr->nregs);
+	fields = (const struct iot_regmap_field *)(buckets + hdr->nbuckets);
+	strings = (const char *)(fields + hdr->nfields);
+
+	if (hdr->nbuckets == 0 || (hdr->nbuckets & (hdr->nbuckets - 1)) ||
+	    (hdr->strings_size && strings[hdr->strings_size - 1] != '\0')) {
+		return -1;
+	}
+	for (i = 0; i < hdr->nbuckets; i++) {
+		if (buckets[i] != IOT_REGMAP_NONE && buckets[i] >= hdr->nregs) {
+			return -1;
+		}
+	}
+	for (i = 0; i < hdr->nregs; i++) {
+		if ((regs[i].next != IOT_REGMAP_NONE && regs[i].next >= i) ||
+		    regs[i].name >= hdr->strings_size ||
+		    regs[i].space >= IOT_SPACE_MAX || regs[i].width > 64 ||
+		    (uint64_t)regs[i].first_field + regs[i].nfields >
+		    hdr->nfields) {
+			return -1;
+		}
+	}
+	for (i = 0; i < hdr->nfields; i++) {
+		if (fields[i].name >= hdr->strings_size ||
+		    fields[i].lsb > fields[i].msb || fields[i].msb >= 64) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* Map the cached index if it was compiled from the map as it is now and
+ * holds together. */
+static int
+load_cached(const char *cache, const struct stat *src)
+{
+	const struct iot_regmap_header *hdr;
+	struct stat st;
+	void *mem;
+	int fd;
+
+	fd = open(cache, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(*hdr)) {
+		close(fd);
+		return -1;
+	}
+	mem = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		return -1;
+	}
+
+	hdr = mem;
+	if (memcmp(hdr->magic, IOT_REGMAP_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->version != IOT_REGMAP_VERSION ||
+	    hdr->src_size != src->st_size ||
+	    hdr->src_mtime_ns != src->st_mtim.tv_sec * 1000000000ULL +
+	                         src->st_mtim.tv_nsec ||
+	    hdr->src_ino != src->st_ino ||
+	    sizeof(*hdr) + (uint64_t)hdr->nregs * sizeof(*map_regs) +
+	    (uint64_t)hdr->nbuckets * sizeof(*map_buckets) +
+	    (uint64_t)hdr->nfields * sizeof(*map_fields) +
+	    hdr->strings_size != st.st_size || check_index(hdr) < 0) {
+		munmap(mem, st.st_size);
+		return -1;
+	}
+
+	set_map(mem, st.st_size, 1);
+	return 0;
+}
+
+/* Store the index for later runs. The cache is only an optimization, so
+ * failures are ignored. */
+static void
+write_cache(const char *cache, const void *image, size_t size)
+{
+	char tmp[PATH_MAX + 16];
+	ssize_t r;
+	size_t done;
+	int fd;
+
+	snprintf(tmp, sizeof(tmp), "%s.%d", cache, (int)getpid());
+	fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		return;
+	}
+	for (done = 0; done < size; done += r) {
+		r = write(fd, (const char *)image + done, size - done);
+		if (r <= 0) {
+			close(fd);
+			unlink(tmp);
+			return;
+		}
+	}
+	if (close(fd) < 0 || rename(tmp, cache) < 0) {
+		unlink(tmp);
+	}
+}
+
+int
+regmap_load(const char *path)
+{
+	struct regmap_build b;
+	char cache[PATH_MAX];
+	struct stat st;
+	int cached;
+	void *image;
+	size_t size;
+
+	if (stat(path, &st) < 0) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	cached = (cache_path(path, cache, sizeof(cache)) == 0);
+	if (cached && load_cached(cache, &st) == 0) {
+		return 0;
+	}
+
+	memset(&b, 0, sizeof(b));
+	if (parse_map(path, &b) < 0) {
+		free_build(&b);
+		return -1;
+	}
+	image = build_index(path, &b, &st, &size);
+	free_build(&b);
+	if (image == NULL) {
+		return -1;
+	}
+	if (cached) {
+		write_cache(cache, image, size);
+	}
+	set_map(image, size, 0);
+
+	return 0;
+}
+
+static const struct iot_regmap_reg *
+lookup_name(const char *name)
+{
+	uint32_t h = name_hash(name);
+	uint32_t i;
+
+	for (i = map_buckets[h & (map->nbuckets - 1)]; i != IOT_REGMAP_NONE;
+	     i = map_regs[i].next) {
+		if (map_regs[i].hash == h &&
+		    !strcmp(map_strings + map_regs[i].name, name)) {
+			return &map_regs[i];
+		}
+	}
+	return NULL;
+}
+
+int
+parse_reg_addr(enum iot_space space, const char *arg, uint64_t *addr)
+{
+	const struct iot_regmap_reg *r;
+	char *end;
+
+	if (!isalpha((unsigned char)*arg) && *arg != '_') {
+		errno = 0;
+		*addr = strtoull(arg, &end, 0);
+		if (end == arg || *end != '\0' || errno) {
+			fprintf(stderr, "invalid register address '%s'\n", arg);
+			return -1;
+		}
+		return 0;
+	}
+	if (map == NULL) {
+		fprintf(stderr, "%s: no register map is loaded, see --regmap\n",
+		        arg);
+		return -1;
+	}
+	r = lookup_name(arg);
+	if (r == NULL) {
+		fprintf(stderr, "unknown register %s\n", arg);
+		return -1;
+	}
+	if (r->space != space) {
+		fprintf(stderr, "%s is a register in %s space\n", arg,
+		        iot_space_name(r->space));
+		return -1;
+	}
+	*addr = r->addr;
+	return 0;
+}
+
+static void
+print_field(const struct iot_regmap_reg *r, const char *field, int lsb,
+            int bits, uint64_t value)
+{
+	uint64_t mask = bits < 64 ? (1ULL << bits) - 1 : ~0ULL;
+
+	output_str("  ");
+	output_str(map_strings + r->name);
+	if (field != NULL) {
+		output_char('.');
+		output_str(field);
+	}
+	output_str(" = ");
+	output_hex((value >> lsb) & mask, (bits + 3) / 4, 0);
+	output_char('\n');
+}
+
+/* Print the fields of r that lie within value, which was read at addr. */
+static void
+print_reg_fields(const struct iot_regmap_reg *r, uint64_t addr, int width,
+                 uint64_t value)
+{
+	const struct iot_regmap_field *f;
+	int64_t base = ((int64_t)r->addr - (int64_t)addr) * 8;
+	int i;
+
+	if (r->nfields == 0) {
+		if (base >= 0 && base + r->width <= width) {
+			print_field(r, NULL, base, r->width, value);
+		}
+		return;
+	}
+	for (i = 0; i < r->nfields; i++) {
+		f = &map_fields[r->first_field + i];
+		if (base + f->lsb < 0 || base + f->msb >= width) {
+			continue;
+		}
+		print_field(r, map_strings + f->name, base + f->lsb,
+		            f->msb - f->lsb + 1, value);
+	}
+}
+
+void
+regmap_print_fields(enum iot_space space, uint64_t addr, int width,
+                    uint64_t value)
+{
+	const struct iot_regmap_reg *r;
+	uint64_t first, extent;
+	uint32_t lo, hi, mid;
+
+	if (map == NULL || output_get_format() != OUTPUT_TEXT) {
+		return;
+	}
+
+	/* Registers that start up to MAX_EXTENT - 1 addresses earlier may
+	 * still cover addr. */
+	first = addr > MAX_EXTENT - 1 ? addr - (MAX_EXTENT - 1) : 0;
+	lo = 0;
+	hi = map->nregs;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		r = &map_regs[mid];
+		if (r->space < space || (r->space == space && r->addr < first)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	extent = addr_extent(space, width);
+	for (; lo < map->nregs; lo++) {
+		r = &map_regs[lo];
+		if (r->space != space ||
+		    (r->addr >= addr && r->addr - addr >= extent)) {
+			break;
+		}
+		if (r->addr + r->extent > addr) {
+			print_reg_fields(r, addr, width, value);
+		}
+	}
+}
+
+static const struct iot_regmap_reg *
+find_register(const char *name)
+{
+	const struct iot_regmap_reg *r;
+
+	if (map == NULL) {
+		fprintf(stderr, "no register map is loaded, see --regmap\n");
+		return NULL;
+	}
+	r = lookup_name(name);
+	if (r == NULL) {
+		fprintf(stderr, "unknown register %s\n", name);
+	}
+	return r;
+}
+
+static int
+reg_info(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct iot_space_info *si;
+	const struct iot_regmap_field *f;
+	const struct iot_regmap_reg *r;
+	int i;
+
+	r = find_register(argv[1]);
+	if (r == NULL) {
+		return -1;
+	}
+
+	si = iot_space_info(r->space);
+	output_str(map_strings + r->name);
+	output_char(' ');
+	output_str(si->name);
+	if (si->min_width != si->max_width) {
+		output_dec(r->width);
+	}
+	output_char(' ');
+	output_hex(r->addr, 0, 0);
+	output_char('\n');
+
+	for (i = 0; i < r->nfields; i++) {
+		f = &map_fields[r->first_field + i];
+		output_str("  ");
+		output_str(map_strings + f->name);
+		output_char(' ');
+		output_dec(f->msb);
+		if (f->msb != f->lsb) {
+			output_char(':');
+			output_dec(f->lsb);
+		}
+		output_char('\n');
+	}
+
+	return 0;
+}
+
+static int
+reg_decode(int argc, const char *argv[], const struct cmd_info *info)
+{
+	const struct iot_regmap_reg *r;
+
+	r = find_register(argv[1]);
+	if (r == NULL) {
+		return -1;
+	}
+	print_reg_fields(r, r->addr, r->width, strtoull(argv[2], NULL, 0));
+
+	return 0;
+}
+
+MAKE_PREREQ_PARAMS_FIXED_ARGS(info_params, 2, "<register>", 0);
+MAKE_PREREQ_PARAMS_FIXED_ARGS(decode_params, 3, "<register> <value>", 0);
+
+static const struct cmd_info regmap_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(reg_info, &reg_info, NULL, &info_params),
+	MAKE_CMD_WITH_PARAMS(reg_decode, &reg_decode, NULL, &decode_params),
+};
+
+MAKE_CMD_GROUP(REGMAP, "commands to look up registers in a register map",
+               regmap_cmds);
+REGISTER_CMD_GROUP(REGMAP);
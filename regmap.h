@@ -0,0 +1,101 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _REGMAP_H_
+#define _REGMAP_H_
+
+/*
+ * Register maps.
+ *
+ * A register map file names registers and their bit fields, one register
+ * per line followed by indented lines for its fields:
+ *
+ *	PCIE_LINKSTA pci16 0x52
+ *		SPEED 3:0
+ *		WIDTH 9:4
+ *		TRAINING 11
+ *
+ * The second word is a register spec as scripts use them (pci16, mmio32,
+ * msr, ...), the third the address; fields give their bits as <msb>:<lsb>
+ * or a single bit. # starts a comment. Register names must not start with
+ * a digit, so they can stand in for addresses on the command line.
+ *
+ * Maps are compiled into the index below, which is cached on disk and
+ * mapped, so that loading a map costs a stat() and an mmap() however large
+ * it is. A struct iot_regmap_header is followed by the registers, sorted by
+ * space and address for lookups by address, the hash buckets for lookups by
+ * name, the fields of every register in turn and finally the names. All
+ * fields are in host byte order.
+ */
+
+#include <stdint.h>
+#include "libiotools.h"
+
+#define IOT_REGMAP_MAGIC "IOTREGS"
+#define IOT_REGMAP_VERSION 1
+
+#define IOT_REGMAP_NONE 0xffffffffU
+
+struct iot_regmap_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t nregs;
+	uint32_t nbuckets;       /* a power of two */
+	uint32_t nfields;
+	uint32_t strings_size;
+	uint32_t reserved;
+	/* The map file the index was compiled from. */
+	uint64_t src_size;
+	uint64_t src_mtime_ns;
+	uint64_t src_ino;
+};
+
+struct iot_regmap_reg {
+	uint64_t addr;
+	uint32_t name;           /* offset of the name in the strings */
+	uint32_t hash;           /* FNV-1a of the name */
+	uint32_t next;           /* next register in the hash chain */
+	uint32_t first_field;
+	uint16_t nfields;
+	uint8_t space;           /* enum iot_space */
+	uint8_t width;
+	uint8_t extent;          /* addresses the register covers */
+	uint8_t reserved[3];
+};
+
+struct iot_regmap_field {
+	uint32_t name;
+	uint8_t lsb;
+	uint8_t msb;
+	uint8_t reserved[2];
+};
+
+/* Load the map at path, compiling it unless an up to date index is cached
+ * in $XDG_CACHE_HOME/iotools (~/.cache/iotools). Errors are printed. */
+int regmap_load(const char *path);
+
+/* Parse a register address for space: a number, or the name of a register
+ * of that space in the loaded map. Errors are printed. */
+int parse_reg_addr(enum iot_space space, const char *arg, uint64_t *addr);
+
+/* Print the fields of the registers a read of width bits at addr covered,
+ * in text output; nothing if the map does not describe them. */
+void regmap_print_fields(enum iot_space space, uint64_t addr, int width,
+                         uint64_t value);
+
+#endif /* _REGMAP_H_ */
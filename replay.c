@@ -0,0 +1,318 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Trace replay.
+ *
+ * "replay [-t] [-c] <trace>" re-executes the accesses recorded in a trace
+ * (see --trace and iot_trace_start()) in recording order, within this
+ * process and through one handle per device. By default accesses are issued
+ * back to back; -t reproduces the recorded spacing between them instead.
+ * Reads are performed as well, since reading a register can have side
+ * effects; -c compares their results with the recorded values. Accesses that
+ * failed while recording are skipped. "replay -l <trace>" lists the trace.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "commands.h"
+#include "output.h"
+
+struct trace {
+	struct iot_trace_header hdr;
+	struct iot_trace_record *records;  /* oldest first */
+	uint64_t count;
+	double ns_per_tick;                /* 0 if unknown */
+};
+
+static int
+load_trace(const char *path, struct trace *t)
+{
+	struct iot_trace_record *slots;
+	struct stat st;
+	uint64_t first, i;
+	size_t len;
+	int fd;
+
+	memset(t, 0, sizeof(*t));
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fstat(fd, &st) < 0 ||
+	    pread(fd, &t->hdr, sizeof(t->hdr), 0) != sizeof(t->hdr) ||
+	    memcmp(t->hdr.magic, IOT_TRACE_MAGIC, sizeof(t->hdr.magic)) ||
+	    t->hdr.version != IOT_TRACE_VERSION ||
+	    t->hdr.record_size != sizeof(*slots) || t->hdr.capacity == 0 ||
+	    st.st_size != sizeof(t->hdr) + t->hdr.capacity * sizeof(*slots)) {
+		fprintf(stderr, "%s is not an iotools trace\n", path);
+		close(fd);
+		return -1;
+	}
+
+	t->count = t->hdr.written < t->hdr.capacity ?
+	           t->hdr.written : t->hdr.capacity;
+	len = t->count * sizeof(*slots);
+	slots = malloc(len ? len : 1);
+	t->records = malloc(len ? len : 1);
+	if (slots == NULL || t->records == NULL) {
+		fprintf(stderr, "out of memory\n");
+		goto fail;
+	}
+	if (pread(fd, slots, len, sizeof(t->hdr)) != len) {
+		fprintf(stderr, "can't read %s: %s\n", path, strerror(errno));
+		goto fail;
+	}
+	close(fd);
+
+	/* Once the ring has wrapped, the oldest record follows the newest. */
+	first = t->hdr.written > t->hdr.capacity ?
+	        t->hdr.written % t->hdr.capacity : 0;
+	for (i = 0; i < t->count; i++) {
+		t->records[i] = slots[(first + i) % t->hdr.capacity];
+	}
+	free(slots);
+
+	if (t->hdr.end_ticks > t->hdr.start_ticks) {
+		t->ns_per_tick = (double)(t->hdr.end_ns - t->hdr.start_ns) /
+		                 (t->hdr.end_ticks - t->hdr.start_ticks);
+	}
+	return 0;
+
+fail:
+	free(slots);
+	free(t->records);
+	close(fd);
+	return -1;
+}
+
+/* Time of a record relative to the first one. */
+static uint64_t
+record_ns(const struct trace *t, const struct iot_trace_record *rec)
+{
+	uint64_t ticks = rec->ticks - t->records[0].ticks;
+
+	/* Writers stamp records after claiming them and may race. */
+	if (rec->ticks < t->records[0].ticks) {
+		return 0;
+	}
+	return (uint64_t)(ticks * t->ns_per_tick);
+}
+
+static void
+record_dev(const struct iot_trace_record *rec, unsigned int *dev)
+{
+	int i;
+
+	for (i = 0; i < IOT_MAX_DEV_ARGS; i++) {
+		dev[i] = rec->dev[i];
+	}
+}
+
+static int
+list_trace(const struct trace *t)
+{
+	const struct iot_trace_record *rec;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	char buf[128];
+	uint64_t i, ns;
+	int ndev, j, len;
+
+	for (i = 0; i < t->count; i++) {
+		rec = &t->records[i];
+		if (rec->space >= IOT_SPACE_MAX) {
+			continue;
+		}
+		record_dev(rec, dev);
+		ndev = iot_space_info(rec->space)->ndev;
+
+		if (output_get_format() != OUTPUT_TEXT) {
+			if (!(rec->flags & IOT_TRACE_FAILED)) {
+				output_record(rec->space, dev, ndev, rec->addr,
+				              rec->width, rec->value, 0);
+			}
+			continue;
+		}
+
+		ns = record_ns(t, rec);
+		len = snprintf(buf, sizeof(buf), "%llu.%03llu %c %s",
+		               (unsigned long long)(ns / 1000),
+		               (unsigned long long)(ns % 1000),
+		               (rec->flags & IOT_TRACE_WRITE) ? 'W' : 'R',
+		               iot_space_name(rec->space));
+		for (j = 0; j < ndev; j++) {
+			len += snprintf(&buf[len], sizeof(buf) - len, "%c%x",
+			                j ? ':' : ' ', dev[j]);
+		}
+		snprintf(&buf[len], sizeof(buf) - len, " 0x%llx %d ",
+		         (unsigned long long)rec->addr, rec->width);
+		output_str(buf);
+		if (rec->flags & IOT_TRACE_FAILED) {
+			output_str("failed\n");
+		} else {
+			output_hex(rec->value, rec->width / 4, 0);
+			output_char('\n');
+		}
+	}
+
+	return 0;
+}
+
+static int
+replay_trace(const char *path, const struct trace *t, int timed, int check)
+{
+	const struct iot_trace_record *rec;
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	struct handle_set handles;
+	struct iot_handle *h;
+	uint64_t i, start, value, done = 0, skipped = 0, mismatches = 0;
+	int written = 0, rc = 0;
+	char buf[128];
+
+	if (timed && t->ns_per_tick == 0) {
+		fprintf(stderr, "%s has no timing information\n", path);
+		return -1;
+	}
+
+	/* Devices that are written to are opened read-write up front, so each
+	 * device gets a single handle. */
+	for (i = 0; i < t->count; i++) {
+		if (t->records[i].flags & IOT_TRACE_WRITE) {
+			written |= 1 << t->records[i].space;
+		}
+	}
+
+	memset(&handles, 0, sizeof(handles));
+	start = deadline_now_ns();
+	for (i = 0; i < t->count && rc == 0; i++) {
+		rec = &t->records[i];
+		if ((rec->flags & IOT_TRACE_FAILED) ||
+		    rec->space >= IOT_SPACE_MAX) {
+			skipped++;
+			continue;
+		}
+
+		record_dev(rec, dev);
+		h = handle_set_get(&handles, rec->space, dev,
+		                   (written & (1 << rec->space)) ?
+		                   IOT_RDWR : IOT_RDONLY);
+		if (h == NULL) {
+			fprintf(stderr, "record %llu: can't open %s device: %s\n",
+			        (unsigned long long)i,
+			        iot_space_name(rec->space), strerror(errno));
+			rc = -1;
+			break;
+		}
+
+		if (timed) {
+			wait_until_deadline(start + record_ns(t, rec));
+		}
+
+		if (rec->flags & IOT_TRACE_WRITE) {
+			if (iot_write(h, rec->addr, rec->width, rec->value) < 0) {
+				fprintf(stderr, "record %llu: can't write %s "
+				        "register 0x%llx: %s\n",
+				        (unsigned long long)i,
+				        iot_space_name(rec->space),
+				        (unsigned long long)rec->addr,
+				        strerror(errno));
+				rc = -1;
+			}
+		} else if (iot_read(h, rec->addr, rec->width, &value) < 0) {
+			fprintf(stderr, "record %llu: can't read %s register "
+			        "0x%llx: %s\n", (unsigned long long)i,
+			        iot_space_name(rec->space),
+			        (unsigned long long)rec->addr, strerror(errno));
+			rc = -1;
+		} else if (check && value != rec->value) {
+			fprintf(stderr, "record %llu: %s register 0x%llx is "
+			        "0x%llx, recorded 0x%llx\n",
+			        (unsigned long long)i,
+			        iot_space_name(rec->space),
+			        (unsigned long long)rec->addr,
+			        (unsigned long long)value,
+			        (unsigned long long)rec->value);
+			mismatches++;
+		}
+		done++;
+	}
+	handle_set_release(&handles);
+
+	if (rc == 0) {
+		snprintf(buf, sizeof(buf), "replayed %llu accesses in %lluus, "
+		         "skipped %llu, mismatches %llu\n",
+		         (unsigned long long)done,
+		         (unsigned long long)(deadline_now_ns() - start) / 1000,
+		         (unsigned long long)skipped,
+		         (unsigned long long)mismatches);
+		output_str(buf);
+	}
+
+	return (rc < 0 || mismatches) ? -1 : 0;
+}
+
+static int
+replay(int argc, const char *argv[], const struct cmd_info *info)
+{
+	struct trace t;
+	int timed = 0, check = 0, list = 0;
+	int arg, rc;
+
+	for (arg = 1; arg < argc - 1; arg++) {
+		if (!strcmp(argv[arg], "-t")) {
+			timed = 1;
+		} else if (!strcmp(argv[arg], "-c")) {
+			check = 1;
+		} else if (!strcmp(argv[arg], "-l")) {
+			list = 1;
+		} else {
+			fprintf(stderr, "usage: %s %s\n", argv[0],
+			        info->params->usage);
+			return -1;
+		}
+	}
+
+	if (load_trace(argv[arg], &t) < 0) {
+		return -1;
+	}
+	if (list) {
+		rc = list_trace(&t);
+	} else {
+		rc = replay_trace(argv[arg], &t, timed, check);
+	}
+	free(t.records);
+
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(replay_params, 2, 5, "[-t] [-c] [-l] <trace>", 0);
+
+static const struct cmd_info replay_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(replay, replay, NULL, &replay_params),
+};
+
+MAKE_CMD_GROUP(REPLAY, "commands to replay register access traces",
+               replay_cmds);
+REGISTER_CMD_GROUP(REPLAY);
@@ -0,0 +1,294 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Periodic register sampling for the read commands.
+ *
+ * The register's device is opened once and read --repeat times. With an
+ * --interval, sample n is due at start + n * interval: the wait sleeps with
+ * an absolute CLOCK_MONOTONIC deadline until shortly before that point and
+ * spins for the rest, so neither timer slack nor the time spent reading and
+ * printing accumulates as drift. A sample that is already overdue is taken
+ * right away and counted as late.
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "output.h"
+#include "platform.h"
+
+/* Sleep until this long before a deadline, then spin. */
+#define SAMPLE_SPIN_NS 50000ULL
+
+/* Make samples visible as they are taken once intervals get this long. */
+#define SAMPLE_FLUSH_NS 10000000ULL
+
+struct sample_opts {
+	uint64_t repeat;
+	uint64_t interval_ns;
+	int summary;
+	int requested;
+};
+
+static struct sample_opts sample_opts;
+
+int
+parse_duration(const char *arg, uint64_t *ns)
+{
+	static const struct {
+		const char *suffix;
+		uint64_t ns;
+	} units[] = {
+		{ "", 1000000ULL },
+		{ "ns", 1ULL },
+		{ "us", 1000ULL },
+		{ "ms", 1000000ULL },
+		{ "s", 1000000000ULL },
+	};
+	char *end;
+	uint64_t n;
+	int i;
+
+	n = strtoull(arg, &end, 0);
+	if (end == arg) {
+		return -1;
+	}
+	for (i = 0; i < arraysize(units); i++) {
+		if (!strcmp(end, units[i].suffix)) {
+			*ns = n * units[i].ns;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Match --name value and --name=value; *value is NULL for a bare --name. */
+static int
+match_option(const char *arg, const char *name, const char **value)
+{
+	size_t len = strlen(name);
+
+	if (strncmp(arg, name, len)) {
+		return 0;
+	}
+	if (arg[len] == '=') {
+		*value = &arg[len + 1];
+	} else if (arg[len] == '\0') {
+		*value = NULL;
+	} else {
+		return 0;
+	}
+	return 1;
+}
+
+int
+parse_sample_options(int *argc, const char *argv[], int allowed)
+{
+	const char *value;
+	char *end;
+	int i, j, used;
+
+	memset(&sample_opts, 0, sizeof(sample_opts));
+	sample_opts.repeat = 1;
+	if (!allowed) {
+		return 0;
+	}
+
+	for (i = 1; i < *argc; i += used) {
+		used = 1;
+		if (match_option(argv[i], "--summary", &value) && !value) {
+			sample_opts.summary = 1;
+		} else if (match_option(argv[i], "--repeat", &value) ||
+		           match_option(argv[i], "--interval", &value)) {
+			if (value == NULL) {
+				if (i + 1 == *argc) {
+					fprintf(stderr, "%s needs a value\n", argv[i]);
+					return -1;
+				}
+				value = argv[i + 1];
+				used = 2;
+			}
+			if (argv[i][2] == 'r') {
+				sample_opts.repeat = strtoull(value, &end, 0);
+				if (*end != '\0' || sample_opts.repeat == 0) {
+					fprintf(stderr, "bad repeat count '%s'\n",
+					        value);
+					return -1;
+				}
+			} else if (parse_duration(value,
+			                          &sample_opts.interval_ns) < 0) {
+				fprintf(stderr, "bad interval '%s'\n", value);
+				return -1;
+			}
+		} else {
+			continue;
+		}
+
+		sample_opts.requested = 1;
+		for (j = i; j + used <= *argc; j++) {
+			argv[j] = argv[j + used];
+		}
+		*argc -= used;
+		used = 0;
+	}
+
+	return 0;
+}
+
+int
+sampling_requested(void)
+{
+	return sample_opts.requested;
+}
+
+uint64_t
+deadline_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+wait_until_deadline_or(uint64_t deadline, volatile sig_atomic_t *stop)
+{
+	struct timespec ts;
+	uint64_t now = deadline_now_ns();
+
+	if (now + SAMPLE_SPIN_NS < deadline) {
+		ts.tv_sec = (deadline - SAMPLE_SPIN_NS) / 1000000000ULL;
+		ts.tv_nsec = (deadline - SAMPLE_SPIN_NS) % 1000000000ULL;
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+		                       NULL) == EINTR && !*stop) {
+		}
+	}
+	while (!*stop && deadline_now_ns() < deadline) {
+		cpu_relax();
+	}
+}
+
+void
+wait_until_deadline(uint64_t deadline)
+{
+	static volatile sig_atomic_t never;
+
+	wait_until_deadline_or(deadline, &never);
+}
+
+/* Running statistics, updated with Welford's method. */
+struct sample_summary {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	double mean;
+	double m2;
+};
+
+static void
+summary_add(struct sample_summary *s, uint64_t value)
+{
+	double delta;
+
+	if (s->count == 0 || value < s->min) {
+		s->min = value;
+	}
+	if (s->count == 0 || value > s->max) {
+		s->max = value;
+	}
+	s->count++;
+	delta = value - s->mean;
+	s->mean += delta / s->count;
+	s->m2 += delta * (value - s->mean);
+}
+
+static void
+print_summary(const struct sample_summary *s, int width, uint64_t late)
+{
+	char buf[256];
+	double stddev = s->count > 1 ? sqrt(s->m2 / (s->count - 1)) : 0;
+
+	snprintf(buf, sizeof(buf),
+	         "samples=%llu min=0x%0*llx max=0x%0*llx mean=%.3f "
+	         "stddev=%.3f late=%llu\n",
+	         (unsigned long long)s->count, width / 4,
+	         (unsigned long long)s->min, width / 4,
+	         (unsigned long long)s->max, s->mean, stddev,
+	         (unsigned long long)late);
+
+	/* Keep machine readable output parseable. */
+	if (output_get_format() == OUTPUT_TEXT) {
+		output_str(buf);
+	} else {
+		output_flush();
+		fputs(buf, stderr);
+	}
+}
+
+int
+backend_sample(const struct backend *b, struct iot_handle *h, uint64_t addr,
+               int width)
+{
+	struct sample_summary summary;
+	uint64_t start, deadline, now, value, n, late = 0;
+	char stamp[32];
+
+	memset(&summary, 0, sizeof(summary));
+	start = deadline_now_ns();
+
+	for (n = 0; n < sample_opts.repeat; n++) {
+		if (n > 0 && sample_opts.interval_ns != 0) {
+			deadline = start + n * sample_opts.interval_ns;
+			if (deadline_now_ns() < deadline) {
+				if (sample_opts.interval_ns >= SAMPLE_FLUSH_NS) {
+					output_flush();
+				}
+				wait_until_deadline(deadline);
+			} else {
+				late++;
+			}
+		}
+
+		now = deadline_now_ns();
+		if (backend_read(b, h, addr, width, &value) < 0) {
+			return -1;
+		}
+		summary_add(&summary, value);
+
+		if (output_get_format() != OUTPUT_TEXT) {
+			output_read(h, addr, width, value, 0);
+			continue;
+		}
+		snprintf(stamp, sizeof(stamp), "%llu.%09llu ",
+		         (unsigned long long)((now - start) / 1000000000ULL),
+		         (unsigned long long)((now - start) % 1000000000ULL));
+		output_str(stamp);
+		output_hex(value, width / 4, 0);
+		output_char('\n');
+	}
+
+	if (sample_opts.summary) {
+		print_summary(&summary, width, late);
+	}
+
+	return 0;
+}
@@ -33,96 +33,15 @@
 #include <inttypes.h>
 #include <glob.h>
 #include "commands.h"
+#include "output.h"
 #include "platform.h"
 
-static int
-open_and_seek(int chip, uint64_t scom, int mode, int *fd)
-{
-	char dev[512];
-	/* Shift scom address to align to 8 byte boundary, mask high bit */
-	off64_t offset = (scom & ((1ULL << 63) - 1)) << 3;
-	/* Handle high bit (indirect SCOM) by shifting the bit right one bit.
-	   File offsets are signed, and this is how the kernel expects us to
-	   mangle it.
-	   Note we set bit 62 instead of bit 59 because of a bug in the kernel
-	   scom.c that shifts the whole value right 3 before looking for
-	   bit 59 set.
-	*/
-	if (scom & (1ULL << 63)) {
-		offset |= 1ULL << 62;
-	}
-
-	snprintf(dev, sizeof(dev), "/sys/kernel/debug/powerpc/scom/%08x/access",
-	         chip);
-	*fd = open(dev, mode);
-	if (*fd < 0) {
-		fprintf(stderr, "open(\"%s\"): %s\n", dev, strerror(errno));
-		return -1;
-	}
-
-	if (lseek64(*fd, offset, SEEK_SET) == (off_t)-1) {
-		fprintf(stderr, "lseek(%jd): %s\n", offset, strerror(errno));
-		close(*fd);
-		return -1;
-	}
-
-	return 0;
-}
-
-static int
-rd_scom(int argc, const char *argv[], const struct cmd_info *info)
-{
-	uint64_t scom;
-	int chip;
-	uint64_t data = 0;
-	int fd;
-
-	chip = strtol(argv[1], NULL, 0);
-	scom = strtoull(argv[2], NULL, 0);
-
-	if (open_and_seek(chip, scom, O_RDONLY, &fd) < 0) {
-		return -1;
-	}
-
-	if (read(fd, &data, sizeof(data)) != sizeof(data)) {
-		fprintf(stderr, "read(): %s\n", strerror(errno));
-		close(fd);
-		return -1;
-	}
-
-	close(fd);
-
-	printf("0x%016" PRIx64 "\n", data);
-
-	return 0;
-}
-
-static int
-wr_scom(int argc, const char *argv[], const struct cmd_info *info)
-{
-	uint64_t scom;
-	int chip;
-	uint64_t data;
-	int fd;
-	int ret = 0;
-
-	chip = strtol(argv[1], NULL, 0);
-	scom = strtoull(argv[2], NULL, 0);
-	data = strtoull(argv[3], NULL, 0);
-
-	if (open_and_seek(chip, scom, O_WRONLY, &fd) < 0) {
-		return -1;
-	}
-
-	if (write(fd, &data, sizeof(data)) != sizeof(data)) {
-		fprintf(stderr, "write(): %s\n", strerror(errno));
-		ret = -1;
-	}
-
-	close(fd);
-
-	return ret;
-}
+static const struct backend scom_backend = {
+	.space = IOT_SPACE_SCOM,
+	.width = 64,
+	.addr_step = 1,
+	.dev_fmt = "/sys/kernel/debug/powerpc/scom/%08x/access",
+};
 
 /* Reads the Processor Identification Register (PIR) for a linux CPU number */
 static int
@@ -132,7 +51,7 @@ cpu_to_pir(int cpu, uint32_t *pir)
 	int fd;
 
 	snprintf(pir_file, sizeof(pir_file),
-	         "/sys/devices/system/cpu/cpu%d/pir", cpu);
+	         "%s/sys/devices/system/cpu/cpu%d/pir", iot_get_root(), cpu);
 	fd = open(pir_file, O_RDONLY);
 	if (fd < 0) {
 		fprintf(stderr, "open(\"%s\"): %s\n", pir_file, strerror(errno));
@@ -162,7 +81,8 @@ pir_to_chipid(uint32_t pir, uint32_t *chipid)
 	/* Zero out pir's thread number to get pir of the core */
 	pir &= ~0x7;
 	snprintf(cpu_glob_str, sizeof(cpu_glob_str),
-	         "/proc/device-tree/cpus/*@%x/ibm,chip-id", pir);
+	         "%s/proc/device-tree/cpus/*@%x/ibm,chip-id", iot_get_root(),
+	         pir);
 
 	glob_err = glob(cpu_glob_str, 0, NULL, &globbuf);
 	if (glob_err != 0) {
@@ -208,7 +128,8 @@ cpu_to_chipid(int argc, const char *argv[], const struct cmd_info *info)
 		return ret;
 	}
 
-	printf("0x%08x\n", chipid);
+	output_hex(chipid, 8, 0);
+	output_char('\n');
 	return ret;
 }
 
@@ -229,17 +150,20 @@ cpu_to_ex(int argc, const char *argv[], const struct cmd_info *info)
 	/* EX number is the 4-bit core ID part of PIR */
 	ex = (pir >> 3) & 0xf;
 
-	printf("%d\n", ex);
+	output_dec(ex);
+	output_char('\n');
 	return ret;
 }
 
-MAKE_PREREQ_PARAMS_FIXED_ARGS(rd_params, 3, "<chipid> <scom>", 0);
+MAKE_PREREQ_PARAMS_SAMPLED(rd_params, 3, 3, "<chipid> <scom>", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(wr_params, 4, "<chipid> <scom> <data>", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(cpu_params, 2, "<cpu>", 0);
 
 static const struct cmd_info scom_cmds[] = {
-	MAKE_CMD_WITH_PARAMS(getscom, &rd_scom, NULL, &rd_params),
-	MAKE_CMD_WITH_PARAMS(putscom, &wr_scom, NULL, &wr_params),
+	MAKE_CMD_WITH_PARAMS(getscom, &backend_read_cmd, &scom_backend,
+	                     &rd_params),
+	MAKE_CMD_WITH_PARAMS(putscom, &backend_write_cmd, &scom_backend,
+	                     &wr_params),
 	MAKE_CMD_WITH_PARAMS(cputochipid, &cpu_to_chipid, NULL, &cpu_params),
 	MAKE_CMD_WITH_PARAMS(cputoex, &cpu_to_ex, NULL, &cpu_params),
 };
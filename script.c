@@ -0,0 +1,1067 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Register scripts.
+ *
+ * "script <file> [name=value ...]" compiles a register script into bytecode
+ * for a small stack machine and runs it in-process, so an initialization
+ * sequence costs one process instead of one per register access. The
+ * language is line oriented:
+ *
+ *	# comment
+ *	x = mmio32(0xfed00000)             assign a variable
+ *	mmio32(0xfed00004) = x | 0x10      write a register
+ *	if x & 1 ... else ... end
+ *	while pci16(0, 0x1f, 0, 4) & 4 ... end
+ *	print "status", x                  values print as hex
+ *	delay 100                          microseconds
+ *	exit x != 0                        a nonzero status fails the command
+ *
+ * Expressions use the C operators and precedence (the logic commands' or,
+ * and, xor, shl, shr and not are | & ^ << >> ~) plus bts(v, bit) and
+ * btr(v, bit). Registers are read and written with <space><width>(dev...,
+ * addr), see parse_reg_spec(). Variables are 64-bit and must be assigned,
+ * or preset on the command line, before they are used.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "output.h"
+
+#define MAX_LINE 1024
+#define MAX_VARS 256
+#define MAX_STRINGS 256
+#define MAX_NESTING 32
+#define MAX_EXPR_DEPTH 64
+
+/*
+ * Instructions are one opcode byte followed by their operands: imm8 and
+ * var/str indexes take a byte, imm64 eight and jump targets four, all little
+ * endian. Register accesses carry the space, the width and the number of
+ * arguments on the stack (device values, then the address).
+ */
+enum op {
+	OP_HALT,
+	OP_PUSH8,      /* imm8: -> value */
+	OP_PUSH,       /* imm64: -> value */
+	OP_LOAD,       /* var: -> value */
+	OP_STORE,      /* var: value -> */
+	OP_NEG,
+	OP_NOT,
+	OP_LNOT,
+	OP_BOOL,
+	OP_ADD,
+	OP_SUB,
+	OP_MUL,
+	OP_DIV,
+	OP_MOD,
+	OP_OR,
+	OP_AND,
+	OP_XOR,
+	OP_SHL,
+	OP_SHR,
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE,
+	OP_JMP,        /* target */
+	OP_JZ,         /* target: value -> */
+	OP_JZ_KEEP,    /* target: jump if the top is 0, else pop it */
+	OP_JNZ_KEEP,   /* target: jump if the top is not 0, else pop it */
+	OP_READ,       /* space width nargs: args... -> value */
+	OP_WRITE,      /* space width nargs: args... value -> */
+	OP_PRINT,      /* value -> */
+	OP_PRINTS,     /* str */
+	OP_SPACE,
+	OP_NEWLINE,
+	OP_DELAY,      /* usecs -> */
+	OP_EXIT,       /* status -> */
+};
+
+/* Net stack effect of each opcode, for tracking the maximum depth. */
+static const signed char op_stack[] = {
+	[OP_PUSH8] = 1, [OP_PUSH] = 1, [OP_LOAD] = 1, [OP_STORE] = -1,
+	[OP_ADD ... OP_GE] = -1, [OP_JZ] = -1, [OP_JZ_KEEP] = -1,
+	[OP_JNZ_KEEP] = -1, [OP_PRINT] = -1, [OP_DELAY] = -1, [OP_EXIT] = -1,
+};
+
+/* Maps the first instruction of each script line back to its number. */
+struct line_entry {
+	uint32_t pc;
+	int line;
+};
+
+struct program {
+	uint8_t *code;
+	size_t len;
+	int depth;                     /* stack slots needed */
+	int nvars;
+	char *vars[MAX_VARS];
+	uint64_t init[MAX_VARS];       /* preset values */
+	int nstrs;
+	char *strs[MAX_STRINGS];
+	int written;                   /* mask of spaces the script writes */
+	struct line_entry *lines;
+	int nlines;
+};
+
+enum token_type {
+	T_END,
+	T_NUM,
+	T_IDENT,
+	T_STR,
+	T_OP,
+};
+
+/* Two character operators are packed into one int. */
+#define OP2(a, b) ((a) << 8 | (b))
+
+struct token {
+	enum token_type type;
+	int op;
+	uint64_t num;
+	char text[MAX_LINE];
+};
+
+enum block_type {
+	BLOCK_IF,
+	BLOCK_ELSE,
+	BLOCK_WHILE,
+};
+
+struct block {
+	enum block_type type;
+	int line;
+	uint32_t start;   /* loop condition */
+	uint32_t patch;   /* jump operand to point past the block */
+};
+
+struct compiler {
+	const char *file;
+	int line;
+	const char *p;
+	struct token tok;
+	struct program *prog;
+	size_t cap;
+	int linecap;
+	int depth;
+	struct block blocks[MAX_NESTING];
+	int nblocks;
+	int error;
+};
+
+/* Report the first error only; later ones tend to be follow-on noise. */
+static void
+compile_error(struct compiler *c, const char *fmt, ...)
+{
+	va_list ap;
+
+	if (c->error) {
+		return;
+	}
+	fprintf(stderr, "%s:%d: ", c->file, c->line);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+	c->error = 1;
+}
+
+static void
+next_token(struct compiler *c)
+{
+	struct token *t = &c->tok;
+	const char *p = c->p;
+	char *end;
+	size_t len;
+
+	while (*p == ' ' || *p == '\t' || *p == '\r') {
+		p++;
+	}
+
+	if (*p == '\0' || *p == '\n' || *p == '#') {
+		t->type = T_END;
+	} else if (isdigit((unsigned char)*p)) {
+		t->type = T_NUM;
+		errno = 0;
+		t->num = strtoull(p, &end, 0);
+		if (errno || isalnum((unsigned char)*end) || *end == '_') {
+			compile_error(c, "bad number");
+		}
+		p = end;
+	} else if (isalpha((unsigned char)*p) || *p == '_') {
+		t->type = T_IDENT;
+		for (len = 0; isalnum((unsigned char)p[len]) || p[len] == '_';
+		     len++) {
+			t->text[len] = p[len];
+		}
+		t->text[len] = '\0';
+		p += len;
+	} else if (*p == '"') {
+		t->type = T_STR;
+		for (len = 0, p++; *p != '"'; len++, p++) {
+			if (*p == '\0' || *p == '\n') {
+				compile_error(c, "unterminated string");
+				break;
+			}
+			t->text[len] = *p;
+		}
+		t->text[len] = '\0';
+		if (*p == '"') {
+			p++;
+		}
+	} else {
+		t->type = T_OP;
+		t->op = *p++;
+		switch (OP2(t->op, *p)) {
+		case OP2('<', '<'): case OP2('>', '>'):
+		case OP2('<', '='): case OP2('>', '='):
+		case OP2('=', '='): case OP2('!', '='):
+		case OP2('&', '&'): case OP2('|', '|'):
+			t->op = OP2(t->op, *p++);
+			break;
+		}
+	}
+
+	c->p = p;
+}
+
+static int
+accept(struct compiler *c, int op)
+{
+	if (c->tok.type == T_OP && c->tok.op == op) {
+		next_token(c);
+		return 1;
+	}
+	return 0;
+}
+
+static void
+expect(struct compiler *c, int op)
+{
+	char name[3] = { op, 0, 0 };
+
+	if (!accept(c, op)) {
+		compile_error(c, "expected '%s'", name);
+	}
+}
+
+static void
+emit_bytes(struct compiler *c, const void *data, size_t len)
+{
+	struct program *prog = c->prog;
+
+	if (prog->len + len > c->cap) {
+		c->cap = c->cap ? c->cap * 2 : 256;
+		prog->code = realloc(prog->code, c->cap);
+		if (prog->code == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(&prog->code[prog->len], data, len);
+	prog->len += len;
+}
+
+static void
+emit_op(struct compiler *c, enum op op)
+{
+	uint8_t byte = op;
+
+	emit_bytes(c, &byte, 1);
+	if (op < arraysize(op_stack)) {
+		c->depth += op_stack[op];
+	}
+	if (c->depth > c->prog->depth) {
+		c->prog->depth = c->depth;
+	}
+}
+
+static void
+emit_u8(struct compiler *c, unsigned int value)
+{
+	uint8_t byte = value;
+
+	emit_bytes(c, &byte, 1);
+}
+
+static void
+emit_le(struct compiler *c, uint64_t value, int len)
+{
+	uint8_t bytes[8];
+	int i;
+
+	for (i = 0; i < len; i++) {
+		bytes[i] = value >> (8 * i);
+	}
+	emit_bytes(c, bytes, len);
+}
+
+static void
+emit_push(struct compiler *c, uint64_t value)
+{
+	if (value <= UINT8_MAX) {
+		emit_op(c, OP_PUSH8);
+		emit_u8(c, value);
+	} else {
+		emit_op(c, OP_PUSH);
+		emit_le(c, value, 8);
+	}
+}
+
+/* Emit a jump and return the position of its target operand. */
+static uint32_t
+emit_jump(struct compiler *c, enum op op, uint32_t target)
+{
+	uint32_t at;
+
+	emit_op(c, op);
+	at = c->prog->len;
+	emit_le(c, target, 4);
+	return at;
+}
+
+static void
+patch_jump(struct compiler *c, uint32_t at)
+{
+	uint32_t target = c->prog->len;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		c->prog->code[at + i] = target >> (8 * i);
+	}
+}
+
+static int
+find_var(const struct program *prog, const char *name)
+{
+	int i;
+
+	for (i = 0; i < prog->nvars; i++) {
+		if (!strcmp(prog->vars[i], name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+static int
+add_var(struct compiler *c, const char *name)
+{
+	struct program *prog = c->prog;
+	int var = find_var(prog, name);
+
+	if (var >= 0) {
+		return var;
+	}
+	if (prog->nvars == MAX_VARS) {
+		compile_error(c, "too many variables");
+		return 0;
+	}
+	prog->vars[prog->nvars] = strdup(name);
+	return prog->nvars++;
+}
+
+static int
+is_keyword(const char *name)
+{
+	static const char *const keywords[] = {
+		"if", "else", "end", "while", "print", "delay", "exit",
+		"bts", "btr",
+	};
+	int i;
+
+	for (i = 0; i < arraysize(keywords); i++) {
+		if (!strcmp(keywords[i], name)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void expression(struct compiler *c);
+
+/* Compile a parenthesized, comma separated argument list. */
+static int
+arguments(struct compiler *c)
+{
+	int n = 0;
+
+	expect(c, '(');
+	if (accept(c, ')')) {
+		return 0;
+	}
+	do {
+		expression(c);
+		n++;
+	} while (accept(c, ','));
+	expect(c, ')');
+
+	return n;
+}
+
+static void
+emit_access(struct compiler *c, enum op op, const struct reg_spec *spec,
+            int nargs)
+{
+	emit_op(c, op);
+	emit_u8(c, spec->space);
+	emit_u8(c, spec->width);
+	emit_u8(c, nargs);
+}
+
+static void
+primary(struct compiler *c)
+{
+	struct token *t = &c->tok;
+	struct reg_spec spec;
+	char name[MAX_LINE];
+	int var, nargs;
+
+	if (t->type == T_NUM) {
+		emit_push(c, t->num);
+		next_token(c);
+	} else if (t->type == T_IDENT) {
+		strcpy(name, t->text);
+		if (!strcmp(name, "bts") || !strcmp(name, "btr")) {
+			/* v | (1 << bit) and v & ~(1 << bit) */
+			next_token(c);
+			expect(c, '(');
+			expression(c);
+			expect(c, ',');
+			emit_push(c, 1);
+			expression(c);
+			expect(c, ')');
+			emit_op(c, OP_SHL);
+			if (name[2] == 's') {
+				emit_op(c, OP_OR);
+			} else {
+				emit_op(c, OP_NOT);
+				emit_op(c, OP_AND);
+			}
+		} else if (!parse_reg_spec(name, &spec)) {
+			next_token(c);
+			nargs = arguments(c);
+			if (nargs < spec.ndev + 1 - spec.opt_dev ||
+			    nargs > spec.ndev + 1) {
+				compile_error(c, "wrong number of arguments to %s",
+				              name);
+			}
+			c->depth -= nargs;
+			emit_access(c, OP_READ, &spec, nargs);
+			c->depth++;
+		} else if (is_keyword(name)) {
+			compile_error(c, "unexpected '%s'", name);
+		} else {
+			var = find_var(c->prog, name);
+			if (var < 0) {
+				compile_error(c, "undefined variable '%s'", name);
+			}
+			emit_op(c, OP_LOAD);
+			emit_u8(c, var);
+			next_token(c);
+		}
+	} else if (accept(c, '(')) {
+		expression(c);
+		expect(c, ')');
+	} else {
+		compile_error(c, "syntax error");
+	}
+}
+
+static void
+unary(struct compiler *c)
+{
+	if (accept(c, '-')) {
+		unary(c);
+		emit_op(c, OP_NEG);
+	} else if (accept(c, '~')) {
+		unary(c);
+		emit_op(c, OP_NOT);
+	} else if (accept(c, '!')) {
+		unary(c);
+		emit_op(c, OP_LNOT);
+	} else if (accept(c, '+')) {
+		unary(c);
+	} else {
+		primary(c);
+	}
+}
+
+/* Binary operators by precedence level, loosest binding first. */
+static const struct {
+	int level;
+	int token;
+	enum op op;
+} binops[] = {
+	{ 2, '|', OP_OR },
+	{ 3, '^', OP_XOR },
+	{ 4, '&', OP_AND },
+	{ 5, OP2('=', '='), OP_EQ },
+	{ 5, OP2('!', '='), OP_NE },
+	{ 6, '<', OP_LT },
+	{ 6, OP2('<', '='), OP_LE },
+	{ 6, '>', OP_GT },
+	{ 6, OP2('>', '='), OP_GE },
+	{ 7, OP2('<', '<'), OP_SHL },
+	{ 7, OP2('>', '>'), OP_SHR },
+	{ 8, '+', OP_ADD },
+	{ 8, '-', OP_SUB },
+	{ 9, '*', OP_MUL },
+	{ 9, '/', OP_DIV },
+	{ 9, '%', OP_MOD },
+};
+
+#define LEVEL_UNARY 10
+
+static void
+binary(struct compiler *c, int level)
+{
+	uint32_t at;
+	int i;
+
+	if (level == LEVEL_UNARY) {
+		unary(c);
+		return;
+	}
+
+	binary(c, level + 1);
+
+	/* Levels 0 and 1 are || and &&, which short circuit. */
+	if (level < 2) {
+		while (accept(c, level ? OP2('&', '&') : OP2('|', '|'))) {
+			at = emit_jump(c, level ? OP_JZ_KEEP : OP_JNZ_KEEP, 0);
+			binary(c, level + 1);
+			patch_jump(c, at);
+			emit_op(c, OP_BOOL);
+		}
+		return;
+	}
+
+	for (;;) {
+		for (i = 0; i < arraysize(binops); i++) {
+			if (binops[i].level == level &&
+			    c->tok.type == T_OP && c->tok.op == binops[i].token) {
+				break;
+			}
+		}
+		if (i == arraysize(binops) || c->error) {
+			return;
+		}
+		next_token(c);
+		binary(c, level + 1);
+		emit_op(c, binops[i].op);
+	}
+}
+
+static void
+expression(struct compiler *c)
+{
+	binary(c, 0);
+	if (c->prog->depth > MAX_EXPR_DEPTH) {
+		compile_error(c, "expression too complex");
+	}
+}
+
+static struct block *
+push_block(struct compiler *c, enum block_type type)
+{
+	struct block *b;
+
+	if (c->nblocks == MAX_NESTING) {
+		compile_error(c, "blocks nested too deeply");
+		return &c->blocks[0];
+	}
+	b = &c->blocks[c->nblocks++];
+	b->type = type;
+	b->line = c->line;
+	return b;
+}
+
+static void
+statement(struct compiler *c)
+{
+	struct token *t = &c->tok;
+	struct reg_spec spec;
+	struct block *b;
+	char name[MAX_LINE];
+	int nargs;
+
+	if (t->type != T_IDENT) {
+		compile_error(c, "syntax error");
+		return;
+	}
+	strcpy(name, t->text);
+
+	if (!strcmp(name, "if") || !strcmp(name, "while")) {
+		b = push_block(c, name[0] == 'i' ? BLOCK_IF : BLOCK_WHILE);
+		b->start = c->prog->len;
+		next_token(c);
+		expression(c);
+		b->patch = emit_jump(c, OP_JZ, 0);
+	} else if (!strcmp(name, "else")) {
+		next_token(c);
+		if (c->nblocks == 0 || c->blocks[c->nblocks - 1].type != BLOCK_IF) {
+			compile_error(c, "'else' without 'if'");
+			return;
+		}
+		b = &c->blocks[c->nblocks - 1];
+		b->type = BLOCK_ELSE;
+		nargs = emit_jump(c, OP_JMP, 0);
+		patch_jump(c, b->patch);
+		b->patch = nargs;
+	} else if (!strcmp(name, "end")) {
+		next_token(c);
+		if (c->nblocks == 0) {
+			compile_error(c, "'end' without a block");
+			return;
+		}
+		b = &c->blocks[--c->nblocks];
+		if (b->type == BLOCK_WHILE) {
+			emit_jump(c, OP_JMP, b->start);
+		}
+		patch_jump(c, b->patch);
+	} else if (!strcmp(name, "print")) {
+		next_token(c);
+		nargs = 0;
+		while (t->type != T_END && !c->error) {
+			if (nargs++ > 0) {
+				expect(c, ',');
+				emit_op(c, OP_SPACE);
+			}
+			if (t->type == T_STR) {
+				if (c->prog->nstrs == MAX_STRINGS) {
+					compile_error(c, "too many strings");
+					return;
+				}
+				emit_op(c, OP_PRINTS);
+				emit_u8(c, c->prog->nstrs);
+				c->prog->strs[c->prog->nstrs++] = strdup(t->text);
+				next_token(c);
+			} else {
+				expression(c);
+				emit_op(c, OP_PRINT);
+			}
+		}
+		emit_op(c, OP_NEWLINE);
+	} else if (!strcmp(name, "delay")) {
+		next_token(c);
+		expression(c);
+		emit_op(c, OP_DELAY);
+	} else if (!strcmp(name, "exit")) {
+		next_token(c);
+		if (t->type == T_END) {
+			emit_push(c, 0);
+		} else {
+			expression(c);
+		}
+		emit_op(c, OP_EXIT);
+	} else if (!parse_reg_spec(name, &spec)) {
+		next_token(c);
+		nargs = arguments(c);
+		if (nargs < spec.ndev + 1 - spec.opt_dev || nargs > spec.ndev + 1) {
+			compile_error(c, "wrong number of arguments to %s", name);
+		}
+		expect(c, '=');
+		expression(c);
+		c->depth -= nargs + 1;
+		emit_access(c, OP_WRITE, &spec, nargs);
+		c->prog->written |= 1 << spec.space;
+	} else if (is_keyword(name)) {
+		compile_error(c, "unexpected '%s'", name);
+	} else {
+		next_token(c);
+		expect(c, '=');
+		/* The variable exists once assigned, not within its own value. */
+		expression(c);
+		emit_op(c, OP_STORE);
+		emit_u8(c, add_var(c, name));
+	}
+
+	if (t->type != T_END) {
+		compile_error(c, "unexpected text at end of line");
+	}
+}
+
+static void
+add_line(struct compiler *c)
+{
+	struct program *prog = c->prog;
+
+	if (prog->nlines == c->linecap) {
+		c->linecap = c->linecap ? c->linecap * 2 : 64;
+		prog->lines = realloc(prog->lines,
+		                      c->linecap * sizeof(*prog->lines));
+		if (prog->lines == NULL) {
+			fprintf(stderr, "out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	prog->lines[prog->nlines].pc = prog->len;
+	prog->lines[prog->nlines].line = c->line;
+	prog->nlines++;
+}
+
+static int
+compile(FILE *f, const char *file, struct program *prog)
+{
+	struct compiler c;
+	char buf[MAX_LINE];
+
+	memset(&c, 0, sizeof(c));
+	c.file = file;
+	c.prog = prog;
+
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		c.line++;
+		if (strchr(buf, '\n') == NULL && !feof(f)) {
+			compile_error(&c, "line too long");
+			return -1;
+		}
+		c.p = buf;
+		next_token(&c);
+		if (c.tok.type == T_END) {
+			continue;
+		}
+		add_line(&c);
+		statement(&c);
+		if (c.error) {
+			return -1;
+		}
+	}
+	if (ferror(f)) {
+		fprintf(stderr, "can't read %s: %s\n", file, strerror(errno));
+		return -1;
+	}
+	if (c.nblocks > 0) {
+		c.line = c.blocks[c.nblocks - 1].line;
+		compile_error(&c, "block is missing its 'end'");
+		return -1;
+	}
+	emit_op(&c, OP_HALT);
+
+	return 0;
+}
+
+static void
+free_program(struct program *prog)
+{
+	int i;
+
+	for (i = 0; i < prog->nvars; i++) {
+		free(prog->vars[i]);
+	}
+	for (i = 0; i < prog->nstrs; i++) {
+		free(prog->strs[i]);
+	}
+	free(prog->code);
+	free(prog->lines);
+}
+
+struct machine {
+	const char *file;
+	const struct program *prog;
+	struct handle_set handles;   /* open for the whole run */
+};
+
+static int
+pc_line(const struct program *prog, uint32_t pc)
+{
+	int lo = 0, hi = prog->nlines - 1, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (prog->lines[mid].pc <= pc) {
+			lo = mid;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return prog->lines[lo].line;
+}
+
+static uint64_t
+get_le(const uint8_t *p, int len)
+{
+	uint64_t value = 0;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		value |= (uint64_t)p[i] << (8 * i);
+	}
+	return value;
+}
+
+static void
+delay_us(uint64_t usecs)
+{
+	struct timespec ts;
+
+	ts.tv_sec = usecs / 1000000;
+	ts.tv_nsec = (usecs % 1000000) * 1000;
+	while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+	}
+}
+
+/* Execute prog; returns the script's exit status or -1 on a runtime error. */
+static int
+execute(struct machine *m, uint64_t *vars)
+{
+	const struct program *prog = m->prog;
+	const uint8_t *code = prog->code;
+	uint64_t stack[MAX_EXPR_DEPTH + 2];
+	uint64_t *sp = stack;   /* next free slot */
+	unsigned int dev[IOT_MAX_DEV_ARGS];
+	struct iot_handle *h;
+	uint32_t pc = 0, insn;
+	enum iot_space space;
+	int width, nargs, ndev, i;
+	uint64_t a, b;
+
+	for (;;) {
+		insn = pc;
+		switch (code[pc++]) {
+		case OP_HALT:
+			return 0;
+		case OP_PUSH8:
+			*sp++ = code[pc++];
+			break;
+		case OP_PUSH:
+			*sp++ = get_le(&code[pc], 8);
+			pc += 8;
+			break;
+		case OP_LOAD:
+			*sp++ = vars[code[pc++]];
+			break;
+		case OP_STORE:
+			vars[code[pc++]] = *--sp;
+			break;
+		case OP_NEG:
+			sp[-1] = -sp[-1];
+			break;
+		case OP_NOT:
+			sp[-1] = ~sp[-1];
+			break;
+		case OP_LNOT:
+			sp[-1] = !sp[-1];
+			break;
+		case OP_BOOL:
+			sp[-1] = !!sp[-1];
+			break;
+		case OP_ADD ... OP_GE:
+			b = *--sp;
+			a = sp[-1];
+			switch (code[insn]) {
+			case OP_ADD: a += b; break;
+			case OP_SUB: a -= b; break;
+			case OP_MUL: a *= b; break;
+			case OP_DIV:
+			case OP_MOD:
+				if (b == 0) {
+					fprintf(stderr, "%s:%d: division by zero\n",
+					        m->file, pc_line(prog, insn));
+					return -1;
+				}
+				a = (code[insn] == OP_DIV) ? a / b : a % b;
+				break;
+			case OP_OR: a |= b; break;
+			case OP_AND: a &= b; break;
+			case OP_XOR: a ^= b; break;
+			case OP_SHL: a = (b < 64) ? a << b : 0; break;
+			case OP_SHR: a = (b < 64) ? a >> b : 0; break;
+			case OP_EQ: a = (a == b); break;
+			case OP_NE: a = (a != b); break;
+			case OP_LT: a = (a < b); break;
+			case OP_LE: a = (a <= b); break;
+			case OP_GT: a = (a > b); break;
+			case OP_GE: a = (a >= b); break;
+			}
+			sp[-1] = a;
+			break;
+		case OP_JMP:
+			pc = get_le(&code[pc], 4);
+			break;
+		case OP_JZ:
+			pc = *--sp ? pc + 4 : get_le(&code[pc], 4);
+			break;
+		case OP_JZ_KEEP:
+		case OP_JNZ_KEEP:
+			if (!sp[-1] == (code[insn] == OP_JZ_KEEP)) {
+				pc = get_le(&code[pc], 4);
+			} else {
+				sp--;
+				pc += 4;
+			}
+			break;
+		case OP_READ:
+		case OP_WRITE:
+			space = code[pc];
+			width = code[pc + 1];
+			nargs = code[pc + 2];
+			pc += 3;
+			if (code[insn] == OP_WRITE) {
+				b = *--sp;
+			}
+			sp -= nargs;
+			/* Omitted leading device values are 0. */
+			memset(dev, 0, sizeof(dev));
+			ndev = iot_space_info(space)->ndev;
+			for (i = 0; i < nargs - 1; i++) {
+				dev[ndev - (nargs - 1) + i] = sp[i];
+			}
+			a = sp[nargs - 1];
+			h = handle_set_get(&m->handles, space, dev,
+			                   (prog->written & (1 << space)) ?
+			                   IOT_RDWR : IOT_RDONLY);
+			if (h == NULL) {
+				fprintf(stderr, "%s:%d: can't open %s device: %s\n",
+				        m->file, pc_line(prog, insn),
+				        iot_space_name(space), strerror(errno));
+				return -1;
+			}
+			if (code[insn] == OP_READ) {
+				if (iot_read(h, a, width, sp) < 0) {
+					fprintf(stderr, "%s:%d: can't read %s%d "
+					        "register 0x%llx: %s\n", m->file,
+					        pc_line(prog, insn),
+					        iot_space_name(space), width,
+					        (unsigned long long)a,
+					        strerror(errno));
+					return -1;
+				}
+				sp++;
+			} else if (iot_write(h, a, width, b) < 0) {
+				fprintf(stderr, "%s:%d: can't write %s%d "
+				        "register 0x%llx: %s\n", m->file,
+				        pc_line(prog, insn),
+				        iot_space_name(space), width,
+				        (unsigned long long)a, strerror(errno));
+				return -1;
+			}
+			break;
+		case OP_PRINT:
+			output_hex(*--sp, 0, 0);
+			break;
+		case OP_PRINTS:
+			output_str(prog->strs[code[pc++]]);
+			break;
+		case OP_SPACE:
+			output_char(' ');
+			break;
+		case OP_NEWLINE:
+			output_char('\n');
+			break;
+		case OP_DELAY:
+			output_flush();
+			delay_us(*--sp);
+			break;
+		case OP_EXIT:
+			return *--sp ? -1 : 0;
+		}
+	}
+}
+
+static int
+set_preset(struct program *prog, const char *arg)
+{
+	const char *eq = strchr(arg, '=');
+	char name[MAX_LINE];
+	int var;
+
+	if (eq == NULL || eq == arg || eq - arg >= sizeof(name) ||
+	    eq[1] == '\0') {
+		fprintf(stderr, "expected name=value, got '%s'\n", arg);
+		return -1;
+	}
+	memcpy(name, arg, eq - arg);
+	name[eq - arg] = '\0';
+	if (is_keyword(name) || find_var(prog, name) >= 0) {
+		fprintf(stderr, "can't preset '%s'\n", name);
+		return -1;
+	}
+	var = prog->nvars++;
+	prog->vars[var] = strdup(name);
+	prog->init[var] = strtoull(eq + 1, NULL, 0);
+
+	return 0;
+}
+
+static int
+script(int argc, const char *argv[], const struct cmd_info *info)
+{
+	struct program prog;
+	struct machine m;
+	uint64_t vars[MAX_VARS];
+	FILE *f;
+	int i, rc;
+
+	memset(&prog, 0, sizeof(prog));
+	for (i = 2; i < argc; i++) {
+		if (prog.nvars == MAX_VARS || set_preset(&prog, argv[i]) < 0) {
+			free_program(&prog);
+			return -1;
+		}
+	}
+
+	if (!strcmp(argv[1], "-")) {
+		f = stdin;
+	} else {
+		f = fopen(argv[1], "r");
+		if (f == NULL) {
+			fprintf(stderr, "can't open %s: %s\n", argv[1],
+			        strerror(errno));
+			free_program(&prog);
+			return -1;
+		}
+	}
+	rc = compile(f, (f == stdin) ? "<stdin>" : argv[1], &prog);
+	if (f != stdin) {
+		fclose(f);
+	}
+
+	if (rc == 0) {
+		memset(&m, 0, sizeof(m));
+		m.file = (f == stdin) ? "<stdin>" : argv[1];
+		m.prog = &prog;
+		memcpy(vars, prog.init, sizeof(vars));
+		rc = execute(&m, vars);
+		handle_set_release(&m.handles);
+	}
+
+	free_program(&prog);
+	return rc;
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(script_params, 2, INT_MAX,
+                            "<file|-> [name=value ...]", 0);
+
+static const struct cmd_info script_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(script, script, NULL, &script_params),
+};
+
+MAKE_CMD_GROUP(SCRIPT, "commands to run register scripts", script_cmds);
+REGISTER_CMD_GROUP(SCRIPT);
@@ -0,0 +1,752 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Run time selection of vector kernels, see simd.h.
+ *
+ * Every vector implementation is compiled for its instruction set with the
+ * target attribute, whatever the build flags, and only called once CPUID
+ * (and XGETBV, for the AVX register state) has shown that the CPU and the
+ * kernel support it. Each level binds every kernel to the best version
+ * available at that level; the tails of buffers fall back to the next
+ * smaller version.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "platform.h"
+#include "simd.h"
+#ifdef ARCH_X86
+#include <immintrin.h>
+#endif /* #ifdef ARCH_X86 */
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+static const char *const level_names[] = {
+	[SIMD_GENERIC] = "generic",
+	[SIMD_SSE2] = "sse2",
+	[SIMD_SSSE3] = "ssse3",
+	[SIMD_SSE42] = "sse4.2",
+	[SIMD_AVX2] = "avx2",
+	[SIMD_AVX512BW] = "avx512bw",
+};
+
+/* The widest load simd_load_io() can make on this CPU. */
+static int max_load_width = 64;
+
+/*
+ * Plain C versions, for other architectures, old CPUs and the ends of
+ * buffers.
+ */
+
+static void
+hex_generic(char *dst, const void *src, size_t n, int width, int upper)
+{
+	const char *set = upper ? hex_upper : hex_lower;
+	const uint8_t *p = src;
+	uint8_t b;
+	size_t i;
+	int j;
+
+	for (i = 0; i < n; i++, p += width) {
+		for (j = 0; j < width; j++) {
+#ifdef IS_LITTLE_ENDIAN
+			b = p[width - 1 - j];
+#else
+			b = p[j];
+#endif
+			*dst++ = set[b >> 4];
+			*dst++ = set[b & 0xf];
+		}
+	}
+}
+
+static const void *
+find_generic(const void *buf, size_t len, const void *pat, size_t patlen)
+{
+	return memmem(buf, len, pat, patlen);
+}
+
+/* Reflected CRC-32C polynomial. */
+#define CRC32C_POLY 0x82f63b78
+
+static uint32_t crc32c_table[256];
+
+static void
+crc32c_init(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++) {
+			crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+		}
+		crc32c_table[i] = crc;
+	}
+}
+
+static uint32_t
+crc32c_generic(uint32_t crc, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+
+	crc = ~crc;
+	while (len--) {
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static size_t
+mismatch_generic(const void *a, const void *b, size_t len)
+{
+	const uint8_t *pa = a, *pb = b;
+	uint64_t wa, wb;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&wa, pa + i, 8);
+		memcpy(&wb, pb + i, 8);
+		if (wa != wb) {
+			break;
+		}
+	}
+	for (; i < len; i++) {
+		if (pa[i] != pb[i]) {
+			break;
+		}
+	}
+	return i;
+}
+
+/* Device memory, one load of width bits per value. */
+static void
+load_io_generic(void *dst, const volatile void *src, size_t n, int width)
+{
+	uint8_t *d = dst;
+	uint64_t v64;
+	uint32_t v32;
+	uint16_t v16;
+	uint8_t v8;
+	size_t i;
+
+	for (i = 0; i < n; i++, d += width / 8) {
+		switch (width) {
+		case 8:
+			v8 = ((const volatile uint8_t *)src)[i];
+			memcpy(d, &v8, sizeof(v8));
+			break;
+		case 16:
+			v16 = ((const volatile uint16_t *)src)[i];
+			memcpy(d, &v16, sizeof(v16));
+			break;
+		case 32:
+			v32 = ((const volatile uint32_t *)src)[i];
+			memcpy(d, &v32, sizeof(v32));
+			break;
+		default:
+			v64 = ((const volatile uint64_t *)src)[i];
+			memcpy(d, &v64, sizeof(v64));
+			break;
+		}
+	}
+}
+
+#ifdef ARCH_X86
+
+/* pshufb masks that reverse the bytes of every 1, 2, 4 and 8 byte value in
+ * a vector, so that the most significant digit comes first. */
+static const uint8_t rev_masks[4][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14 },
+	{ 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 },
+	{ 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8 },
+};
+
+static const uint8_t *
+rev_mask(int width)
+{
+	return rev_masks[width == 1 ? 0 : width == 2 ? 1 : width == 4 ? 2 : 3];
+}
+
+/* SSE2 */
+
+__attribute__((target("sse2")))
+static const void *
+find_sse2(const void *buf, size_t len, const void *pat, size_t patlen)
+{
+	const uint8_t *b = buf, *p = pat;
+	__m128i first, last, eq;
+	unsigned int mask;
+	size_t i = 0;
+
+	if (patlen == 0 || patlen > len) {
+		return find_generic(buf, len, pat, patlen);
+	}
+	/* Candidates match both the first and the last byte. */
+	first = _mm_set1_epi8(p[0]);
+	last = _mm_set1_epi8(p[patlen - 1]);
+	for (; i + patlen - 1 + 16 <= len; i += 16) {
+		eq = _mm_and_si128(
+			_mm_cmpeq_epi8(first,
+			               _mm_loadu_si128((const void *)(b + i))),
+			_mm_cmpeq_epi8(last,
+			               _mm_loadu_si128((const void *)
+			                               (b + i + patlen - 1))));
+		for (mask = _mm_movemask_epi8(eq); mask; mask &= mask - 1) {
+			const uint8_t *c = b + i + __builtin_ctz(mask);
+
+			if (!memcmp(c, p, patlen)) {
+				return c;
+			}
+		}
+	}
+	return find_generic(b + i, len - i, pat, patlen);
+}
+
+__attribute__((target("sse2")))
+static size_t
+mismatch_sse2(const void *a, const void *b, size_t len)
+{
+	const uint8_t *pa = a, *pb = b;
+	unsigned int mask;
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16) {
+		mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((const void *)(pa + i)),
+			_mm_loadu_si128((const void *)(pb + i))));
+		if (mask != 0xffff) {
+			return i + __builtin_ctz(~mask);
+		}
+	}
+	return i + mismatch_generic(pa + i, pb + i, len - i);
+}
+
+/* SSSE3 */
+
+__attribute__((target("ssse3")))
+static void
+hex_ssse3(char *dst, const void *src, size_t n, int width, int upper)
+{
+	const uint8_t *p = src;
+	size_t len = n * width, i = 0;
+	__m128i rev, lut, nibble, x, hi, lo;
+
+	rev = _mm_loadu_si128((const void *)rev_mask(width));
+	lut = _mm_loadu_si128((const void *)(upper ? hex_upper : hex_lower));
+	nibble = _mm_set1_epi8(0x0f);
+	for (; i + 16 <= len; i += 16, dst += 32) {
+		x = _mm_shuffle_epi8(_mm_loadu_si128((const void *)(p + i)),
+		                     rev);
+		hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4),
+		                                         nibble));
+		lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, nibble));
+		_mm_storeu_si128((void *)dst, _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((void *)(dst + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+	hex_generic(dst, p + i, (len - i) / width, width, upper);
+}
+
+/* SSE4.2 */
+
+__attribute__((target("sse4.2")))
+static uint32_t
+crc32c_sse42(uint32_t crc, const void *buf, size_t len)
+{
+	const uint8_t *p = buf;
+	uint32_t w;
+
+	crc = ~crc;
+#ifdef __x86_64__
+	{
+		uint64_t c = crc, q;
+
+		for (; len >= 8; p += 8, len -= 8) {
+			memcpy(&q, p, 8);
+			c = _mm_crc32_u64(c, q);
+		}
+		crc = c;
+	}
+#endif /* #ifdef __x86_64__ */
+	for (; len >= 4; p += 4, len -= 4) {
+		memcpy(&w, p, 4);
+		crc = _mm_crc32_u32(crc, w);
+	}
+	while (len--) {
+		crc = _mm_crc32_u8(crc, *p++);
+	}
+	return ~crc;
+}
+
+/* AVX2 */
+
+__attribute__((target("avx2")))
+static void
+hex_avx2(char *dst, const void *src, size_t n, int width, int upper)
+{
+	const uint8_t *p = src;
+	size_t len = n * width, i = 0;
+	__m256i rev, lut, nibble, x, hi, lo, a, b;
+
+	rev = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const void *)rev_mask(width)));
+	lut = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const void *)(upper ? hex_upper : hex_lower)));
+	nibble = _mm256_set1_epi8(0x0f);
+	for (; i + 32 <= len; i += 32, dst += 64) {
+		x = _mm256_shuffle_epi8(
+			_mm256_loadu_si256((const void *)(p + i)), rev);
+		hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(
+			_mm256_srli_epi16(x, 4), nibble));
+		lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(x, nibble));
+		/* Unpacking works within 128 bit lanes; put them in order. */
+		a = _mm256_unpacklo_epi8(hi, lo);
+		b = _mm256_unpackhi_epi8(hi, lo);
+		_mm256_storeu_si256((void *)dst,
+		                    _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((void *)(dst + 32),
+		                    _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	hex_ssse3(dst, p + i, (len - i) / width, width, upper);
+}
+
+__attribute__((target("avx2")))
+static const void *
+find_avx2(const void *buf, size_t len, const void *pat, size_t patlen)
+{
+	const uint8_t *b = buf, *p = pat;
+	__m256i first, last, eq;
+	uint32_t mask;
+	size_t i = 0;
+
+	if (patlen == 0 || patlen > len) {
+		return find_generic(buf, len, pat, patlen);
+	}
+	first = _mm256_set1_epi8(p[0]);
+	last = _mm256_set1_epi8(p[patlen - 1]);
+	for (; i + patlen - 1 + 32 <= len; i += 32) {
+		eq = _mm256_and_si256(
+			_mm256_cmpeq_epi8(first, _mm256_loadu_si256(
+				(const void *)(b + i))),
+			_mm256_cmpeq_epi8(last, _mm256_loadu_si256(
+				(const void *)(b + i + patlen - 1))));
+		for (mask = _mm256_movemask_epi8(eq); mask; mask &= mask - 1) {
+			const uint8_t *c = b + i + __builtin_ctz(mask);
+
+			if (!memcmp(c, p, patlen)) {
+				return c;
+			}
+		}
+	}
+	return find_sse2(b + i, len - i, pat, patlen);
+}
+
+__attribute__((target("avx2")))
+static size_t
+mismatch_avx2(const void *a, const void *b, size_t len)
+{
+	const uint8_t *pa = a, *pb = b;
+	uint32_t mask;
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const void *)(pa + i)),
+			_mm256_loadu_si256((const void *)(pb + i))));
+		if (mask != 0xffffffff) {
+			return i + __builtin_ctz(~mask);
+		}
+	}
+	return i + mismatch_sse2(pa + i, pb + i, len - i);
+}
+
+/* AVX-512BW */
+
+__attribute__((target("avx512f,avx512bw")))
+static const void *
+find_avx512bw(const void *buf, size_t len, const void *pat, size_t patlen)
+{
+	const uint8_t *b = buf, *p = pat;
+	__m512i first, last;
+	uint64_t mask;
+	size_t i = 0;
+
+	if (patlen == 0 || patlen > len) {
+		return find_generic(buf, len, pat, patlen);
+	}
+	first = _mm512_set1_epi8(p[0]);
+	last = _mm512_set1_epi8(p[patlen - 1]);
+	for (; i + patlen - 1 + 64 <= len; i += 64) {
+		mask = _mm512_cmpeq_epi8_mask(first,
+			_mm512_loadu_si512((const void *)(b + i))) &
+		       _mm512_cmpeq_epi8_mask(last,
+			_mm512_loadu_si512((const void *)(b + i + patlen - 1)));
+		for (; mask; mask &= mask - 1) {
+			const uint8_t *c = b + i + __builtin_ctzll(mask);
+
+			if (!memcmp(c, p, patlen)) {
+				return c;
+			}
+		}
+	}
+	return find_avx2(b + i, len - i, pat, patlen);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t
+mismatch_avx512bw(const void *a, const void *b, size_t len)
+{
+	const uint8_t *pa = a, *pb = b;
+	uint64_t mask;
+	size_t i = 0;
+
+	for (; i + 64 <= len; i += 64) {
+		mask = _mm512_cmpneq_epi8_mask(
+			_mm512_loadu_si512((const void *)(pa + i)),
+			_mm512_loadu_si512((const void *)(pb + i)));
+		if (mask) {
+			return i + __builtin_ctzll(mask);
+		}
+	}
+	return i + mismatch_avx2(pa + i, pb + i, len - i);
+}
+
+/* Wide device loads. The loads are asm so that the compiler can neither
+ * split nor merge them: each is one transaction on the bus. */
+
+__attribute__((target("sse2")))
+static void
+load_io_sse2(void *dst, const volatile void *src, size_t n)
+{
+	const volatile uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i v;
+
+	for (; n; n--, s += 16, d += 16) {
+		__asm__ __volatile__("movdqu %1, %0" : "=x" (v)
+		                     : "m" (*(const volatile __m128i *)s));
+		_mm_storeu_si128((void *)d, v);
+	}
+}
+
+__attribute__((target("avx")))
+static void
+load_io_avx(void *dst, const volatile void *src, size_t n)
+{
+	const volatile uint8_t *s = src;
+	uint8_t *d = dst;
+	__m256i v;
+
+	for (; n; n--, s += 32, d += 32) {
+		__asm__ __volatile__("vmovdqu %1, %0" : "=x" (v)
+		                     : "m" (*(const volatile __m256i *)s));
+		_mm256_storeu_si256((void *)d, v);
+	}
+}
+
+__attribute__((target("avx512f")))
+static void
+load_io_avx512(void *dst, const volatile void *src, size_t n)
+{
+	const volatile uint8_t *s = src;
+	uint8_t *d = dst;
+	__m512i v;
+
+	for (; n; n--, s += 64, d += 64) {
+		__asm__ __volatile__("vmovdqu64 %1, %0" : "=v" (v)
+		                     : "m" (*(const volatile __m512i *)s));
+		_mm512_storeu_si512((void *)d, v);
+	}
+}
+
+static const struct simd_ops level_ops[SIMD_LEVEL_MAX] = {
+	[SIMD_GENERIC] = {
+		.hex = hex_generic,
+		.find = find_generic,
+		.crc32c = crc32c_generic,
+		.mismatch = mismatch_generic,
+	},
+	[SIMD_SSE2] = {
+		.hex = hex_generic,
+		.find = find_sse2,
+		.crc32c = crc32c_generic,
+		.mismatch = mismatch_sse2,
+	},
+	[SIMD_SSSE3] = {
+		.hex = hex_ssse3,
+		.find = find_sse2,
+		.crc32c = crc32c_generic,
+		.mismatch = mismatch_sse2,
+	},
+	[SIMD_SSE42] = {
+		.hex = hex_ssse3,
+		.find = find_sse2,
+		.crc32c = crc32c_sse42,
+		.mismatch = mismatch_sse2,
+	},
+	[SIMD_AVX2] = {
+		.hex = hex_avx2,
+		.find = find_avx2,
+		.crc32c = crc32c_sse42,
+		.mismatch = mismatch_avx2,
+	},
+	[SIMD_AVX512BW] = {
+		.hex = hex_avx2,
+		.find = find_avx512bw,
+		.crc32c = crc32c_sse42,
+		.mismatch = mismatch_avx512bw,
+	},
+};
+
+/* CPUID feature bits. */
+#define CPUID1_EDX_SSE2      (1U << 26)
+#define CPUID1_ECX_SSSE3     (1U << 9)
+#define CPUID1_ECX_SSE42     (1U << 20)
+#define CPUID1_ECX_OSXSAVE   (1U << 27)
+#define CPUID1_ECX_AVX       (1U << 28)
+#define CPUID7_EBX_AVX2      (1U << 5)
+#define CPUID7_EBX_AVX512F   (1U << 16)
+#define CPUID7_EBX_AVX512BW  (1U << 30)
+
+/* XCR0 state the OS must save for AVX and for AVX-512. */
+#define XCR0_AVX     0x06
+#define XCR0_AVX512  0xe6
+
+static uint64_t
+xgetbv0(void)
+{
+	uint32_t lo, hi;
+
+	__asm__ __volatile__("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* Also sets max_load_width, which depends on SSE2, AVX and AVX-512F
+ * alone. */
+static enum simd_level
+probe_level(void)
+{
+	uint32_t id0[4], id1[4], id7[4] = { 0, 0, 0, 0 };
+	uint64_t xcr0 = 0;
+
+	cpuid_count(0, 0, id0);
+	if (id0[0] < 1) {
+		return SIMD_GENERIC;
+	}
+	cpuid_count(1, 0, id1);
+	if (id0[0] >= 7) {
+		cpuid_count(7, 0, id7);
+	}
+	if (id1[2] & CPUID1_ECX_OSXSAVE) {
+		xcr0 = xgetbv0();
+	}
+
+	if (id1[3] & CPUID1_EDX_SSE2) {
+		max_load_width = 128;
+	}
+	if ((id1[2] & CPUID1_ECX_AVX) && (xcr0 & XCR0_AVX) == XCR0_AVX) {
+		max_load_width = 256;
+		if ((id7[1] & CPUID7_EBX_AVX512F) &&
+		    (xcr0 & XCR0_AVX512) == XCR0_AVX512) {
+			max_load_width = 512;
+		}
+	}
+
+	if (!(id1[3] & CPUID1_EDX_SSE2)) {
+		return SIMD_GENERIC;
+	}
+	if (!(id1[2] & CPUID1_ECX_SSSE3)) {
+		return SIMD_SSE2;
+	}
+	if (!(id1[2] & CPUID1_ECX_SSE42)) {
+		return SIMD_SSSE3;
+	}
+	if (!(id1[2] & CPUID1_ECX_AVX) || !(id7[1] & CPUID7_EBX_AVX2) ||
+	    (xcr0 & XCR0_AVX) != XCR0_AVX) {
+		return SIMD_SSE42;
+	}
+	if (!(id7[1] & CPUID7_EBX_AVX512F) || !(id7[1] & CPUID7_EBX_AVX512BW) ||
+	    (xcr0 & XCR0_AVX512) != XCR0_AVX512) {
+		return SIMD_AVX2;
+	}
+	return SIMD_AVX512BW;
+}
+
+#else /* ifdef ARCH_X86 */
+
+static const struct simd_ops level_ops[SIMD_LEVEL_MAX] = {
+	[SIMD_GENERIC] = {
+		.hex = hex_generic,
+		.find = find_generic,
+		.crc32c = crc32c_generic,
+		.mismatch = mismatch_generic,
+	},
+};
+
+static enum simd_level
+probe_level(void)
+{
+	return SIMD_GENERIC;
+}
+
+#endif /* ifdef ARCH_X86 */
+
+const struct simd_ops *simd = &level_ops[SIMD_GENERIC];
+static enum simd_level detected_level;
+static enum simd_level selected_level;
+
+enum simd_level
+simd_detected(void)
+{
+	return detected_level;
+}
+
+enum simd_level
+simd_selected(void)
+{
+	return selected_level;
+}
+
+const struct simd_ops *
+simd_level_ops(enum simd_level level)
+{
+	if (level < 0 || level > detected_level) {
+		return NULL;
+	}
+	return &level_ops[level];
+}
+
+int
+simd_select(enum simd_level level)
+{
+	const struct simd_ops *ops = simd_level_ops(level);
+
+	if (ops == NULL) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	simd = ops;
+	selected_level = level;
+	return 0;
+}
+
+const char *
+simd_level_name(enum simd_level level)
+{
+	if (level < 0 || level >= SIMD_LEVEL_MAX) {
+		return NULL;
+	}
+	return level_names[level];
+}
+
+enum simd_level
+simd_level_by_name(const char *name)
+{
+	enum simd_level level;
+
+	for (level = 0; level < SIMD_LEVEL_MAX; level++) {
+		if (!strcmp(name, level_names[level])) {
+			break;
+		}
+	}
+	return level;
+}
+
+const char *
+simd_load_isa(int width)
+{
+	switch (width) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		return "plain loads";
+	case 128:
+		return "SSE2";
+	case 256:
+		return "AVX";
+	case 512:
+		return "AVX-512F";
+	}
+	return NULL;
+}
+
+int
+simd_load_supported(int width)
+{
+	return simd_load_isa(width) != NULL && width <= max_load_width;
+}
+
+int
+simd_load_io(void *dst, const volatile void *src, size_t n, int width)
+{
+	if (simd_load_isa(width) == NULL) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!simd_load_supported(width)) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	switch (width) {
+#ifdef ARCH_X86
+	case 128:
+		load_io_sse2(dst, src, n);
+		break;
+	case 256:
+		load_io_avx(dst, src, n);
+		break;
+	case 512:
+		load_io_avx512(dst, src, n);
+		break;
+#endif /* #ifdef ARCH_X86 */
+	default:
+		load_io_generic(dst, src, n, width);
+		break;
+	}
+	return 0;
+}
+
+/* Probe the CPU before any command runs, then apply IOTOOLS_SIMD. */
+static void simd_init(void) __attribute__ ((constructor));
+static void
+simd_init(void)
+{
+	const char *name = getenv("IOTOOLS_SIMD");
+	enum simd_level level;
+
+	crc32c_init();
+	detected_level = probe_level();
+	simd_select(detected_level);
+
+	if (name == NULL || *name == '\0') {
+		return;
+	}
+	level = simd_level_by_name(name);
+	if (level == SIMD_LEVEL_MAX) {
+		fprintf(stderr, "IOTOOLS_SIMD: unknown level '%s'\n", name);
+	} else if (simd_select(level) < 0) {
+		fprintf(stderr, "IOTOOLS_SIMD: %s is not supported, using %s\n",
+		        name, level_names[detected_level]);
+	}
+}
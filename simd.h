@@ -0,0 +1,87 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+/*
+ * Kernels for bulk data, with vector implementations picked at run time.
+ *
+ * The CPU features are probed once at startup and every kernel is bound to
+ * the best implementation the CPU supports, so a binary built for a
+ * baseline target still uses AVX2 or AVX-512 where they are present. The
+ * environment variable IOTOOLS_SIMD=<level> selects a lower level, e.g.
+ * "generic" for the plain C versions. Kernels accept unaligned buffers of
+ * any length; their results do not depend on the level.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum simd_level {
+	SIMD_GENERIC,
+	SIMD_SSE2,
+	SIMD_SSSE3,
+	SIMD_SSE42,
+	SIMD_AVX2,
+	SIMD_AVX512BW,
+	SIMD_LEVEL_MAX,
+};
+
+struct simd_ops {
+	/* Write n values of width bytes (1, 2, 4 or 8) from src as
+	 * 2 * width hex digits each, most significant first, without
+	 * separators. Values are in host byte order. */
+	void (*hex)(char *dst, const void *src, size_t n, int width,
+	            int upper);
+	/* The first occurrence of pat in buf, or NULL. */
+	const void *(*find)(const void *buf, size_t len, const void *pat,
+	                    size_t patlen);
+	/* CRC-32C (Castagnoli), continuing from crc; start from 0. */
+	uint32_t (*crc32c)(uint32_t crc, const void *buf, size_t len);
+	/* Offset of the first byte that differs, len if there is none. */
+	size_t (*mismatch)(const void *a, const void *b, size_t len);
+};
+
+/* The kernels of the selected level. */
+extern const struct simd_ops *simd;
+
+/* The highest level the CPU supports, and the one in use. */
+enum simd_level simd_detected(void);
+enum simd_level simd_selected(void);
+/* The kernels of a level, NULL if the CPU does not support it. */
+const struct simd_ops *simd_level_ops(enum simd_level level);
+/* Switch to another level; fails with errno set if it is unsupported. */
+int simd_select(enum simd_level level);
+
+/* Copy n values of width bits (8 to 512) from device memory with one load
+ * per value, where narrower loads or a memcpy() would split or merge the
+ * bus transactions. Widths above 64 use SSE2, AVX and AVX-512F loads,
+ * whatever level is selected. These need less than the kernel levels of
+ * the same width (AVX2, AVX512BW), so simd_load_supported() checks for
+ * them on its own and simd_load_isa() names them, or returns NULL if the
+ * width is not supported at all. simd_load_io() fails with errno set. */
+const char *simd_load_isa(int width);
+int simd_load_supported(int width);
+int simd_load_io(void *dst, const volatile void *src, size_t n, int width);
+
+const char *simd_level_name(enum simd_level level);
+/* SIMD_LEVEL_MAX if name is not a level. */
+enum simd_level simd_level_by_name(const char *name);
+
+#endif /* _SIMD_H_ */
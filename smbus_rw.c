@@ -17,6 +17,7 @@
 */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
@@ -27,6 +28,9 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include "commands.h"
+#include "output.h"
+#include "regmap.h"
+#define I2C_IOCTL iot_i2c_ioctl
 #include "linux-i2c-dev.h"
 
 enum SMBUS_SIZE
@@ -53,6 +57,7 @@ typedef union {
 } SMBUS_DTYPE;
 
 struct smbus_op_params {
+	struct iot_handle *h;
 	int fd;
 	uint8_t reg;
 	uint8_t i2c_bus;
@@ -67,32 +72,11 @@ struct smbus_op {
 	int (*perform_op)(struct smbus_op_params *params, const struct smbus_op *op);
 };
 
-/* setup a file descriptor for i2c slave access */
-static int
-open_i2c_slave(unsigned char i2c_bus, unsigned char slave_address)
-{
-	char devfile[15];
-	int fd;
-
-	sprintf(devfile, "/dev/i2c-%d", i2c_bus);
-	fd = open(devfile, O_RDWR);
-	if (fd < 0) {
-		fprintf(stderr, "Couldn't open i2c device file: %s\n",
-			strerror(errno));
-		return -1;
-	}
-
-	/* Double cast the last argument for compat with klibc. */
-	if (ioctl(fd, I2C_SLAVE, (void *)(intptr_t)slave_address) < 0) {
-		fprintf(stderr,
-			"Could not attach to i2c bus %d slave address %d: %s\n",
-		       i2c_bus, slave_address, strerror(errno));
-		close(fd);
-		return -1;
-	}
-
-	return fd;
-}
+/* setup a handle for i2c slave access */
+static const struct backend smbus_backend = {
+	.space = IOT_SPACE_SMBUS,
+	.dev_fmt = "i2c bus %u slave address %u",
+};
 
 static int
 istrailingjunk(const char *arg, char *end)
@@ -143,6 +127,27 @@ parse_uint8_hex(const char *arg, uint8_t *ret)
 	return parse_uint8_base(arg, ret, 16);
 }
 
+/* A register number, or the name of an SMBus register in the register
+ * map. */
+static int
+parse_smbus_reg(const char *arg, uint8_t *ret)
+{
+	uint64_t reg;
+
+	if (isalpha((unsigned char)*arg) || *arg == '_') {
+		if (parse_reg_addr(IOT_SPACE_SMBUS, arg, &reg) < 0) {
+			return -1;
+		}
+		if (reg > 0xff) {
+			fprintf(stderr, "%s: won't fit in a byte\n", arg);
+			return -1;
+		}
+		*ret = reg;
+		return 0;
+	}
+	return parse_uint8(arg, ret);
+}
+
 static int
 parse_io_width(const char *arg, struct smbus_op_params *params,
 	       const struct smbus_op *op) {
@@ -237,31 +242,33 @@ parse_io_width(const char *arg, struct smbus_op_params *params,
 
 /* print out the data read. */
 static void
-print_read_data(int size, int read_block_size, SMBUS_DTYPE *data) {
+print_read_data(const struct smbus_op_params *params, int size,
+                int read_block_size) {
+	const SMBUS_DTYPE *data = &params->data;
+
 	switch (size) {
 	case SMBUS_SIZE_BYTE:
 	case SMBUS_SIZE_8:
-		printf("0x%02X\n", data->fixed.u8);
+		output_read(params->h, params->reg, 8, data->fixed.u8,
+		            OUTPUT_UPPER);
 		break;
 	case SMBUS_SIZE_16:
-		printf("0x%04X\n", data->fixed.u16);
+		output_read(params->h, params->reg, 16, data->fixed.u16,
+		            OUTPUT_UPPER);
 		break;
 	case SMBUS_SIZE_32:
-		printf("0x%08X\n", data->fixed.u32);
+		output_read(params->h, params->reg, 32, data->fixed.u32,
+		            OUTPUT_UPPER);
 		break;
 	case SMBUS_SIZE_64:
-		printf("0x%016llX\n", (long long)data->fixed.u64);
+		output_read(params->h, params->reg, 64, data->fixed.u64,
+		            OUTPUT_UPPER);
 		break;
 	case SMBUS_SIZE_BLOCK:
-		{
-		int i;
-
 		if (read_block_size > I2C_SMBUS_BLOCK_MAX) /* sanity */
 			read_block_size = I2C_SMBUS_BLOCK_MAX;
-		for (i = 0; i < read_block_size; i++)
-			printf("%02X", data->array[i]);
-		printf("\n");
-		}
+		output_block(params->h, params->reg, data->array,
+		             read_block_size, OUTPUT_UPPER);
 		break;
 	}
 }
@@ -273,6 +280,8 @@ static int
 smbus_prologue(const char *argv[], struct smbus_op_params *params,
                const struct smbus_op *op)
 {
+	unsigned int devsel[IOT_MAX_DEV_ARGS];
+
 	if (parse_uint8(argv[1], &params->i2c_bus)) {
 		fprintf(stderr, "invalid adapter value\n");
 		return -1;
@@ -287,21 +296,63 @@ smbus_prologue(const char *argv[], struct smbus_op_params *params,
 	if (op->size != SMBUS_SIZE_BYTE &&
 	    op->size != SMBUS_QUICK &&
 	    op->size != SMBUS_WRITE_READ) {
-		if (parse_uint8(argv[3], &params->reg)) {
+		if (parse_smbus_reg(argv[3], &params->reg)) {
 			fprintf(stderr, "invalid register value\n");
 			return -1;
 		}
 	}
 
-	params->fd = open_i2c_slave(params->i2c_bus, params->address);
-	if (params->fd < 0) {
-		fprintf(stderr, "can't open slave\n");
+	devsel[0] = params->i2c_bus;
+	devsel[1] = params->address;
+	params->h = backend_open(&smbus_backend, devsel, IOT_RDWR);
+	if (params->h == NULL) {
 		return -1;
 	}
+	params->fd = iot_fd(params->h);
 
 	return 0;
 }
 
+/* Read a range of registers of one of the fixed sizes. */
+static int
+smbus_read_range(const char *argv[], const struct smbus_op *op)
+{
+	unsigned int devsel[IOT_MAX_DEV_ARGS];
+	struct reg_range range;
+	struct iot_handle *h;
+	uint8_t i2c_bus, address;
+	int ret;
+
+	if (parse_uint8(argv[1], &i2c_bus)) {
+		fprintf(stderr, "invalid adapter value\n");
+		return -1;
+	}
+	if (parse_uint8(argv[2], &address)) {
+		fprintf(stderr, "invalid address value\n");
+		return -1;
+	}
+	if (parse_reg_range(argv[3], op->size / 8, &range) < 0) {
+		return -1;
+	}
+	if (range.start + (range.count - 1) * range.stride > 0xff) {
+		fprintf(stderr, "register range exceeds 0xff\n");
+		return -1;
+	}
+
+	devsel[0] = i2c_bus;
+	devsel[1] = address;
+	h = backend_open(&smbus_backend, devsel, IOT_RDWR);
+	if (h == NULL) {
+		return -1;
+	}
+
+	ret = backend_read_range(&smbus_backend, h, &range, op->size,
+	                         OUTPUT_UPPER);
+	put_handle(h);
+
+	return ret;
+}
+
 static int
 smbus_read(int argc, const char *argv[], const struct cmd_info *info)
 {
@@ -310,13 +361,37 @@ smbus_read(int argc, const char *argv[], const struct cmd_info *info)
 	const struct smbus_op *op =
 		(const struct smbus_op *)info->privdata;
 
+	if (sampling_requested() &&
+	    (op->size > SMBUS_SIZE_64 || is_reg_range(argv[3]))) {
+		fprintf(stderr, "only single fixed size registers can be "
+		        "sampled\n");
+		return -1;
+	}
+
+	switch (op->size) {
+	case SMBUS_SIZE_8:
+	case SMBUS_SIZE_16:
+	case SMBUS_SIZE_32:
+	case SMBUS_SIZE_64:
+		if (is_reg_range(argv[3])) {
+			return smbus_read_range(argv, op);
+		}
+		break;
+	}
+
+	memset(&params, 0, sizeof(params));
 	if (smbus_prologue(argv, &params, op) < 0) {
 		return -1;
 	}
 
-	ret = op->perform_op(&params, op);
+	if (sampling_requested()) {
+		ret = backend_sample(&smbus_backend, params.h, params.reg,
+		                     op->size);
+	} else {
+		ret = op->perform_op(&params, op);
+	}
 
-	close(params.fd);
+	put_handle(params.h);
 
 	return ret;
 }
@@ -325,28 +400,21 @@ static int
 smbus_read_op(struct smbus_op_params *params, const struct smbus_op *op)
 {
 	int64_t result;
+	uint64_t value;
 
 	memset(&params->data, 0, sizeof(params->data));
 	switch (op->size) {
 	case SMBUS_SIZE_8:
-		result = i2c_smbus_read_byte_data(params->fd, params->reg);
-		params->data.fixed.u8 = result;
-		break;
 	case SMBUS_SIZE_16:
-		result = i2c_smbus_read_word_data(params->fd, params->reg);
-		params->data.fixed.u16 = result;
-		break;
 	case SMBUS_SIZE_32:
-		result = i2c_smbus_read_i2c_block_data(params->fd, params->reg,
-		             4, (uint8_t *)&params->data.fixed.u32);
-		if (result != 4)
-			result = -1;
-		break;
 	case SMBUS_SIZE_64:
-		result = i2c_smbus_read_i2c_block_data(params->fd, params->reg,
-		             8, (uint8_t *)&params->data.fixed.u64);
-		if (result != 8)
-			result = -1;
+		result = iot_read(params->h, params->reg, op->size, &value);
+		switch (op->size) {
+		case SMBUS_SIZE_8:  params->data.fixed.u8 = value; break;
+		case SMBUS_SIZE_16: params->data.fixed.u16 = value; break;
+		case SMBUS_SIZE_32: params->data.fixed.u32 = value; break;
+		default:            params->data.fixed.u64 = value; break;
+		}
 		break;
 	case SMBUS_SIZE_BLOCK:
 		/* result is number of bytes */
@@ -375,7 +443,11 @@ smbus_read_op(struct smbus_op_params *params, const struct smbus_op *op)
 		return -1;
 	}
 
-	print_read_data(op->size, result, &params->data);
+	print_read_data(params, op->size, result);
+	if (op->size <= SMBUS_SIZE_64) {
+		regmap_print_fields(IOT_SPACE_SMBUS, params->reg, op->size,
+		                    value);
+	}
 	return 0;
 }
 
@@ -401,12 +473,12 @@ smbus_write(int argc, const char *argv[], const struct cmd_info *info)
 	if (parse_io_width(argv[arg_num], &params, op) < 0 ) {
 		fprintf(stderr, "%s: %s: invalid value to write\n",
 			argv[0], argv[arg_num]);
-		close(params.fd);
+		put_handle(params.h);
 		return -1;
 	}
 
 	ret = op->perform_op(&params, op);
-	close(params.fd);
+	put_handle(params.h);
 	return ret;
 }
 
@@ -418,8 +490,8 @@ smbus_write_op(struct smbus_op_params *params, const struct smbus_op *op)
 	/* FIXME: Why is this needed if the open_i2c_slave performs the ioctl
 	 * with I2C_SLAVE? */
 	/* Double cast the last argument for compat with klibc. */
-	if (ioctl(params->fd, I2C_SLAVE_FORCE,
-	          (void *)(intptr_t)params->address) < 0) {
+	if (iot_i2c_ioctl(params->fd, I2C_SLAVE_FORCE,
+	                  (void *)(intptr_t)params->address) < 0) {
 		fprintf(stderr, "can't set address 0x%02X, %s\n",
 		        params->address, strerror(errno));
 		return -1;
@@ -427,20 +499,20 @@ smbus_write_op(struct smbus_op_params *params, const struct smbus_op *op)
 
 	switch (op->size) {
 	case SMBUS_SIZE_8:
-		result = i2c_smbus_write_byte_data(params->fd, params->reg,
-		             params->data.fixed.u8);
+		result = iot_write(params->h, params->reg, op->size,
+		                   params->data.fixed.u8);
 		break;
 	case SMBUS_SIZE_16:
-		result = i2c_smbus_write_word_data(params->fd, params->reg,
-		             params->data.fixed.u16);
+		result = iot_write(params->h, params->reg, op->size,
+		                   params->data.fixed.u16);
 		break;
 	case SMBUS_SIZE_32:
-		result = i2c_smbus_write_i2c_block_data(params->fd, params->reg,
-		             4, (uint8_t *)&params->data.fixed.u32);
+		result = iot_write(params->h, params->reg, op->size,
+		                   params->data.fixed.u32);
 		break;
 	case SMBUS_SIZE_64:
-		result = i2c_smbus_write_i2c_block_data(params->fd, params->reg,
-		             8, (uint8_t *)&params->data.fixed.u64);
+		result = iot_write(params->h, params->reg, op->size,
+		                   params->data.fixed.u64);
 		break;
 	case SMBUS_SIZE_BLOCK:
 		result = i2c_smbus_write_block_data(params->fd, params->reg,
@@ -488,13 +560,13 @@ smbus_process_call(int argc, const char *argv[], const struct cmd_info *info)
 	if (parse_io_width(argv[4], &params, op) < 0) {
 		fprintf(stderr, "%s: %s: invalid value to write\n",
 		        argv[0], argv[4]);
-		close(params.fd);
+		put_handle(params.h);
 		return -1;
 	}
 
 	ret = op->perform_op(&params, op);
 
-	close(params.fd);
+	put_handle(params.h);
 
 	return ret;
 }
@@ -505,8 +577,8 @@ smbus_process_call_op(struct smbus_op_params *params,
 {
 	int result;
 
-	if (ioctl(params->fd, I2C_SLAVE_FORCE,
-	          (void *)(intptr_t)params->address) < 0) {
+	if (iot_i2c_ioctl(params->fd, I2C_SLAVE_FORCE,
+	                  (void *)(intptr_t)params->address) < 0) {
 		fprintf(stderr, "can't set address 0x%02X, %s\n",
 		        params->address, strerror(errno));
 		return -1;
@@ -520,7 +592,7 @@ smbus_process_call_op(struct smbus_op_params *params,
 		return -1;
 	}
 
-	print_read_data(SMBUS_SIZE_16, 0, &params->data);
+	print_read_data(params, SMBUS_SIZE_16, 0);
 	return 0;
 }
 
@@ -530,8 +602,8 @@ smbus_block_process_call_op(struct smbus_op_params *params,
 {
 	int read_block_size;
 
-	if (ioctl(params->fd, I2C_SLAVE_FORCE,
-	          (void *)(intptr_t)params->address) < 0) {
+	if (iot_i2c_ioctl(params->fd, I2C_SLAVE_FORCE,
+	                  (void *)(intptr_t)params->address) < 0) {
 		fprintf(stderr, "can't set address 0x%02X, %s\n",
 		        params->address, strerror(errno));
 		return -1;
@@ -548,7 +620,7 @@ smbus_block_process_call_op(struct smbus_op_params *params,
 		return -1;
 	}
 
-	print_read_data(SMBUS_SIZE_BLOCK, read_block_size, &params->data);
+	print_read_data(params, SMBUS_SIZE_BLOCK, read_block_size);
 	return 0;
 }
 
@@ -567,21 +639,23 @@ smbus_writeread(int argc, const char *argv[], const struct cmd_info *info)
 	if (parse_io_width(argv[3], &params, op) < 0) {
 		fprintf(stderr, "%s: %s: invalid value to write\n",
 		        argv[0], argv[3]);
-		close(params.fd);
+		put_handle(params.h);
 		return -1;
 	}
 	if(parse_uint8(argv[4], &params.read_count) < 0) {
 		fprintf(stderr, "invalid read count %s.\n", argv[4]);
+		put_handle(params.h);
 		return -1;
 	}
 	if (params.read_count > I2C_SMBUS_BLOCK_MAX) {
 		fprintf(stderr, "read count %s > %d.\n",
 			argv[3], I2C_SMBUS_BLOCK_MAX);
+		put_handle(params.h);
 		return -1;
 	}
 	ret = op->perform_op(&params, op);
 
-	close(params.fd);
+	put_handle(params.h);
 
 	return ret;
 }
@@ -607,7 +681,7 @@ smbus_writeread_op(struct smbus_op_params *params, const struct smbus_op *op)
 	/* Run the transfers */
 	data.msgs  = msg;
 	data.nmsgs = 2;
-	int rv = ioctl(params->fd, I2C_RDWR, &data);
+	int rv = iot_i2c_ioctl(params->fd, I2C_RDWR, &data);
 
 	/* Error check */
 	if (rv < 0) {
@@ -615,14 +689,16 @@ smbus_writeread_op(struct smbus_op_params *params, const struct smbus_op *op)
 		return -1;
 	}
 
-	print_read_data(SMBUS_SIZE_BLOCK, params->read_count, &params->data);
+	print_read_data(params, SMBUS_SIZE_BLOCK, params->read_count);
 	return 0;
 }
 
-MAKE_PREREQ_PARAMS_FIXED_ARGS(smbus_read_params, 4,
+MAKE_PREREQ_PARAMS_SAMPLED(smbus_read_params, 4, 4,
 	"<adapter> <address> <register>", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(smbus_write_params, 5,
 	"<adapter> <address> <register> <value>", 0);
+MAKE_PREREQ_PARAMS_VAR_ARGS(smbus_rmw_params, 6, 7,
+	"<adapter> <address> <register> <clear> <set> [-v]", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(smbus_receive_byte_params, 3,
 	"<adapter> <address>", 0);
 MAKE_PREREQ_PARAMS_FIXED_ARGS(smbus_send_byte_params, 4,
@@ -658,6 +734,10 @@ MAKE_SMBUS_OP(smbus_op_writeread, SMBUS_WRITE_READ, smbus_writeread_op);
 	                     &smbus_op_ ##size_## _r, &smbus_read_params), \
 	MAKE_CMD_WITH_PARAMS(smbus_write ##size_, smbus_write, \
 	                     &smbus_op_ ##size_## _w, &smbus_write_params)
+#define MAKE_SMBUS_RMW_CMD(size_) \
+	MAKE_CMD_WITH_PARAMS_SIZE(smbus_rmw ##size_, backend_rmw_cmd, \
+	                          &smbus_backend, &smbus_rmw_params, \
+	                          &size ##size_)
 
 static const struct cmd_info smbus_cmds[] = {
 	MAKE_SMBUS_RW_CMDS(8),
@@ -665,6 +745,10 @@ static const struct cmd_info smbus_cmds[] = {
 	MAKE_SMBUS_RW_CMDS(32),
 	MAKE_SMBUS_RW_CMDS(64),
 	MAKE_SMBUS_RW_CMDS(block),
+	MAKE_SMBUS_RMW_CMD(8),
+	MAKE_SMBUS_RMW_CMD(16),
+	MAKE_SMBUS_RMW_CMD(32),
+	MAKE_SMBUS_RMW_CMD(64),
 	MAKE_CMD_WITH_PARAMS(smbus_receive_byte, smbus_read,
 	                     &smbus_op_byte_r, &smbus_receive_byte_params),
 	MAKE_CMD_WITH_PARAMS(smbus_send_byte, smbus_write,
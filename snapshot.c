@@ -0,0 +1,617 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Hardware snapshots.
+ *
+ * "snapshot [-j threads] <plan> <output>" reads every register a plan lists
+ * and writes them to one indexed file, see snapshot.h. A plan has one line
+ * per register or register range, in the form poll and monitor use:
+ *
+ *	pci32 0 3 0 0x0-0xff     # a range, as the read commands take it
+ *	msr * 0x19c              # every online CPU
+ *	mmio32 0xfed40000+16
+ *	smbus8 3 0x50 0x0-0x7f
+ *
+ * The registers are sorted by device and address, which is also the order
+ * of the output file. Each device's registers are then read as a vector
+ * through a single handle, so adjacent file backed registers are fetched
+ * with one read and MMIO windows are mapped once. Devices that do not share
+ * hardware (PCI functions, CPUs, SMBus adapters, distant MMIO windows) form
+ * separate lanes, and lanes run in parallel on a pool of threads; the
+ * devices on one SMBus adapter share a lane since they share the bus.
+ */
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "commands.h"
+#include "output.h"
+#include "snapshot.h"
+
+#define MAX_PLAN_LINE 1024
+#define MAX_PLAN_ARGS 16
+#define MAX_SNAPSHOT_ENTRIES (1 << 22)
+#define MAX_SNAPSHOT_THREADS 64
+#define MAX_CPUS 4096
+
+/* MMIO registers further apart than this are read through separate
+ * mappings, and in separate lanes. */
+#define SNAPSHOT_MAP_WINDOW (1 << 20)
+
+#define SNAPSHOT_CHUNK 4096
+
+struct plan {
+	struct iot_snapshot_entry *entries;
+	uint64_t count;
+	uint64_t size;
+};
+
+/* A run of entries read through one handle. */
+struct group {
+	uint64_t first;
+	uint64_t count;
+};
+
+/* Groups that must run one after another. */
+struct lane {
+	int first;
+	int count;
+	uint64_t entries;
+};
+
+struct snapshot {
+	struct iot_snapshot_entry *entries;
+	struct group *groups;
+	struct lane *lanes;
+	int nlanes;
+	int next_lane;   /* claimed atomically by the workers */
+};
+
+static int
+add_entry(struct plan *p, const struct reg_spec *spec,
+          const unsigned int *dev, uint64_t addr)
+{
+	struct iot_snapshot_entry *e;
+	int i;
+
+	if (p->count == MAX_SNAPSHOT_ENTRIES) {
+		fprintf(stderr, "plans are limited to %d registers\n",
+		        MAX_SNAPSHOT_ENTRIES);
+		return -1;
+	}
+	if (p->count == p->size) {
+		p->size = p->size ? p->size * 2 : 1024;
+		p->entries = realloc(p->entries,
+		                     p->size * sizeof(*p->entries));
+		if (p->entries == NULL) {
+			fprintf(stderr, "out of memory\n");
+			return -1;
+		}
+	}
+
+	e = &p->entries[p->count++];
+	memset(e, 0, sizeof(*e));
+	e->addr = addr;
+	for (i = 0; i < IOT_MAX_DEV_ARGS; i++) {
+		e->dev[i] = dev[i];
+	}
+	e->space = spec->space;
+	e->width = spec->width;
+
+	return 0;
+}
+
+/* Expand one plan line into entries. */
+static int
+add_plan_line(struct plan *p, int nargs, const char *args[])
+{
+	static unsigned int cpus[MAX_CPUS];
+	static int ncpus = -1;
+	unsigned int dev[IOT_MAX_DEV_ARGS] = { 0 };
+	struct reg_spec spec;
+	struct reg_range range;
+	int ndev, all_cpus = 0, i, c;
+	uint64_t r;
+
+	if (parse_reg_spec(args[0], &spec) < 0) {
+		fprintf(stderr, "unknown register type '%s'\n", args[0]);
+		return -1;
+	}
+	ndev = nargs - 2;
+	if (ndev < spec.ndev - spec.opt_dev || ndev > spec.ndev) {
+		fprintf(stderr, "%s takes %d device values before the address\n",
+		        args[0], spec.ndev);
+		return -1;
+	}
+	for (i = 0; i < ndev; i++) {
+		if (!strcmp(args[1 + i], "*") && spec.space == IOT_SPACE_MSR) {
+			all_cpus = 1;
+			continue;
+		}
+		dev[spec.ndev - ndev + i] = strtoul(args[1 + i], NULL, 0);
+	}
+	if (parse_reg_range(args[nargs - 1], spec.addr_step, &range) < 0) {
+		return -1;
+	}
+
+	if (all_cpus && ncpus < 0) {
+		ncpus = online_cpus(cpus, MAX_CPUS);
+	}
+	for (c = 0; c < (all_cpus ? ncpus : 1); c++) {
+		if (all_cpus) {
+			dev[0] = cpus[c];
+		}
+		for (r = 0; r < range.count; r++) {
+			if (add_entry(p, &spec, dev,
+			              range.start + r * range.stride) < 0) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int
+read_plan(const char *path, struct plan *p)
+{
+	const char *args[MAX_PLAN_ARGS + 1];
+	char line[MAX_PLAN_LINE];
+	int nargs, lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f) != NULL) {
+		lineno++;
+		nargs = split_args(line, args, MAX_PLAN_ARGS);
+		if (nargs == 0) {
+			continue;
+		}
+		if (nargs < 0 || nargs < 2 || add_plan_line(p, nargs, args) < 0) {
+			fprintf(stderr, "%s:%d: bad plan line\n", path, lineno);
+			fclose(f);
+			return -1;
+		}
+	}
+	fclose(f);
+
+	return 0;
+}
+
+static int
+compare_device(const struct iot_snapshot_entry *a,
+               const struct iot_snapshot_entry *b)
+{
+	if (a->space != b->space) {
+		return a->space < b->space ? -1 : 1;
+	}
+	return memcmp(a->dev, b->dev, sizeof(a->dev)) ? 1 : 0;
+}
+
+static int
+compare_entries(const void *pa, const void *pb)
+{
+	const struct iot_snapshot_entry *a = pa, *b = pb;
+	int i;
+
+	if (a->space != b->space) {
+		return a->space < b->space ? -1 : 1;
+	}
+	for (i = 0; i < IOT_MAX_DEV_ARGS; i++) {
+		if (a->dev[i] != b->dev[i]) {
+			return a->dev[i] < b->dev[i] ? -1 : 1;
+		}
+	}
+	if (a->addr != b->addr) {
+		return a->addr < b->addr ? -1 : 1;
+	}
+	if (a->width != b->width) {
+		return a->width < b->width ? -1 : 1;
+	}
+	return 0;
+}
+
+/* Whether entry e may join the group starting at first. */
+static int
+same_group(const struct iot_snapshot_entry *first,
+           const struct iot_snapshot_entry *e)
+{
+	if (compare_device(first, e)) {
+		return 0;
+	}
+	if (e->space == IOT_SPACE_MMIO || e->space == IOT_SPACE_MEM) {
+		return e->addr - first->addr < SNAPSHOT_MAP_WINDOW;
+	}
+	return 1;
+}
+
+/* Whether groups starting with a and b share hardware. */
+static int
+same_lane(const struct iot_snapshot_entry *a,
+          const struct iot_snapshot_entry *b)
+{
+	return a->space == IOT_SPACE_SMBUS && b->space == IOT_SPACE_SMBUS &&
+	       a->dev[0] == b->dev[0];
+}
+
+static int
+compare_lanes(const void *pa, const void *pb)
+{
+	const struct lane *a = pa, *b = pb;
+
+	/* Biggest first, so that no big lane is left to run on its own at
+	 * the end. */
+	if (a->entries != b->entries) {
+		return a->entries > b->entries ? -1 : 1;
+	}
+	return a->first - b->first;
+}
+
+/* Sort and deduplicate the plan, then split it into groups and lanes. */
+static int
+build_snapshot(struct plan *p, struct snapshot *s)
+{
+	struct iot_snapshot_entry *e = p->entries;
+	uint64_t i, n = 0;
+	int ngroups = 0, g;
+
+	qsort(e, p->count, sizeof(*e), compare_entries);
+	for (i = 0; i < p->count; i++) {
+		if (n == 0 || compare_entries(&e[n - 1], &e[i])) {
+			e[n++] = e[i];
+		}
+	}
+	p->count = n;
+
+	s->entries = e;
+	s->groups = calloc(n ? n : 1, sizeof(*s->groups));
+	s->lanes = calloc(n ? n : 1, sizeof(*s->lanes));
+	if (s->groups == NULL || s->lanes == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (ngroups == 0 ||
+		    !same_group(&e[s->groups[ngroups - 1].first], &e[i])) {
+			s->groups[ngroups++].first = i;
+		}
+		s->groups[ngroups - 1].count++;
+	}
+
+	for (g = 0; g < ngroups; g++) {
+		if (s->nlanes == 0 ||
+		    !same_lane(&e[s->groups[s->lanes[s->nlanes - 1].first].first],
+		               &e[s->groups[g].first])) {
+			s->lanes[s->nlanes++].first = g;
+		}
+		s->lanes[s->nlanes - 1].count++;
+		s->lanes[s->nlanes - 1].entries += s->groups[g].count;
+	}
+	qsort(s->lanes, s->nlanes, sizeof(*s->lanes), compare_lanes);
+
+	return 0;
+}
+
+static void
+read_group(struct iot_snapshot_entry *e, uint64_t count,
+           struct iot_access *acc)
+{
+	struct iot_handle *h;
+	uint64_t done, i;
+	int n;
+
+	h = iot_open(e->space, e->dev, IOT_RDONLY);
+	if (h == NULL) {
+		for (i = 0; i < count; i++) {
+			e[i].status = -errno;
+		}
+		return;
+	}
+
+	for (done = 0; done < count; done += n) {
+		n = (count - done < SNAPSHOT_CHUNK) ? count - done :
+		                                      SNAPSHOT_CHUNK;
+		for (i = 0; i < n; i++) {
+			acc[i].addr = e[done + i].addr;
+			acc[i].width = e[done + i].width;
+		}
+		iot_readv(h, acc, n);
+		for (i = 0; i < n; i++) {
+			e[done + i].value = acc[i].value;
+			e[done + i].status = acc[i].status;
+		}
+	}
+
+	iot_close(h);
+}
+
+static void *
+snapshot_worker(void *arg)
+{
+	struct snapshot *s = arg;
+	struct iot_access *acc;
+	const struct lane *lane;
+	const struct group *group;
+	int l, g;
+
+	acc = calloc(SNAPSHOT_CHUNK, sizeof(*acc));
+	if (acc == NULL) {
+		return (void *)-1;
+	}
+
+	while ((l = __atomic_fetch_add(&s->next_lane, 1,
+	                               __ATOMIC_RELAXED)) < s->nlanes) {
+		lane = &s->lanes[l];
+		for (g = lane->first; g < lane->first + lane->count; g++) {
+			group = &s->groups[g];
+			read_group(&s->entries[group->first], group->count,
+			           acc);
+		}
+	}
+
+	free(acc);
+	return NULL;
+}
+
+static int
+run_snapshot(struct snapshot *s, int nthreads)
+{
+	pthread_t threads[MAX_SNAPSHOT_THREADS];
+	void *result;
+	int started, i, rc = 0;
+
+	if (nthreads > s->nlanes) {
+		nthreads = s->nlanes;
+	}
+	if (nthreads <= 1) {
+		return snapshot_worker(s) == NULL ? 0 : -1;
+	}
+
+	/* The calling thread works as well. */
+	for (started = 0; started < nthreads - 1; started++) {
+		if (pthread_create(&threads[started], NULL, snapshot_worker,
+		                   s)) {
+			break;
+		}
+	}
+	if (snapshot_worker(s) != NULL) {
+		rc = -1;
+	}
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], &result);
+		if (result != NULL) {
+			rc = -1;
+		}
+	}
+	if (rc < 0) {
+		fprintf(stderr, "out of memory\n");
+	}
+
+	return rc;
+}
+
+static uint64_t
+clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Write the snapshot next to path and move it into place, so that readers
+ * never see a partial file. */
+static int
+write_snapshot(const char *path, const struct iot_snapshot_header *hdr,
+               const struct iot_snapshot_entry *entries)
+{
+	char tmp[PATH_MAX];
+	FILE *f;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	f = fopen(tmp, "w");
+	if (f == NULL) {
+		fprintf(stderr, "can't create %s: %s\n", tmp, strerror(errno));
+		return -1;
+	}
+	if (fwrite(hdr, sizeof(*hdr), 1, f) != 1 ||
+	    fwrite(entries, sizeof(*entries), hdr->count, f) != hdr->count ||
+	    fclose(f) != 0) {
+		fprintf(stderr, "can't write %s: %s\n", tmp, strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+	if (rename(tmp, path) < 0) {
+		fprintf(stderr, "can't rename %s to %s: %s\n", tmp, path,
+		        strerror(errno));
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+take_snapshot(const char *plan_path, const char *path, int nthreads)
+{
+	struct iot_snapshot_header hdr;
+	struct snapshot s;
+	struct plan p;
+	uint64_t start, i;
+	char buf[160];
+	int rc = -1;
+
+	memset(&p, 0, sizeof(p));
+	memset(&s, 0, sizeof(s));
+	if (read_plan(plan_path, &p) < 0 || build_snapshot(&p, &s) < 0) {
+		goto out;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, IOT_SNAPSHOT_MAGIC, sizeof(IOT_SNAPSHOT_MAGIC));
+	hdr.version = IOT_SNAPSHOT_VERSION;
+	hdr.entry_size = sizeof(struct iot_snapshot_entry);
+	hdr.count = p.count;
+	hdr.timestamp_ns = clock_ns(CLOCK_REALTIME);
+
+	start = clock_ns(CLOCK_MONOTONIC);
+	if (run_snapshot(&s, nthreads) < 0) {
+		goto out;
+	}
+	hdr.duration_ns = clock_ns(CLOCK_MONOTONIC) - start;
+	for (i = 0; i < p.count; i++) {
+		if (p.entries[i].status != 0) {
+			hdr.failed++;
+		}
+	}
+
+	if (write_snapshot(path, &hdr, p.entries) < 0) {
+		goto out;
+	}
+
+	snprintf(buf, sizeof(buf), "%llu registers, %llu failed, %d lanes, "
+	         "%llu.%03llums\n", (unsigned long long)hdr.count,
+	         (unsigned long long)hdr.failed, s.nlanes,
+	         (unsigned long long)(hdr.duration_ns / 1000000),
+	         (unsigned long long)(hdr.duration_ns / 1000 % 1000));
+	output_str(buf);
+	rc = 0;
+
+out:
+	free(p.entries);
+	free(s.groups);
+	free(s.lanes);
+	return rc;
+}
+
+static int
+list_snapshot(const char *path)
+{
+	struct iot_snapshot_header hdr;
+	struct iot_snapshot_entry e;
+	char buf[160];
+	uint64_t i;
+	int ndev, len, j, rc = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (f == NULL) {
+		fprintf(stderr, "can't open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    memcmp(hdr.magic, IOT_SNAPSHOT_MAGIC, sizeof(IOT_SNAPSHOT_MAGIC)) ||
+	    hdr.version != IOT_SNAPSHOT_VERSION ||
+	    hdr.entry_size != sizeof(e)) {
+		fprintf(stderr, "%s is not an iotools snapshot\n", path);
+		fclose(f);
+		return -1;
+	}
+
+	for (i = 0; i < hdr.count; i++) {
+		if (fread(&e, sizeof(e), 1, f) != 1) {
+			fprintf(stderr, "%s is truncated\n", path);
+			rc = -1;
+			break;
+		}
+		if (e.space >= IOT_SPACE_MAX) {
+			continue;
+		}
+		ndev = iot_space_info(e.space)->ndev;
+
+		if (output_get_format() != OUTPUT_TEXT) {
+			if (e.status == 0) {
+				output_record(e.space, e.dev, ndev, e.addr,
+				              e.width, e.value, 0);
+			}
+			continue;
+		}
+
+		len = snprintf(buf, sizeof(buf), "%s",
+		               iot_space_name(e.space));
+		for (j = 0; j < ndev; j++) {
+			len += snprintf(&buf[len], sizeof(buf) - len, "%c%x",
+			                j ? ':' : ' ', e.dev[j]);
+		}
+		snprintf(&buf[len], sizeof(buf) - len, " 0x%llx %d ",
+		         (unsigned long long)e.addr, e.width);
+		output_str(buf);
+		if (e.status != 0) {
+			output_str(strerror(-e.status));
+		} else {
+			output_hex(e.value, e.width / 4, 0);
+		}
+		output_char('\n');
+	}
+	fclose(f);
+
+	return rc;
+}
+
+static int
+snapshot(int argc, const char *argv[], const struct cmd_info *info)
+{
+	long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	int arg = 1;
+	char *end;
+
+	if (argc == 3 && !strcmp(argv[1], "-l")) {
+		return list_snapshot(argv[2]);
+	}
+
+	if (argc == 5 && !strcmp(argv[1], "-j")) {
+		nthreads = strtol(argv[2], &end, 0);
+		if (*end != '\0' || nthreads < 1) {
+			fprintf(stderr, "bad thread count '%s'\n", argv[2]);
+			return -1;
+		}
+		arg += 2;
+	}
+	if (arg != argc - 2) {
+		fprintf(stderr, "usage: %s %s\n", argv[0], info->params->usage);
+		return -1;
+	}
+	if (nthreads > MAX_SNAPSHOT_THREADS) {
+		nthreads = MAX_SNAPSHOT_THREADS;
+	}
+
+	return take_snapshot(argv[arg], argv[arg + 1], nthreads);
+}
+
+MAKE_PREREQ_PARAMS_VAR_ARGS(snapshot_params, 3, 5,
+                            "[-j threads] <plan> <output> | -l <snapshot>",
+                            0);
+
+static const struct cmd_info snapshot_cmds[] = {
+	MAKE_CMD_WITH_PARAMS(snapshot, snapshot, NULL, &snapshot_params),
+};
+
+MAKE_CMD_GROUP(SNAPSHOT, "commands to take hardware snapshots",
+               snapshot_cmds);
+REGISTER_CMD_GROUP(SNAPSHOT);
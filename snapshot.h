@@ -0,0 +1,57 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+/*
+ * File format written by "iotools snapshot".
+ *
+ * A struct iot_snapshot_header is followed by count entries, sorted by
+ * space, device, address and width, so a register can be found by binary
+ * search. Every register of the plan has one entry, whether or not it could
+ * be read. All fields are in host byte order.
+ */
+
+#include <stdint.h>
+#include "libiotools.h"
+
+#define IOT_SNAPSHOT_MAGIC "IOTSNAP"
+#define IOT_SNAPSHOT_VERSION 1
+
+struct iot_snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint64_t count;
+	uint64_t timestamp_ns;  /* CLOCK_REALTIME when the snapshot started */
+	uint64_t duration_ns;
+	uint64_t failed;        /* entries with a non-zero status */
+};
+
+struct iot_snapshot_entry {
+	uint64_t addr;
+	uint64_t value;
+	uint32_t dev[IOT_MAX_DEV_ARGS];
+	int32_t status;         /* 0 or negative errno */
+	uint8_t space;          /* enum iot_space */
+	uint8_t width;
+	uint8_t reserved[2];
+};
+
+#endif /* _SNAPSHOT_H_ */
@@ -0,0 +1,186 @@
+/*
+ Copyright 2008 Google Inc.
+
+ This program is free software; you can redistribute it and/or
+ modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 2
+ of the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; if not, write to the Free Software
+ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+/*
+ * Per-command instrumentation, enabled with the global --stats option or by
+ * setting IOTOOLS_STATS=1 in the environment.
+ *
+ * Every command prints one line of key=value pairs to stderr once it has
+ * finished. Times are in nanoseconds:
+ *   total_ns        from option parsing to the end of the command
+ *   startup_cpu_ns  CPU time used by exec and libc startup (first command)
+ *   dispatch_ns     locating the command and checking its arguments
+ *   open_ns, map_ns, access_ns, close_ns
+ *                   time spent in libiotools, see struct iot_stats
+ *   flush_ns        writing buffered output to stdout
+ *   cmd_ns          everything else, mostly parsing and formatting
+ * followed by system call, handle and mapping counts and the number of
+ * hardware reads and writes for each address space.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "commands.h"
+#include "output.h"
+
+static int stats_enabled;
+static int stats_reported;
+static uint64_t start_ns;
+static uint64_t dispatched_ns;
+static uint64_t startup_cpu_ns;
+static struct iot_stats start_stats;
+
+static uint64_t
+clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* --stats may follow the command name, after stats_start() has run, so
+ * enabling also marks the start. */
+void
+stats_enable(void)
+{
+	if (stats_enabled) {
+		return;
+	}
+	stats_enabled = 1;
+	iot_stats_timing(1);
+	stats_start();
+}
+
+int
+stats_enable_from_env(void)
+{
+	const char *env = getenv("IOTOOLS_STATS");
+
+	if (env != NULL && *env != '\0' && strcmp(env, "0") != 0) {
+		stats_enable();
+	}
+	return stats_enabled;
+}
+
+void
+stats_start(void)
+{
+	if (!stats_enabled) {
+		return;
+	}
+	iot_stats_get(&start_stats);
+	if (!stats_reported) {
+		startup_cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+	}
+	start_ns = clock_ns(CLOCK_MONOTONIC);
+	dispatched_ns = start_ns;
+}
+
+void
+stats_dispatched(void)
+{
+	if (!stats_enabled) {
+		return;
+	}
+	dispatched_ns = clock_ns(CLOCK_MONOTONIC);
+}
+
+/* Append to the report line; stderr is unbuffered, so the line is built up
+ * first and written with a single call. */
+static void
+append(char *buf, size_t size, size_t *len, const char *fmt, ...)
+{
+	va_list ap;
+	int r;
+
+	if (*len >= size) {
+		return;
+	}
+	va_start(ap, fmt);
+	r = vsnprintf(buf + *len, size - *len, fmt, ap);
+	va_end(ap);
+	if (r > 0) {
+		*len += r;
+	}
+}
+
+void
+stats_report(const char *cmd, int rc)
+{
+	struct iot_stats now;
+	uint64_t flush_start, end_ns, total, accounted;
+	uint64_t lib_ns, dispatch_ns, flush_ns;
+	char line[1024];
+	size_t len = 0;
+	int i;
+
+	if (!stats_enabled) {
+		return;
+	}
+
+	/* Output is buffered; charge writing it out to its own bucket. */
+	flush_start = clock_ns(CLOCK_MONOTONIC);
+	output_flush();
+	end_ns = clock_ns(CLOCK_MONOTONIC);
+	iot_stats_get(&now);
+
+	total = end_ns - start_ns;
+	dispatch_ns = dispatched_ns - start_ns;
+	flush_ns = end_ns - flush_start;
+	lib_ns = (now.open_ns - start_stats.open_ns) +
+	         (now.map_ns - start_stats.map_ns) +
+	         (now.access_ns - start_stats.access_ns) +
+	         (now.close_ns - start_stats.close_ns);
+	accounted = dispatch_ns + flush_ns + lib_ns;
+
+	append(line, sizeof(line), &len, "iotools-stats: cmd=%s rc=%d"
+	       " total_ns=%llu", cmd, rc, (unsigned long long)total);
+	/* Process CPU time before the first command covers exec, dynamic
+	 * setup and constructors; it is meaningless for later batch lines. */
+	if (!stats_reported) {
+		append(line, sizeof(line), &len, " startup_cpu_ns=%llu",
+		       (unsigned long long)startup_cpu_ns);
+	}
+	append(line, sizeof(line), &len, " dispatch_ns=%llu open_ns=%llu"
+	       " map_ns=%llu access_ns=%llu close_ns=%llu flush_ns=%llu"
+	       " cmd_ns=%llu",
+	       (unsigned long long)dispatch_ns,
+	       (unsigned long long)(now.open_ns - start_stats.open_ns),
+	       (unsigned long long)(now.map_ns - start_stats.map_ns),
+	       (unsigned long long)(now.access_ns - start_stats.access_ns),
+	       (unsigned long long)(now.close_ns - start_stats.close_ns),
+	       (unsigned long long)flush_ns,
+	       (unsigned long long)(total > accounted ? total - accounted : 0));
+	append(line, sizeof(line), &len, " syscalls=%llu opens=%llu maps=%llu",
+	       (unsigned long long)(now.syscalls - start_stats.syscalls),
+	       (unsigned long long)(now.opens - start_stats.opens),
+	       (unsigned long long)(now.maps - start_stats.maps));
+	for (i = 0; i < IOT_SPACE_MAX; i++) {
+		append(line, sizeof(line), &len, " %s_reads=%llu %s_writes=%llu",
+		       iot_space_name(i), (unsigned long long)
+		       (now.reads[i] - start_stats.reads[i]),
+		       iot_space_name(i), (unsigned long long)
+		       (now.writes[i] - start_stats.writes[i]));
+	}
+
+	fprintf(stderr, "%s\n", line);
+	stats_reported = 1;
+}